@@ -0,0 +1,168 @@
+#ifndef ANALYSIS_LOG_H
+#define ANALYSIS_LOG_H
+
+#include <cstdio>
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/**
+ * @file AnalysisLog.h
+ * @brief Binary log of analysis frames, written while running and read back by AnalysisReplay
+ *
+ * A log is one AnalysisLogHeader, the source file path (sourceLength bytes, empty for live input), then one
+ * record per analysis frame: an AnalysisFrameHeader followed by bucketCount buckets, bucketCount smoothed heights,
+ * bucketCount peak caps and, if the log has inputs, fftSize unwindowed input samples. All values are native
+ * endian. Logs of file playback only store the sample position and a checksum of each input block, the replay
+ * reads the block from the file again; logs of live input carry the samples themselves.
+ */
+
+namespace AnalysisLogs {
+	constexpr uint32_t magic = 0x52564147;		///< "GAVR" in the first four bytes
+	constexpr uint32_t layoutVersion = 1;		///< Bumped whenever the structs below change
+	constexpr uint32_t hasInputs = 1;			///< Log flag: every record carries its input block
+
+	constexpr uint32_t frameBeat = 1;			///< Frame flag: the frame confirmed a beat
+	constexpr uint32_t frameReset = 2;			///< Frame flag: the analysis level changed right before this frame
+
+	constexpr uint32_t maxBuckets = 128;		///< Most buckets a record may hold, at least Visualizer::maxBars
+	constexpr uint32_t maxFftSize = 1u << 16;	///< Largest FFT size a reader accepts, anything above is a damaged record
+
+	/// @brief FNV-1a hash of a block's bytes, identifies the exact input of a frame
+	uint32_t checksum(const float* samples, size_t count);
+}
+
+/// @brief Description at the start of a log
+struct AnalysisLogHeader{
+	uint32_t magic;							///< AnalysisLogs::magic
+	uint32_t version;						///< AnalysisLogs::layoutVersion
+	uint32_t sampleRate;					///< Sample rate of the analyzed stream
+	uint32_t channels;						///< Interleaved channels of the analyzed stream
+	uint32_t flags;							///< AnalysisLogs flags
+	uint32_t sourceLength;					///< Bytes of source path following the header
+	uint32_t reserved[2];
+};
+
+/// @brief Fixed part of one record: where the frame came from and its scalar outputs
+struct AnalysisFrameHeader{
+	int64_t samplePosition;					///< Stream index (in samples) of the first analyzed sample
+	double frameTime;						///< Time handed to BeatDetector::process
+	double audioTime;						///< Audio time the frame was stamped with for presentation
+	uint32_t fftSize;						///< Samples per FFT
+	uint32_t bucketCount;					///< Visualization buckets
+	uint32_t inputChecksum;					///< AnalysisLogs::checksum of the input block
+	float analysisRate;						///< Nominal analysis frames per second the BeatDetector was sized for
+	float rms;								///< RMS of the block
+	float peak;								///< Peak amplitude of the block
+	float spectrumEnergy;					///< Sum of squared magnitudes over the whole spectrum
+	float spectrumCentroid;					///< Magnitude weighted mean bin
+	float onset;							///< Spectral flux novelty
+	float beatStrength;						///< Strength of the beat, if any
+	float tempo;							///< Tempo estimate in BPM
+	uint32_t flags;							///< AnalysisLogs frame flags
+};
+
+static_assert(sizeof(AnalysisFrameHeader) == 72, "record layout must not depend on padding");
+
+/// @brief One analysis frame with its inputs and the outputs of every stage
+struct AnalysisLogFrame{
+	AnalysisFrameHeader info = {};
+	std::vector<float> buckets;				///< Analyzer buckets
+	std::vector<float> heights;				///< PresentationScheduler heights at the frame's audio time
+	std::vector<float> peaks;				///< PresentationScheduler peak caps at the frame's audio time
+	std::vector<float> input;				///< Unwindowed input block, only in logs with inputs
+};
+
+/**
+ * @class AnalysisLogWriter
+ * @brief Appends analysis frames to a log file
+ */
+class AnalysisLogWriter{
+	private:
+		std::FILE* file;					///< Open log, nullptr when closed
+		bool withInputs;					///< Records carry their input blocks
+		long long frameCount;				///< Records written
+
+	public:
+		/// @brief Constructor leaves the writer closed
+		AnalysisLogWriter();
+
+		/// @brief Closes the file
+		~AnalysisLogWriter();
+
+		/// @brief Creates (or replaces) a log
+		/// @param path Output path
+		/// @param sampleRate Sample rate of the analyzed stream
+		/// @param channels Interleaved channels of the analyzed stream
+		/// @param source Audio file the frames come from, empty for live input
+		/// @param inputs Store every frame's input block, needed when there is no source file to read them from
+		/// @return True on success
+		bool open(const char* path, int sampleRate, int channels, const std::string& source, bool inputs);
+
+		/// @brief Appends one frame
+		void write(const AnalysisLogFrame& frame);
+
+		/// @brief Flushes and closes the log
+		void close();
+
+		/// @brief Checks if a log is open
+		bool isOpen() const {return file != nullptr;}
+
+		/// @brief Records written so far
+		long long getFrameCount() const {return frameCount;}
+
+		// Disable copy constructor and assignment operator
+		AnalysisLogWriter(const AnalysisLogWriter&) = delete;
+		AnalysisLogWriter& operator=(const AnalysisLogWriter&) = delete;
+};
+
+/**
+ * @class AnalysisLogReader
+ * @brief Reads a log written by AnalysisLogWriter one frame at a time
+ */
+class AnalysisLogReader{
+	private:
+		std::FILE* file;					///< Open log, nullptr when closed
+		AnalysisLogHeader header;			///< Header of the open log
+		std::string source;					///< Source path stored in the log
+		uint64_t remaining;					///< Bytes of the file not read yet, bounds every record before it is allocated
+		bool damaged;						///< A record was truncated or out of range
+
+	public:
+		/// @brief Constructor leaves the reader closed
+		AnalysisLogReader();
+
+		/// @brief Closes the file
+		~AnalysisLogReader();
+
+		/// @brief Opens a log and reads its header
+		/// @return False if the file cannot be read or is not an analysis log of this version
+		bool open(const char* path);
+
+		/// @brief Reads the next frame. A record with a bucket count above AnalysisLogs::maxBuckets, an FFT size that is
+		/// not a power of two up to AnalysisLogs::maxFftSize, or more data than the file has left is not read
+		/// @return False at the end of the log or on a damaged record (see isDamaged)
+		bool read(AnalysisLogFrame& frame);
+
+		/// @brief True if reading stopped at a truncated or out of range record rather than the end of the log
+		bool isDamaged() const {return damaged;}
+
+		/// @brief Sample rate of the analyzed stream
+		int getSampleRate() const {return static_cast<int>(header.sampleRate);}
+
+		/// @brief Interleaved channels of the analyzed stream
+		int getChannels() const {return static_cast<int>(header.channels);}
+
+		/// @brief Audio file the frames were analyzed from, empty for live input
+		const std::string& getSource() const {return source;}
+
+		/// @brief True if every record carries its input block
+		bool hasInputs() const {return (header.flags & AnalysisLogs::hasInputs) != 0;}
+
+		// Disable copy constructor and assignment operator
+		AnalysisLogReader(const AnalysisLogReader&) = delete;
+		AnalysisLogReader& operator=(const AnalysisLogReader&) = delete;
+};
+
+#endif
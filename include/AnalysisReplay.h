@@ -0,0 +1,101 @@
+#ifndef ANALYSIS_REPLAY_H
+#define ANALYSIS_REPLAY_H
+
+#include <memory>
+#include <vector>
+#include "AnalysisLog.h"
+#include "AudioAnalyzer.h"
+#include "BeatDetector.h"
+#include "PresentationScheduler.h"
+#include "SampleStore.h"
+
+/**
+ * @class AnalysisReplay
+ * @brief Runs the analysis pipeline (analyzer, beat detector, presentation) on recorded blocks without any clocks
+ *
+ * Every stage gets its inputs from the frame being replayed: the block, its FFT size and bucket count, the frame
+ * time for the beat detector and the audio time for presentation. The same frames therefore always give the same
+ * outputs, which can be compared against a golden log. Each stage is timed.
+ */
+class AnalysisReplay{
+	private:
+		int sampleRate;							///< Sample rate of the replayed stream
+		std::unique_ptr<AudioAnalyzer> analyzer;	///< Created at the first frame's FFT size
+		std::unique_ptr<BeatDetector> beatDetector;	///< Recreated at frames flagged AnalysisLogs::frameReset
+		PresentationScheduler presentation;		///< Same constants as the live visualizer
+
+		double beatSeconds;						///< Time spent in BeatDetector::process
+		double presentationSeconds;				///< Time spent in pushFrame / present
+
+	public:
+		/// @brief Constructor, the analyzer is planned at the first frame
+		/// @param sampleRate Sample rate of the replayed stream
+		AnalysisReplay(int sampleRate);
+
+		/// @brief Analyzes one block, the outputs of frame are overwritten
+		/// @param block fftSize samples of the frame
+		/// @param frame Frame whose samplePosition, frameTime, audioTime, fftSize, bucketCount, analysisRate and reset flag are used
+		void run(const float* block, AnalysisLogFrame& frame);
+
+		/// @brief Fills a frame's outputs from stages that just processed its block
+		/// @param analyzer Analyzer holding the block's spectrum and buckets
+		/// @param beatDetector Beat detector that processed the spectrum
+		/// @param presentation Scheduler the buckets are pushed to and presented from at the frame's audio time
+		/// @param frame Frame to fill, info.audioTime must be set
+		static void capture(const AudioAnalyzer& analyzer, const BeatDetector& beatDetector, PresentationScheduler& presentation, AnalysisLogFrame& frame);
+
+		/// @brief Prints the time spent in every stage
+		/// @param inputSeconds Time spent getting the blocks (log or file reads)
+		void printTimings(double inputSeconds) const;
+
+		/// @brief Replays a log or an audio file through a new AnalysisReplay and compares it (--replay)
+		/// @param source Analysis log, or an audio file replayed like the fixed 1024 FFT / 32 bar setup
+		/// @param goldenLog Log to compare against, nullptr compares a log with itself and an audio file with nothing
+		/// @param recordLog Log the replayed frames are written to, or nullptr
+		/// @param tolerance Relative tolerance of the comparison
+		/// @param format Sample storage layout used when decoding audio
+		/// @return False if a file could not be opened, the comparison failed or the replayed log is damaged
+		static bool replayFile(const char* source, const char* goldenLog, const char* recordLog, float tolerance, SampleFormat format);
+};
+
+/**
+ * @class AnalysisDiff
+ * @brief Compares replayed frames with golden ones within a tolerance
+ *
+ * Float outputs match if |result - golden| <= 1e-6 + tolerance * |golden|. Positions, sizes, input checksums and
+ * beat flags have to match exactly.
+ */
+class AnalysisDiff{
+	private:
+		float tolerance;						///< Relative tolerance of float outputs
+		long long frames;						///< Frames compared
+		long long mismatches;					///< Frames with at least one difference
+		long long firstMismatch;				///< Index of the first mismatching frame, -1 if none
+		const char* firstField;					///< Output that differed first
+		float maxBucketError;					///< Largest bucket difference
+		float maxHeightError;					///< Largest height or peak cap difference
+		float maxScalarError;					///< Largest rms, peak, energy, centroid, onset, strength or tempo difference
+
+		/// @brief Checks one value, remembers the first field that failed
+		bool _close(float result, float golden, float& maxError, const char* field, bool& ok);
+
+	public:
+		/// @brief Constructor
+		/// @param tolerance Relative tolerance of float outputs
+		AnalysisDiff(float tolerance = 1.0e-4f);
+
+		/// @brief Compares one frame
+		/// @return True if it matched
+		bool compare(const AnalysisLogFrame& result, const AnalysisLogFrame& golden);
+
+		/// @brief Counts a frame missing from either side as a mismatch
+		void addMissing(const char* side);
+
+		/// @brief True if every frame matched
+		bool passed() const {return mismatches == 0;}
+
+		/// @brief Prints the comparison summary
+		void print() const;
+};
+
+#endif
@@ -0,0 +1,282 @@
+#ifndef ANALYZER_T_H
+#define ANALYZER_T_H
+
+#include <array>
+#include <utility>
+#include <cmath>
+#include <fftw3.h>
+#include "AudioBuffer.h"
+#include "SpectrumAnalyzer.h"
+
+/**
+ * @file AnalyzerT.h
+ * @brief Compile time specialized analyzer for fixed FFT sizes and bucket counts
+ *
+ * AnalyzerT<FftSize, Buckets, Window, SampleRate> does the same analysis as AudioAnalyzer, but the window table,
+ * bucket ranges and bucket weights are generated at compile time, results live in std::array members,
+ * and bucketing is unrolled over the constant ranges. Construction does not touch the heap (FFTW's plan aside).
+ */
+
+/// @brief constexpr replacements for <cmath>, which is not constexpr in C++17
+namespace ConstexprMath {
+	constexpr double pi = 3.14159265358979323846;
+
+	constexpr double abs(double x){
+		return x < 0.0 ? -x : x;
+	}
+
+	// Taylor series after reducing to [-pi, pi]
+	constexpr double cos(double x){
+		while(x > pi){
+			x -= 2.0 * pi;
+		}
+		while(x < -pi){
+			x += 2.0 * pi;
+		}
+		double x2 = x * x;
+		double term = 1.0;
+		double sum = 1.0;
+		for(int k = 1; k < 24; k++){
+			term *= -x2 / ((2.0 * k - 1.0) * (2.0 * k));
+			sum += term;
+		}
+		return sum;
+	}
+
+	// Taylor series on x / 2^k, squared back k times
+	constexpr double exp(double x){
+		int halvings = 0;
+		while(abs(x) > 0.5){
+			x *= 0.5;
+			halvings++;
+		}
+		double term = 1.0;
+		double sum = 1.0;
+		for(int k = 1; k < 20; k++){
+			term *= x / k;
+			sum += term;
+		}
+		for(int i = 0; i < halvings; i++){
+			sum *= sum;
+		}
+		return sum;
+	}
+
+	// x = m * 2^e with m in [0.5, 1), log(m) = 2 atanh((m - 1) / (m + 1))
+	constexpr double log(double x){
+		constexpr double ln2 = 0.69314718055994530942;
+		int exponent = 0;
+		while(x >= 1.0){
+			x *= 0.5;
+			exponent++;
+		}
+		while(x < 0.5){
+			x *= 2.0;
+			exponent--;
+		}
+		double y = (x - 1.0) / (x + 1.0);
+		double y2 = y * y;
+		double term = y;
+		double sum = 0.0;
+		for(int k = 0; k < 40; k++){
+			sum += term / (2.0 * k + 1.0);
+			term *= y2;
+		}
+		return 2.0 * sum + exponent * ln2;
+	}
+
+	constexpr double pow(double base, double exponent){
+		return exp(exponent * log(base));
+	}
+
+	constexpr int floorToInt(double x){
+		int truncated = static_cast<int>(x);
+		return (x < truncated) ? truncated - 1 : truncated;
+	}
+}
+
+/// @brief Hann window, same as AudioAnalyzer's
+struct HannWindow{
+	static constexpr double coefficient(int i, int n){
+		return 0.5 * (1.0 - ConstexprMath::cos(2.0 * ConstexprMath::pi * i / (n - 1)));
+	}
+};
+
+/// @brief 4-term Blackman-Harris window, ~92 dB sidelobes for high dynamic range spectra
+struct BlackmanHarrisWindow{
+	static constexpr double coefficient(int i, int n){
+		double phase = 2.0 * ConstexprMath::pi * i / (n - 1);
+		return 0.35875 - 0.48829 * ConstexprMath::cos(phase) + 0.14128 * ConstexprMath::cos(2.0 * phase)
+			- 0.01168 * ConstexprMath::cos(3.0 * phase);
+	}
+};
+
+/// @brief 5-term flat-top window, accurate peak amplitudes at the cost of frequency resolution
+struct FlatTopWindow{
+	static constexpr double coefficient(int i, int n){
+		double phase = 2.0 * ConstexprMath::pi * i / (n - 1);
+		return 0.21557895 - 0.41663158 * ConstexprMath::cos(phase) + 0.277263158 * ConstexprMath::cos(2.0 * phase)
+			- 0.083578947 * ConstexprMath::cos(3.0 * phase) + 0.006947368 * ConstexprMath::cos(4.0 * phase);
+	}
+};
+
+/**
+ * @class AnalyzerT
+ * @brief Fixed size AudioAnalyzer variant, see file description
+ * @tparam FftSize Number of samples per FFT (power of two)
+ * @tparam Buckets Number of log-spaced visualization buckets
+ * @tparam Window Window type providing a constexpr coefficient(i, n)
+ * @tparam SampleRate Sample rate the bucket ranges are generated for
+ */
+template <int FftSize, int Buckets, typename Window = HannWindow, int SampleRate = 44100>
+class AnalyzerT : public SpectrumAnalyzer{
+	static_assert(FftSize >= 16 && (FftSize & (FftSize - 1)) == 0, "FftSize must be a power of two");
+	static_assert(Buckets > 0, "Buckets must be positive");
+
+	public:
+		static constexpr int numBins = FftSize / 2 + 1;		///< Bins in the magnitude spectrum
+		static constexpr float lowFreq = 20.0f;				///< Lowest bucket edge, same as AudioAnalyzer
+		static constexpr float highFreq = 16000.0f;			///< Highest bucket edge, same as AudioAnalyzer
+
+		/// @brief Inclusive bin range of one bucket and the weight that turns its sum into an average
+		struct BucketRange{
+			int startBin;
+			int endBin;
+			float weight;
+		};
+
+	private:
+		/// @brief Window coefficients generated at compile time
+		static constexpr std::array<float, FftSize> _makeWindow(){
+			std::array<float, FftSize> table{};
+			for(int i = 0; i < FftSize; i++){
+				table[i] = static_cast<float>(Window::coefficient(i, FftSize));
+			}
+			return table;
+		}
+
+		/// @brief Log-spaced bucket edges, bucket i covers floor(f_i / binWidth) to floor(f_i+1 / binWidth)
+		static constexpr std::array<BucketRange, Buckets> _makeBuckets(){
+			std::array<BucketRange, Buckets> ranges{};
+			constexpr double binWidth = static_cast<double>(SampleRate) / FftSize;
+			constexpr double ratio = static_cast<double>(highFreq) / lowFreq;
+			for(int i = 0; i < Buckets; i++){
+				int start = ConstexprMath::floorToInt(lowFreq * ConstexprMath::pow(ratio, static_cast<double>(i) / Buckets) / binWidth);
+				int end = ConstexprMath::floorToInt(lowFreq * ConstexprMath::pow(ratio, static_cast<double>(i + 1) / Buckets) / binWidth);
+				start = start < numBins - 1 ? start : numBins - 1;
+				end = end < numBins - 1 ? end : numBins - 1;
+				end = end > start ? end : start;
+				ranges[i] = {start, end, 1.0f / static_cast<float>(end - start + 1)};
+			}
+			return ranges;
+		}
+
+	public:
+		static constexpr std::array<float, FftSize> windowTable = _makeWindow();	///< Window coefficients
+		static constexpr std::array<BucketRange, Buckets> bucketTable = _makeBuckets();	///< Bucket ranges and weights
+
+	private:
+		AudioBuffer* audioBuffer;							///< Pointer to shared AudioBuffer for audio data
+
+		alignas(64) std::array<float, FftSize> fftInput;	///< FFTW input buffer (real values)
+		alignas(64) std::array<fftwf_complex, numBins> fftOutput;	///< FFTW output buffer (complex data)
+		fftwf_plan plan;									///< FFTW execution plan for repeated transforms
+
+		std::array<float, numBins> magnitudeSpectrum;		///< Magnitude spectrum from FFT
+		std::array<float, Buckets> visualizationBuckets;	///< Logarithmically spaced frequency buckets
+		float rmsVal;										///< Root mean square of current analysis block
+		float peakAmplitude;								///< Peak amplitude in current analysis block
+
+		/// @brief Averages one bucket, bounds are constants so the inner loop unrolls
+		template <int Index>
+		void _computeBucket(){
+			constexpr BucketRange range = bucketTable[Index];
+			float sum = 0.0f;
+			for(int j = range.startBin; j <= range.endBin; j++){
+				sum += magnitudeSpectrum[j];
+			}
+			visualizationBuckets[Index] = sum * range.weight;
+		}
+
+		/// @brief Expands _computeBucket for every bucket index
+		template <int... Indices>
+		void _computeBuckets(std::integer_sequence<int, Indices...>){
+			(_computeBucket<Indices>(), ...);
+		}
+
+	public:
+		/// @brief Constructor creates the FFTW plan on the member arrays
+		/// @param buffer Pointer to AudioBuffer to analyze data from
+		explicit AnalyzerT(AudioBuffer* buffer) : audioBuffer(buffer), fftInput{}, fftOutput{}, magnitudeSpectrum{}, visualizationBuckets{}, rmsVal(0.0f), peakAmplitude(0.0f){
+			plan = fftwf_plan_dft_r2c_1d(FftSize, fftInput.data(), fftOutput.data(), FFTW_MEASURE);
+		}
+
+		/// @brief Cleans up the FFTW plan
+		~AnalyzerT() override{
+			if(plan){
+				fftwf_destroy_plan(plan);
+			}
+		}
+
+		/// @brief Peeks the next block, windows it, runs the FFT, and computes magnitudes and buckets
+		/// @return True if analysis was successful, false if not enough data available
+		bool analyzeNextBlock() override{
+			if(!plan || audioBuffer->peekBuffer(fftInput.data(), FftSize) < FftSize){
+				return false;
+			}
+
+			// RMS and peak on raw data, then window
+			float sumSquares = 0.0f;
+			float peak = 0.0f;
+			for(int i = 0; i < FftSize; i++){
+				float sample = fftInput[i];
+				sumSquares += sample * sample;
+				// A compare, std::fmax's NaN handling is a library call per sample
+				peak = std::fabs(sample) > peak ? std::fabs(sample) : peak;
+				fftInput[i] = sample * windowTable[i];
+			}
+			rmsVal = std::sqrt(sumSquares / FftSize);
+			peakAmplitude = peak;
+
+			fftwf_execute(plan);
+
+			constexpr float scale = 1.0f / FftSize;
+			for(int i = 0; i < numBins; i++){
+				float real = fftOutput[i][0];
+				float imag = fftOutput[i][1];
+				magnitudeSpectrum[i] = std::sqrt(real * real + imag * imag) * scale;
+			}
+
+			_computeBuckets(std::make_integer_sequence<int, Buckets>{});
+			return true;
+		}
+
+		/// @brief Fixed size access to the buckets
+		const std::array<float, Buckets>& getBuckets() const {return visualizationBuckets;}
+
+		/// @brief Fixed size access to the magnitude spectrum
+		const std::array<float, numBins>& getSpectrum() const {return magnitudeSpectrum;}
+
+		// SpectrumAnalyzer interface
+		const float* getSpectrumData() const override {return magnitudeSpectrum.data();}
+		int getSpectrumSize() const override {return numBins;}
+		const float* getBucketData() const override {return visualizationBuckets.data();}
+		int getBucketCount() const override {return Buckets;}
+		float getRmsVal() const override {return rmsVal;}
+		float getPeakAmplitude() const override {return peakAmplitude;}
+
+		// Disable copy constructor and assignment operator (the plan is bound to this instance's arrays)
+		AnalyzerT(const AnalyzerT&) = delete;
+		AnalyzerT& operator=(const AnalyzerT&) = delete;
+};
+
+/// @brief Analyzers for the fixed deployments
+using Analyzer1024x32 = AnalyzerT<1024, 32>;
+using Analyzer2048x64 = AnalyzerT<2048, 64>;
+using Analyzer4096x128 = AnalyzerT<4096, 128>;
+
+/// @brief Times each fixed analyzer against an AudioAnalyzer of the same FFT size, bucket count and sample rate and
+/// prints microseconds per block and the speedup (--analyzer-benchmark)
+void benchmarkAnalyzerT();
+
+#endif
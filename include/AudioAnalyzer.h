@@ -1,9 +1,27 @@
+#ifndef AUDIO_ANALYZER_H
+#define AUDIO_ANALYZER_H
+
 #define _USE_MATH_DEFINES
 #include <cmath>
 #include <iostream>
 #include <vector>
+#include <chrono>
+#include <algorithm>
 #include <fftw3.h>
 #include "AudioBuffer.h"
+#include "SpectrumAnalyzer.h"
+#include "SlidingDft.h"
+#include "SampleStore.h"
+
+/// @brief Time spent in each analysis stage since profiling was enabled, in seconds
+struct AnalyzerTimings{
+	double window = 0.0;				///< RMS, peak and windowing
+	double fft = 0.0;					///< fftwf_execute, or the sliding DFT update
+	double magnitudes = 0.0;			///< Complex output to magnitudes
+	double buckets = 0.0;				///< Bucketing
+	long long blocks = 0;				///< Blocks analyzed
+	long long slid = 0;					///< Blocks updated by the sliding DFT instead of a full FFT
+};
 
 /**
  * @class AudioAnalyzer
@@ -13,14 +31,14 @@
  * It computes frequency spectrum, organizes frequencies into logarithmic buckets
  * for visualization, and calculates RMS and peak amplitude values.
  */
-class AudioAnalyzer{
+class AudioAnalyzer : public SpectrumAnalyzer{
 	private:
 		AudioBuffer* audioBuffer;			///< Pointer to shared AudioBuffer for audio data
 
 		int sampleRate;						///< Sample rate of audio data
-		int numBuckets;						///< Number of frequency buckets for visualization (locked at 32 right now)
-		float lowFreq;						///< Lowest freq to analyze (locked at 20 right now)
-		float highFreq;						///< Highest freq to analyze (locked at 16k right now)
+		int numBuckets;						///< Number of frequency buckets for visualization
+		float lowFreq;						///< Lowest freq to analyze
+		float highFreq;						///< Highest freq to analyze
 
 		// FFT setup
 		int fftSize;						///< Number of samples to analyze
@@ -35,6 +53,28 @@ class AudioAnalyzer{
 		std::vector<float> visualizationBuckets;	///< Logarithmically spaced frequency buckets for visualization
 		float rmsVal;						///< Root mean square of current analysis block (measures loudness)
 		float peakAmplitude;				///< Peak amplitude in current analysis block
+		long long blockPosition;			///< Stream index (in samples) of the first sample of the current block
+
+		bool keepInput;						///< Copy every block to rawInput before windowing
+		std::vector<float> rawInput;		///< Unwindowed samples of the current block, filled when keepInput
+		bool profiling;						///< Accumulate per stage times in timings
+		AnalyzerTimings timings;			///< Per stage times, when profiling
+
+		// Sliding DFT mode, the spectrum of short hops is updated from the samples that entered and left the window
+		bool sliding;						///< Slide the spectrum between blocks instead of transforming every block
+		SlidingDft slidingDft;				///< State of the bins the buckets use
+		std::vector<float> previousInput;	///< Unwindowed samples of the previous block, the ones leaving the window
+		long long previousPosition;			///< blockPosition of previousInput, -1 if there is none
+		long long samplesSinceResync;		///< Samples slid since the last full FFT
+		int resyncWindows;					///< Windows of slid samples between full FFTs
+		int maxSlideHop;					///< Longest hop that is cheaper to slide than to transform, measured
+
+		/// @brief Allocates FFTW buffers and creates the plan for the current fftSize
+		/// @param planFlags FFTW planner flags (FFTW_MEASURE at construction, FFTW_ESTIMATE for quick runtime switches)
+		bool _createPlan(unsigned planFlags);
+
+		/// @brief Frees FFTW buffers and plan
+		void _destroyPlan();
 
 		/// @brief Precomputes Hanning window coefficients
 		void _computeWindowFunction();
@@ -42,6 +82,9 @@ class AudioAnalyzer{
 		/// @brief Applies Hanning window to input data to reduce spectral leakage, used right before the FFT
 		void _applyWindowFunction();
 
+		/// @brief Runs RMS / peak, window, FFT, magnitudes and buckets on the samples in fftInput
+		void _analyzeInput();
+
 		/// @brief Compute root mean square and peak amplitude of current analysis block
 		void _computeRmsAndPeak();
 
@@ -54,14 +97,20 @@ class AudioAnalyzer{
 		/// @brief Computes average magnitude for each visualization bucket
 		void _computeBuckets();
 
+		/// @brief Sizes the sliding DFT for the bucket bins and measures its cost against the FFT
+		void _configureSliding();
+
+		/// @brief Updates magnitudes of the bucket bins from fftInput by sliding, or by a full FFT that resynchronizes the sliding state
+		void _slideSpectrum();
+
 	public:
 		/// @brief Constructor initializes FFTW, allocates buffers, and sets up analysis parameters
 		/// @param buffer Pointer to AudioBuffer to analyze data from
 		/// @param fftSize Number of samples per FFT
 		/// @param sampleRate Audio sample rate, input from AudioLoader's sample rate
-		/// @param numBuckets Number of visualization buckets (only 32 works right now)
-		/// @param lowFreq Lower frequency bound for bucket grouping (only 20 works right now)
-		/// @param highFreq Higher frequency bound for bucket grouping (only 16k works right now)
+		/// @param numBuckets Number of visualization buckets
+		/// @param lowFreq Lower frequency bound for bucket grouping
+		/// @param highFreq Higher frequency bound for bucket grouping
 		AudioAnalyzer(AudioBuffer* buffer, int fftSize, int sampleRate, int numBuckets = 32, float lowFreq = 20.0f, float highFreq = 16000.0f);
 
 		/// @brief Cleans up FFTW resources
@@ -70,7 +119,59 @@ class AudioAnalyzer{
 
 		/// @brief Peeks data from the next block in the AudioBuffer, applies windowing, performs FFT, computes magnitude and buckets (non-destructive)
 		/// @return True if analysis was successful, false if not enough data available
-		bool analyzeNextBlock();
+		bool analyzeNextBlock() override;
+
+		/// @brief Runs the same analysis on a block supplied by the caller instead of the AudioBuffer
+		/// @param samples fftSize samples, the buffer passed to the constructor may be nullptr if only this is used
+		/// @param position Stream index reported by getBlockPosition() for this block
+		/// @return True if analysis was successful
+		bool analyzeBlock(const float* samples, long long position = 0);
+
+		/// @brief Switches to a different FFT size, replanning with FFTW_ESTIMATE so the switch does not stall the caller
+		/// @param size New number of samples per FFT
+		/// @return True if the new plan was created
+		bool setFftSize(int size);
+
+		/// @brief Changes the number of visualization buckets
+		/// @param count New number of buckets
+		void setNumBuckets(int count);
+
+		/// @brief Updates the spectrum incrementally when a block starts shortly after the previous one
+		///
+		/// Only the bins the buckets use are computed (others read 0) and the window is a Hann window with a
+		/// slight exponential taper. Blocks must be consecutive windows of one stream, positioned by getBlockPosition(),
+		/// a jump or a hop longer than getMaxSlideHop() falls back to a full FFT. Not thread safe with FFTW planning
+		/// (the cost is measured with the existing plan, nothing is planned).
+		/// @param enabled True for the sliding DFT, false for a full FFT of every block
+		void setSlidingDft(bool enabled);
+
+		/// @brief Whether setSlidingDft is enabled
+		bool isSlidingDft() const {return sliding;}
+
+		/// @brief Sets how many windows of slid samples pass between full FFTs that bound the sliding DFT's drift
+		/// @param windows Windows between resyncs, 0 transforms every block
+		void setResyncWindows(int windows) {resyncWindows = std::max(windows, 0);}
+
+		/// @brief Longest hop (in samples) the sliding DFT updates, longer hops cost less as a full FFT
+		int getMaxSlideHop() const {return maxSlideHop;}
+
+		/// @brief Gets the number of samples per FFT
+		int getFftSize() const {return fftSize;}
+
+		/// @brief Stream index (in samples) of the first sample of the latest block, exact even while playback reads
+		long long getBlockPosition() const {return blockPosition;}
+
+		/// @brief Keeps an unwindowed copy of every block, for recording the analyzer's inputs
+		void setKeepInput(bool enabled) {keepInput = enabled;}
+
+		/// @brief Unwindowed samples of the latest block, empty unless setKeepInput(true)
+		const std::vector<float>& getInput() const {return rawInput;}
+
+		/// @brief Times every stage of the analysis from now on
+		void setProfiling(bool enabled) {profiling = enabled; timings = AnalyzerTimings();}
+
+		/// @brief Accumulated stage times since setProfiling(true)
+		const AnalyzerTimings& getTimings() const {return timings;}
 
 		//Getters for analysis results
 		/// @brief Gets the full magnitude spectrum from FFT analysis
@@ -84,15 +185,29 @@ class AudioAnalyzer{
 
 		/// @brief Get RMS value of most recent analysis block
 		/// @return Root mean square amplitude (loudness)
-		float getRmsVal() const {return rmsVal;};
+		float getRmsVal() const override {return rmsVal;};
 		
 		/// @brief Get peak ampitude of most recent analysis block
 		/// @return Maximum amplitude in block
-		float getPeakAmplitude() const {return peakAmplitude;};
+		float getPeakAmplitude() const override {return peakAmplitude;};
 
+		// SpectrumAnalyzer interface
+		const float* getSpectrumData() const override {return magnitudeSpectrum.data();}
+		int getSpectrumSize() const override {return static_cast<int>(magnitudeSpectrum.size());}
+		const float* getBucketData() const override {return visualizationBuckets.data();}
+		int getBucketCount() const override {return static_cast<int>(visualizationBuckets.size());}
+
+		/// @brief Times the sliding DFT against a full FFT of every block at hops of 8 to 512 frames and prints both
+		/// costs and the bucket error of the sliding path (--sliding-benchmark)
+		/// @param filename Audio file, its first 30 s are analyzed
+		/// @param format Sample storage layout used while decoding
+		/// @return False if the file could not be loaded
+		static bool benchmarkSlidingDft(const char* filename, SampleFormat format);
 
 		// Disable copy constructor and assignment operator
 		AudioAnalyzer(const AudioAnalyzer&) = delete;
 		AudioAnalyzer& operator=(const AudioAnalyzer&) = delete;
 
-};
\ No newline at end of file
+};
+
+#endif
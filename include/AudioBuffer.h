@@ -4,7 +4,10 @@
 #include <vector>
 #include <cstddef>
 #include <algorithm>
+#include <atomic>
+#include <cstdint>
 #include "AudioLoader.h"
+#include "SampleTap.h"
 #include "pa_ringbuffer.h"
 
 /**
@@ -15,10 +18,19 @@
 */
 class AudioBuffer{
 	private:
-		const std::vector<float>* audioData;	///< Pointer to audio data loaded from AudioLoader
+		const AudioLoader* loader;				///< Source file, may still be decoding on another thread
 		size_t sourcePosition;					///< Current read position in audio data
 		float* bufferData;						///< Memory used for ring buffer storage
 		PaUtilRingBuffer ringBuffer;			///< Internal PortAudio ring buffer instance
+		std::vector<SampleTap*> taps;			///< Streaming stages that receive every sample written to the ring
+
+		// Consumer position, so a peek knows which stream sample it starts at
+		std::atomic<uint32_t> readSequence;		///< Seqlock counter, odd while the consumer moves the read index
+		std::atomic<long long> samplesConsumed;	///< Samples read or skipped since the start of the stream
+
+		/// @brief Moves the read index under the seqlock, advance does the actual read or skip
+		template <typename Advance>
+		int _consume(Advance advance);
 		
 	public:
 		/// @brief Construct an AudioBuffer with given size and loader for the audio source
@@ -26,15 +38,30 @@ class AudioBuffer{
 		/// @param loader AudioLoader containing data to fill the buffer
 		AudioBuffer(int bufferSizeInSamples, const AudioLoader& loader);
 
+		/// @brief Construct an AudioBuffer without a file source, filled by a live InputSource through writeBuffer
+		/// @param bufferSizeInSamples Size of buffer in samples (power of two)
+		explicit AudioBuffer(int bufferSizeInSamples);
+
 		/// @brief Destructor deallocates buffer memory
 		~AudioBuffer();
 
 
 		/// @brief Fill the buffer with audio samples from the source data, typically called by main thread to keep buffer filled during audio playback
 		/// @param samplesToWrite Number of samples to attempt writing into the ring buffer
-		/// @return False if the end of the source file has been reached, true otherwise
+		/// @return False if the end of the source file has been reached, true otherwise (also while waiting on the decoder)
 		bool fillBuffer(int samplesToWrite);
 
+		/// @brief Write samples pushed by a live source, lock and allocation free so it is safe in an audio callback
+		/// @param samples Interleaved samples to write
+		/// @param sampleCount Number of samples to write
+		/// @return Number of samples written, less than sampleCount if the buffer is full
+		int writeBuffer(const float* samples, int sampleCount);
+
+		/// @brief Discards the oldest samples so at most keepSamples remain, bounds latency when nothing consumes a live stream
+		/// @param keepSamples Number of newest samples to keep (rounded down to whole frames by the caller)
+		/// @return Number of samples discarded
+		int skipToLatest(int keepSamples);
+
 		/// @brief Read samples from the ring buffer (destructive read), used directly inside of AudioOutput for audio stream
 		/// @param output Destination array to store samples
 		/// @param frameCount Number of samples requested
@@ -47,10 +74,25 @@ class AudioBuffer{
 		/// @return Number of samples successfully copied
 		int peekBuffer(float* output, int frameCount);
 
+		/// @brief Peek that also reports where in the stream the samples start, consistent even while the consumer reads
+		/// @param output Destination array to copy samples
+		/// @param frameCount Number of samples to peek
+		/// @param position Set to the stream index (in samples) of the first copied sample
+		/// @return Number of samples successfully copied
+		int peekBuffer(float* output, int frameCount, long long* position);
+
 		/// @brief Gets samples available to read in buffer, useful to check buffer status
 		/// @return Number of readable samples
 		int getAvailableReadSamples() const;
 
+		/// @brief Attach a streaming stage that sees every sample exactly once as it is written, must be called before filling starts
+		/// @param tap Stage to receive written samples (not owned)
+		void addTap(SampleTap* tap);
+
+		/// @brief Gets free space in buffer, used by live sources to write whole frames only
+		/// @return Number of writable samples
+		int getAvailableWriteSamples() const;
+
 		//maybe remove? I don't utilize this rn
 		bool hasData() const;
 
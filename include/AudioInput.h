@@ -0,0 +1,55 @@
+#ifndef AUDIO_INPUT_H
+#define AUDIO_INPUT_H
+
+#include <atomic>
+#include <portaudio.h>
+#include "AudioBuffer.h"
+#include "InputSource.h"
+
+/**
+ * @class AudioInput
+ * @brief Captures live audio from the default PortAudio input device into an AudioBuffer
+ *
+ * The input callback writes straight into the lock-free ring buffer, it never locks or allocates.
+ */
+class AudioInput : public InputSource{
+	private:
+		PaStream* stream;					///< PortAudio stream object
+		AudioBuffer* audioBuffer;			///< Pointer to shared AudioBuffer that receives captured samples
+		int sampleRate;						///< Capture sample rate
+		int channels;						///< Number of captured channels
+		bool initialized;					///< True if Pa_Initialize succeeded and must be balanced
+		std::atomic<double> newestSampleTime;	///< Stream time at which the newest captured sample hit the ADC
+		std::atomic<long long> droppedSamples;	///< Samples that did not fit into the ring buffer
+
+		/// @brief Static callback function required by PortAudio.
+		/// Pushes the captured block into the AudioBuffer and stamps its capture time
+		static int inputCallback( const void *inputBuffer, void *outputBuffer,
+						unsigned long framesPerBuffer,
+						const PaStreamCallbackTimeInfo* timeInfo,
+						PaStreamCallbackFlags statusFlags,
+						void *userData );
+	public:
+		/// @brief Constructor initializes PortAudio and opens the default input device
+		/// @param buffer Pointer to the AudioBuffer that receives the captured samples
+		/// @param sampleRate Requested sample rate, 0 for the device default
+		/// @param channels Requested channel count, 0 for up to 2 channels supported by the device
+		AudioInput(AudioBuffer* buffer, int sampleRate = 0, int channels = 0);
+
+		/// @brief Destructor stops and closes the stream, and terminates PortAudio
+		~AudioInput() override;
+
+		bool start() override;
+		bool stop() override;
+		bool isActive() const override;
+		int getSampleRate() const override {return sampleRate;}
+		int getChannels() const override {return channels;}
+		double getCaptureLatency() const override;
+		long long getDroppedSamples() const override {return droppedSamples.load(std::memory_order_relaxed);}
+
+		// Disable copy constructor and assignment operator
+		AudioInput(const AudioInput&) = delete;
+		AudioInput& operator=(const AudioInput&) = delete;
+};
+
+#endif
@@ -2,29 +2,84 @@
 #define AUDIO_LOADER_H
 
 #include <vector>
+#include <atomic>
+#include <cstddef>
+#include <string>
+#include <memory>
 #include <sndfile.h>
+#include "SampleStore.h"
 
 /**
  * @class AudioLoader
  * @brief Loads audio files into memory using libsndfile
+ *
+ * Loading can be split into openAudioFile (header only, fast) and decodeAudioFile (the slow part),
+ * so the decode can run on another thread while playback starts on the samples decoded so far.
+ *
+ * Long seekable files are decoded in segments on several threads, each with its own SNDFILE handle. For formats
+ * whose seeks are not guaranteed sample exact (MP3, Vorbis, FLAC), each segment decoder starts a little early and
+ * discards that preroll, and the thread owning the previous segment keeps decoding across the boundary and
+ * compares until both decoders agree, overwriting anything that differs. The result is identical to a serial decode.
+ *
+ * Samples are kept in a SampleStore, float by default, or 16/24 bit integers or compressed blocks to save memory.
  */
 class AudioLoader{
     private:
-        std::vector<float> audioData;   ///< Holds raw audio samples
+        std::unique_ptr<SampleStore> audioData;    ///< Holds the decoded samples
+        SampleFormat sampleFormat;      ///< Requested storage layout for the next openAudioFile
         SF_INFO sfInfo;                 ///< Contains data about the audio file (most important is sample rate and channels)
+        SNDFILE* openFile;              ///< File opened by openAudioFile, closed once decoded
+        std::atomic<size_t> decodedSamples;    ///< Samples at the start of audioData that are decoded and safe to read
+        std::atomic<bool> fullyDecoded; ///< True once the whole file was decoded (or decoding stopped early)
+        std::atomic<bool> cancelRequested;     ///< Set by cancelDecode to stop a decode running on another thread
+        std::string fileName;           ///< Path of the open file, segment decoders open their own handles
+        int decodeThreads;              ///< Threads used by decodeAudioFile, 0 for one per core
+
+        /// @brief Decodes the whole file with the handle from openAudioFile
+        sf_count_t _decodeSerial();
+
+        /// @brief Decodes the file in segments on several threads
+        sf_count_t _decodeParallel(int segmentCount);
 
     public:
         /// @brief Constructor initializes internal SF_INFO struct
         AudioLoader();
 
+        /// @brief Closes the file if it was opened but never decoded
+        ~AudioLoader();
+
         /// @brief Loads audio file into memory using libsndfile
         /// @param filename Path to the audio file
         /// @return True if the file was successfully loaded, false if not
         bool loadAudioFile(const char* filename);
 
-        /// @brief Gets a const reference of audio data, used in AudioBuffer class to have the data
-        /// @return Reference to a vector of audio samples
-        const std::vector<float>& getAudioData() const { return audioData;}
+        /// @brief Opens the file and reads its header, sizing audioData without decoding any samples
+        /// @param filename Path to the audio file
+        /// @return True if the file was opened, false if not
+        bool openAudioFile(const char* filename);
+
+        /// @brief Decodes the file opened by openAudioFile in chunks, publishing progress through getDecodedSamples
+        /// @return True if samples were decoded, false if nothing could be decoded or no file was opened
+        bool decodeAudioFile();
+
+        /// @brief Selects how samples are stored, takes effect at the next openAudioFile
+        void setSampleFormat(SampleFormat format) { sampleFormat = format; }
+
+        /// @brief Sets the number of decode threads, 1 decodes serially, 0 (the default) uses one per core
+        void setDecodeThreads(int threads) { decodeThreads = threads; }
+
+        /// @brief Asks a running decodeAudioFile to stop after its current chunk, e.g. when the user quits during startup
+        void cancelDecode() { cancelRequested.store(true, std::memory_order_relaxed); }
+
+        /// @brief Gets the decoded samples, used in AudioBuffer class to have the data
+        /// @return Reference to the sample store (empty until a file was opened)
+        const SampleStore& getAudioData() const { return *audioData; }
+
+        /// @brief Number of samples decoded so far, samples below this index may be read while decoding continues
+        size_t getDecodedSamples() const { return decodedSamples.load(std::memory_order_acquire); }
+
+        /// @brief Checks if decoding finished
+        bool isFullyDecoded() const { return fullyDecoded.load(std::memory_order_acquire); }
 
         /// @brief Returns the sample rate of loaded audio, used as parameter for AudioOutput and AudioAnalyzer constructors
         /// @return Sample rate (Hz)
@@ -36,6 +91,20 @@ class AudioLoader{
         
         int getTotalFrames() const { return static_cast<int>(sfInfo.frames); }
         double getDuration() const { return static_cast<double>(sfInfo.frames) / sfInfo.samplerate; }
+
+        /// @brief Decodes a file serially and then with 2, 4, ... threads up to the core count, printing the speedup of
+        /// each run and whether it is identical to the serial decode (--decode-benchmark)
+        /// @return False if the file could not be loaded
+        static bool benchmarkDecode(const char* filename);
+
+        /// @brief Loads a file in every sample storage layout and prints its memory, fill throughput and largest
+        /// difference to the float layout (--storage-benchmark)
+        /// @return False if the file could not be loaded
+        static bool benchmarkStorage(const char* filename);
+
+        // Disable copy constructor and assignment operator (an open file handle is unique per instance)
+        AudioLoader(const AudioLoader&) = delete;
+        AudioLoader& operator=(const AudioLoader&) = delete;
 };
 
-#endif
\ No newline at end of file
+#endif
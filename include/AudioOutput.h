@@ -2,7 +2,11 @@
 #define AUDIOOUTPUT_H
 
 #include <portaudio.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include "AudioBuffer.h"
+#include "ThreadConfig.h"
 
 /**
  * @class AudioOutput
@@ -15,6 +19,28 @@ class AudioOutput{
 		int sampleRate;				///< Sample rate of audio info from portaudio
 		int channels;				///< Number of audio channels (eg. 2 for stereo)
 
+		// The callback only publishes its thread, start() applies the settings from outside the real-time path
+		ThreadConfig callbackConfig;		///< Settings for the callback thread
+		bool callbackConfigWanted;			///< True if setCallbackThreadConfig was called
+		ThreadHandle callbackThread;		///< Written once by the first callback
+		std::atomic<bool> callbackThreadSeen;	///< Set by the first callback after writing callbackThread
+
+		// Callback statistics, written only by the callback thread
+		std::atomic<long long> callbackCount;		///< Callbacks so far
+		std::atomic<long long> underrunCount;		///< Callbacks that ran short of data or reported an output underflow
+		std::atomic<bool> sourceFinished;			///< Set at end of file, short reads after it are the drain, not underruns
+		std::atomic<double> jitterSquaredSum;		///< Sum of squared deviations of the callback interval from the buffer period
+		std::atomic<double> maxJitter;				///< Largest deviation of the callback interval from the buffer period
+		std::chrono::steady_clock::time_point lastCallbackTime;	///< Time of the previous callback
+
+		// Playback clock, published by the callback under a seqlock (odd while being written)
+		std::atomic<long long> framesConsumed;		///< Frames taken from the buffer so far
+		std::atomic<uint32_t> clockSequence;		///< Seqlock counter guarding the three values below
+		std::atomic<long long> clockFramePosition;	///< Frames taken before the latest callback
+		std::atomic<double> clockDacTime;			///< Stream time the latest callback's first frame is heard
+		std::atomic<int> clockFrames;				///< Frames the latest callback took from the buffer
+		double outputLatency;						///< Output latency reported by the stream, used when the host gives no DAC time
+
 		/// @brief Static callback function required by PortAudio.
 		/// Pulls audio data from AudioBuffer and writes to the outputBuffer
 		static int outputCallback( const void *inputBuffer, void *outputBuffer,
@@ -33,7 +59,7 @@ class AudioOutput{
 		~AudioOutput();
 
 
-		/// @brief Starts audio playback
+		/// @brief Starts audio playback, then applies the callback thread settings once the first callback ran
 		/// @return True on success, false on failure
 		bool start();
 
@@ -45,6 +71,32 @@ class AudioOutput{
 		/// @return True if active, false otherwise
 		bool isActive() const;
 
+		/// @brief Frames the callback has taken from the buffer, the next frame it reads is the first one analyzeNextBlock sees
+		long long getFramesConsumed() const {return framesConsumed.load(std::memory_order_relaxed);}
+
+		/// @brief Position of the audio leaving the speakers right now, from PortAudio's stream clock
+		/// @return Seconds of audio since playback started, 0 before the first callback
+		double getPlaybackTime() const;
+
+		/// @brief Sets scheduling, priority and pinning for the PortAudio callback thread, applied by start()
+		/// @param config Settings for the callback thread, call before start()
+		void setCallbackThreadConfig(const ThreadConfig& config);
+
+		/// @brief Marks the end of the source, so the short reads while the buffer drains are not counted as underruns
+		void setSourceFinished() {sourceFinished.store(true, std::memory_order_relaxed);}
+
+		/// @brief Number of callbacks so far
+		long long getCallbackCount() const {return callbackCount.load(std::memory_order_relaxed);}
+
+		/// @brief Callbacks that found too little data in the buffer or were flagged paOutputUnderflow by the host
+		long long getUnderrunCount() const {return underrunCount.load(std::memory_order_relaxed);}
+
+		/// @brief RMS deviation of the callback interval from the buffer period, in seconds
+		double getCallbackJitter() const;
+
+		/// @brief Largest deviation of the callback interval from the buffer period, in seconds
+		double getMaxCallbackJitter() const {return maxJitter.load(std::memory_order_relaxed);}
+
 		// Disable copy constructor and assignment operator
 		AudioOutput(const AudioOutput&) = delete;
 		AudioOutput& operator=(const AudioOutput&) = delete;
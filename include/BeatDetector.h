@@ -0,0 +1,103 @@
+#ifndef BEAT_DETECTOR_H
+#define BEAT_DETECTOR_H
+
+#include <vector>
+
+/**
+ * @class BeatDetector
+ * @brief Onset and tempo detection driven by the magnitude spectrum AudioAnalyzer already computes
+ *
+ * Each analysis frame is reduced to a spectral flux novelty value (positive change of the log compressed spectrum).
+ * Onsets are novelty peaks above an adaptive threshold (running mean + k * standard deviation),
+ * and the tempo is the strongest lag of a rolling autocorrelation of the novelty curve.
+ * All buffers are sized in the constructor, process() does not allocate and costs O(bins + lags) per frame.
+ */
+class BeatDetector{
+	private:
+		int spectrumSize;						///< Number of magnitude bins per frame
+		float compression;						///< Log compression factor applied before the flux
+		float thresholdMultiplier;				///< k in mean + k * stddev
+		float minimumThreshold;					///< Floor for the threshold so silence does not trigger onsets
+
+		std::vector<float> previousLogSpectrum;	///< Log compressed spectrum of the previous frame
+		bool hasPrevious;						///< False until the first frame was seen
+
+		// Adaptive threshold over a short running window of flux values
+		std::vector<float> fluxHistory;			///< Ring of recent flux values
+		int fluxIndex;							///< Next write position in fluxHistory
+		int fluxCount;							///< Valid entries in fluxHistory
+		double fluxSum;							///< Running sum of fluxHistory
+		double fluxSumSquares;					///< Running sum of squares of fluxHistory
+
+		// Peak picking state, onsets are reported one frame late so the peak can be confirmed
+		float lastFlux;							///< Flux of the previous frame
+		float lastThreshold;					///< Threshold that applied to the previous frame
+		float secondLastFlux;					///< Flux two frames ago
+		double lastFrameTime;					///< Time of the previous frame
+		double lastBeatTime;					///< Time of the last reported beat
+
+		// Rolling autocorrelation of the novelty curve
+		int minLag;								///< Shortest lag considered (fastest tempo), in frames
+		int maxLag;								///< Longest lag considered (slowest tempo), in frames
+		int noveltyWindow;						///< Frames in the autocorrelation window
+		std::vector<float> novelty;				///< Ring of novelty values, sized noveltyWindow + maxLag
+		int noveltyIndex;						///< Next write position in novelty
+		long long noveltyCount;					///< Total novelty values pushed
+		std::vector<double> autocorrelation;	///< Running autocorrelation per lag (index = lag - minLag)
+		double framePeriod;						///< Smoothed measured time between frames, in seconds
+
+		// Results of the most recent frame
+		bool beat;								///< True if the latest frame confirmed a beat
+		float beatStrength;						///< Normalized strength of that beat (0 to 1)
+		float tempoBpm;							///< Current tempo estimate, 0 until enough history
+		float currentNovelty;					///< Flux of the latest frame
+
+		/// @brief Computes half wave rectified flux between the spectrum and the previous frame
+		float _computeFlux(const std::vector<float>& spectrum);
+
+		/// @brief Adds a flux value to the threshold window and returns the threshold for it
+		float _updateThreshold(float flux);
+
+		/// @brief Pushes a novelty value and updates the autocorrelation incrementally
+		void _updateAutocorrelation(float value);
+
+		/// @brief Recomputes the autocorrelation from scratch to bound accumulated rounding error
+		void _recomputeAutocorrelation();
+
+		/// @brief Novelty value pushed `age` frames ago (0 = newest)
+		float _noveltyAt(long long age) const;
+
+		/// @brief Picks the strongest autocorrelation lag and converts it to BPM
+		void _estimateTempo();
+
+	public:
+		/// @brief Constructor sizes all buffers for the given spectrum and tempo range
+		/// @param spectrumSize Number of magnitude bins (fftSize / 2 + 1)
+		/// @param frameRate Nominal analysis frames per second, used to size the lag range
+		/// @param minBpm Slowest tempo to detect
+		/// @param maxBpm Fastest tempo to detect
+		BeatDetector(int spectrumSize, float frameRate = 60.0f, float minBpm = 60.0f, float maxBpm = 200.0f);
+
+		/// @brief Processes one analysis frame
+		/// @param spectrum Magnitude spectrum from AudioAnalyzer::getSpectrum
+		/// @param frameTime Time of the frame in seconds, used to measure the actual frame rate
+		void process(const std::vector<float>& spectrum, double frameTime);
+
+		/// @brief Clears all history
+		void reset();
+
+		/// @brief True if a beat was confirmed by the latest frame (one frame of latency)
+		bool isBeat() const {return beat;}
+
+		/// @brief Strength of the latest beat, 0 to 1
+		float getBeatStrength() const {return beatStrength;}
+
+		/// @brief Current tempo estimate
+		/// @return Beats per minute, 0 if not enough history yet
+		float getTempo() const {return tempoBpm;}
+
+		/// @brief Spectral flux novelty of the latest frame
+		float getOnsetStrength() const {return currentNovelty;}
+};
+
+#endif
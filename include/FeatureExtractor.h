@@ -0,0 +1,117 @@
+#ifndef FEATURE_EXTRACTOR_H
+#define FEATURE_EXTRACTOR_H
+
+#include <vector>
+#include <cstddef>
+#include "SampleStore.h"
+
+/**
+ * @class FeatureExtractor
+ * @brief Mel spectrogram, MFCC and delta features computed from the magnitude spectrum AudioAnalyzer already produces
+ *
+ * Each spectrum is squared to power, reduced by a sparse triangular mel filterbank (only the nonzero weights of
+ * every filter are stored), log compressed and turned into MFCCs with an orthonormal DCT-II. Deltas are the usual
+ * regression over +-deltaWidth frames, with the first and last frame repeated at the edges.
+ *
+ * A row holds melBands log mel energies, then coefficients MFCCs, then coefficients deltas.
+ * The live path streams spectra through process() (rows come out deltaWidth frames late, flush() drains the rest),
+ * the offline path computes the static part of many rows in parallel with computeStatic() and fills the deltas
+ * afterwards with computeDeltas(). Both produce identical rows for the same spectra.
+ */
+class FeatureExtractor{
+	public:
+		static constexpr int maxDeltaWidth = 16;	///< Widest delta regression supported
+
+	private:
+		int spectrumSize;					///< Magnitude bins per spectrum (fftSize / 2 + 1)
+		float spectrumSampleRate;			///< Sample rate the spectrum's bins are spaced for
+		int melBands;						///< Number of mel filters
+		int coefficients;					///< MFCCs kept per frame
+		int deltaWidth;						///< Frames on each side of the delta regression
+		float lowFreq;						///< Lower edge of the lowest mel filter
+		float highFreq;						///< Upper edge of the highest mel filter
+
+		// Sparse filterbank, filter i weighs bins filterStart[i] onwards with filterWeights[filterOffset[i]...]
+		std::vector<int> filterStart;		///< First nonzero bin of each filter
+		std::vector<int> filterLength;		///< Nonzero bins of each filter
+		std::vector<int> filterOffset;		///< Start of each filter in filterWeights
+		std::vector<float> filterWeights;	///< Nonzero weights of all filters back to back
+
+		std::vector<float> dctMatrix;		///< Orthonormal DCT-II, coefficients x melBands row major
+		std::vector<float> power;			///< Power spectrum scratch
+
+		// Streaming state
+		std::vector<float> history;			///< Ring of the last 2 * deltaWidth + 1 rows (static part filled)
+		std::vector<float> row;				///< Latest complete row
+		long long framesIn;					///< Spectra pushed since the last reset
+		long long framesOut;				///< Rows completed since the last reset
+
+		/// @brief Builds the sparse mel filterbank for the current spectrum size
+		void _setupFilterbank();
+
+		/// @brief Computes the deltas of one frame from pointers to the MFCCs of its 2 * deltaWidth + 1 neighbours
+		void _computeDelta(const float* const* context, float* delta) const;
+
+		/// @brief Completes row for frame, lastFrame bounds the context at the end of the stream
+		void _emitRow(long long frame, long long lastFrame);
+
+	public:
+		/// @brief Constructor builds the filterbank and DCT tables
+		/// @param spectrumSize Number of magnitude bins (fftSize / 2 + 1)
+		/// @param spectrumSampleRate Sample rate the analyzer's bins are spaced for
+		/// @param melBands Number of mel filters
+		/// @param coefficients MFCCs per frame, at most melBands
+		/// @param deltaWidth Frames on each side used for the deltas, 1 to maxDeltaWidth
+		/// @param lowFreq Lower edge of the filterbank in Hz
+		/// @param highFreq Upper edge of the filterbank in Hz, limited to half of spectrumSampleRate
+		FeatureExtractor(int spectrumSize, float spectrumSampleRate, int melBands = 40, int coefficients = 13,
+			int deltaWidth = 2, float lowFreq = 20.0f, float highFreq = 8000.0f);
+
+		/// @brief Rebuilds the filterbank for a new FFT size, the delta history is kept since the rows do not change shape
+		void setSpectrumSize(int size);
+
+		/// @brief Computes log mel energies and MFCCs of one spectrum, the stateless part of a row
+		/// @param spectrum Magnitude spectrum, spectrumSize bins
+		/// @param frame Output row, the delta columns are left untouched
+		void computeStatic(const float* spectrum, float* frame);
+
+		/// @brief Fills the delta columns of rows whose static part is already computed
+		/// @param rows Row major matrix, getColumns() floats per row
+		/// @param rowCount Number of rows, treated as the whole stream
+		void computeDeltas(float* rows, size_t rowCount) const;
+
+		/// @brief Pushes one spectrum through the streaming path
+		/// @return True if a row completed, read it with getRow()
+		bool process(const float* spectrum);
+
+		/// @brief Completes one of the rows still waiting for future frames, call until it returns false at the end of the stream
+		bool flush();
+
+		/// @brief Clears the streaming history
+		void reset();
+
+		/// @brief Latest complete row
+		const float* getRow() const {return row.data();}
+
+		/// @brief Floats per row
+		int getColumns() const {return melBands + 2 * coefficients;}
+
+		/// @brief Number of mel filters
+		int getMelBands() const {return melBands;}
+
+		/// @brief MFCCs per row
+		int getCoefficients() const {return coefficients;}
+
+		/// @brief Frames on each side of the delta regression
+		int getDeltaWidth() const {return deltaWidth;}
+
+		/// @brief Offline extraction (--extract-features): every hop of half a 1024 sample window of a file through the
+		/// live path's analysis and features, plus the integrated loudness, loudness range and true peak of the file
+		/// @param audioFile Audio file to analyze
+		/// @param outFile Feature file to write
+		/// @param format Sample storage layout used while decoding
+		/// @return False if the file could not be loaded or the feature file not written
+		static bool extractFile(const char* audioFile, const char* outFile, SampleFormat format);
+};
+
+#endif
@@ -0,0 +1,100 @@
+#ifndef FEATURE_WRITER_H
+#define FEATURE_WRITER_H
+
+#include <cstdio>
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+/**
+ * @file FeatureWriter.h
+ * @brief Memory mappable feature matrix files written by FeatureWriter
+ *
+ * A file is one 64 byte FeatureFileHeader followed by rows x columns little endian float32 values, row major,
+ * starting at byte 64. Readers can map the file and use the data in place, e.g.
+ * numpy.memmap(path, dtype='<f4', mode='r', offset=64, shape=(rows, columns)).
+ * rows is written when the file is closed and stays 0 in a file that was not closed properly.
+ */
+
+namespace FeatureFiles {
+	constexpr uint32_t magic = 0x4D564147;		///< "GAVM" in the first four bytes
+	constexpr uint32_t layoutVersion = 1;		///< Bumped whenever FeatureFileHeader changes
+	constexpr int batchRows = 256;				///< Rows buffered before a write
+}
+
+/// @brief Description at the start of a feature file
+struct FeatureFileHeader{
+	uint32_t magic;							///< FeatureFiles::magic
+	uint32_t version;						///< FeatureFiles::layoutVersion
+	uint64_t rows;							///< Number of rows (analysis frames)
+	uint32_t columns;						///< Floats per row
+	uint32_t melBands;						///< Log mel columns at the start of each row
+	uint32_t coefficients;					///< MFCC columns, followed by as many delta columns
+	uint32_t deltaWidth;					///< Frames on each side of the delta regression
+	uint32_t sampleRate;					///< Sample rate the analyzed spectrum is spaced for
+	uint32_t fftSize;						///< Samples per FFT
+	uint32_t hopSamples;					///< Samples between rows, 0 if rows follow the live analysis rate
+	uint32_t reserved[5];
+};
+
+static_assert(sizeof(FeatureFileHeader) == 64, "feature rows must start at byte 64");
+
+class FeatureExtractor;
+
+/**
+ * @class FeatureWriter
+ * @brief Writes feature rows in batches of FeatureFiles::batchRows to a feature file
+ */
+class FeatureWriter{
+	private:
+		std::FILE* file;					///< Open output file, nullptr when closed
+		FeatureFileHeader header;			///< Header written on open and again with the row count on close
+		std::vector<float> pending;			///< Rows not written yet
+
+		/// @brief Writes the pending rows
+		bool _writePending();
+
+	public:
+		/// @brief Constructor leaves the writer closed
+		FeatureWriter();
+
+		/// @brief Closes the file
+		~FeatureWriter();
+
+		/// @brief Header fields of a file holding an extractor's rows
+		/// @param extractor Extractor whose row shape is described
+		/// @param spectrumRate Sample rate the analyzed spectrum is spaced for
+		/// @param fftSize Samples per FFT
+		/// @param hopSamples Samples between rows, 0 if rows follow the live analysis rate
+		static FeatureFileHeader layoutOf(const FeatureExtractor& extractor, float spectrumRate, int fftSize, int hopSamples);
+
+		/// @brief Creates (or replaces) a feature file
+		/// @param path Output path
+		/// @param layout Header fields, magic, version and rows are filled in by the writer
+		/// @return True on success
+		bool open(const char* path, const FeatureFileHeader& layout);
+
+		/// @brief Appends one row
+		void writeRow(const float* row);
+
+		/// @brief Appends rows in one write
+		/// @param rows Row major matrix, header columns floats per row
+		/// @param rowCount Number of rows
+		void writeRows(const float* rows, size_t rowCount);
+
+		/// @brief Writes pending rows and the final row count, then closes the file
+		/// @return True if everything was written
+		bool close();
+
+		/// @brief Checks if a file is open
+		bool isOpen() const {return file != nullptr;}
+
+		/// @brief Rows appended so far
+		uint64_t getRowCount() const;
+
+		// Disable copy constructor and assignment operator
+		FeatureWriter(const FeatureWriter&) = delete;
+		FeatureWriter& operator=(const FeatureWriter&) = delete;
+};
+
+#endif
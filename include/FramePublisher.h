@@ -0,0 +1,64 @@
+#ifndef FRAME_PUBLISHER_H
+#define FRAME_PUBLISHER_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include "SharedFrameLayout.h"
+
+/**
+ * @class FramePublisher
+ * @brief Publishes analysis frames into a POSIX shared memory ring for external processes
+ *
+ * Lets LED walls, lighting controllers and other local consumers read the same bucket data as the Visualizer.
+ * Publishing is wait-free: the writer never waits for readers, slow readers simply see newer frames.
+ * Readers use FrameReader to access the ring. Not available on Windows (open() returns false).
+ */
+class FramePublisher{
+	private:
+		std::string name;					///< shm_open name of the ring
+		void* mapping;						///< Start of the mapped shared memory
+		size_t mappingSize;					///< Size of the mapping in bytes
+		SharedFrameHeader* header;			///< Ring header inside the mapping
+		SharedFrameSlot* slots;				///< First slot inside the mapping
+		uint64_t nextSequence;				///< Sequence number of the next published frame
+		uint64_t objectDevice;				///< st_dev of the shared memory object created by open()
+		uint64_t objectInode;				///< st_ino of the shared memory object created by open()
+
+	public:
+		/// @brief Constructor leaves the publisher closed
+		FramePublisher();
+
+		/// @brief Unmaps the ring and unlinks it if it is still ours
+		~FramePublisher();
+
+		/// @brief Creates the shared memory ring
+		/// @param shmName Name passed to shm_open, must start with '/'
+		/// @param slotCount Number of frames kept in the ring
+		/// @param sampleRate Sample rate of the analyzed audio, stored in the header for readers
+		/// @param replace Take over a ring of the same name (e.g. left behind by a crashed run) instead of failing
+		/// @return True on success, false if the ring could not be created or already exists
+		bool open(const char* shmName, int slotCount, int sampleRate, bool replace = false);
+
+		/// @brief Unmaps the ring, called by the destructor
+		///
+		/// The name is only unlinked while it still refers to the object this publisher created. If another
+		/// instance replaced the ring (--force), its live ring is left alone.
+		void close();
+
+		/// @brief Writes one frame into the next slot
+		/// @param buckets Visualization buckets, truncated to SharedFrames::maxBuckets
+		/// @param rms RMS value of the analysis block
+		/// @param peak Peak amplitude of the analysis block
+		void publish(const std::vector<float>& buckets, float rms, float peak);
+
+		/// @brief Checks if the ring is open
+		bool isOpen() const {return mapping != nullptr;}
+
+		// Disable copy constructor and assignment operator
+		FramePublisher(const FramePublisher&) = delete;
+		FramePublisher& operator=(const FramePublisher&) = delete;
+};
+
+#endif
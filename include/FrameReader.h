@@ -0,0 +1,105 @@
+#ifndef FRAME_READER_H
+#define FRAME_READER_H
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+#include "SharedFrameLayout.h"
+
+/// @brief Reader side copy of one published analysis frame
+struct AnalysisFrame{
+	uint64_t sequence;								///< Frame sequence number
+	int64_t timestampNs;							///< CLOCK_MONOTONIC publication time in nanoseconds
+	float rms;										///< RMS of the analysis block
+	float peak;										///< Peak amplitude of the analysis block
+	int bucketCount;								///< Valid entries in buckets
+	std::array<float, SharedFrames::maxBuckets> buckets;	///< Visualization buckets
+};
+
+/// @brief Publisher to reader latency measured by a FrameReader
+struct FrameLatencyStats{
+	uint64_t frames;								///< Frames the statistics cover
+	int64_t minNs;									///< Lowest latency seen
+	int64_t maxNs;									///< Highest latency seen
+	double meanNs;									///< Mean latency
+};
+
+/**
+ * @class FrameReader
+ * @brief Small client library for polling the analysis frame ring written by FramePublisher
+ *
+ * Reading is a pair of atomic loads around a memcpy, with no syscalls and no locks, so any number of
+ * reader processes can poll as fast as they like without slowing the publisher. Every successful read
+ * records the time since publication, which gives the process to process latency of the ring.
+ */
+class FrameReader{
+	private:
+		void* mapping;						///< Start of the mapped shared memory (read only)
+		size_t mappingSize;					///< Size of the mapping in bytes
+		const SharedFrameHeader* header;	///< Ring header inside the mapping
+		const SharedFrameSlot* slots;		///< First slot inside the mapping
+		uint64_t lastSequence;				///< Sequence number of the last frame returned
+		uint64_t droppedFrames;				///< Frames overwritten before this reader got to them
+		FrameLatencyStats latency;			///< Latency statistics of returned frames
+
+		/// @brief Copies a slot if its seqlock is stable and it holds the expected sequence number
+		bool _readSlot(uint64_t sequence, AnalysisFrame& frame) const;
+
+		/// @brief Adds the latency of a frame read right now to the statistics
+		void _recordLatency(const AnalysisFrame& frame);
+
+	public:
+		/// @brief Constructor leaves the reader closed
+		FrameReader();
+
+		/// @brief Unmaps the ring
+		~FrameReader();
+
+		/// @brief Maps an existing ring created by FramePublisher
+		/// @param shmName Name passed to shm_open by the publisher
+		/// @return True on success, false if the ring does not exist or has an incompatible layout
+		bool open(const char* shmName = SharedFrames::defaultName);
+
+		/// @brief Unmaps the ring, called by the destructor
+		void close();
+
+		/// @brief Gets the newest frame if it is newer than the last one returned, skipping any in between
+		/// @param frame Destination for the frame
+		/// @return True if a new frame was copied
+		bool readLatest(AnalysisFrame& frame);
+
+		/// @brief Gets the frame after the last one returned, so no frames are missed while the reader keeps up
+		/// @param frame Destination for the frame
+		/// @return True if a frame was copied, false if the reader is up to date
+		bool readNext(AnalysisFrame& frame);
+
+		/// @brief Marks every frame published so far as read, the next read returns a frame published after this call
+		void skipToLatest();
+
+		/// @brief Sample rate of the audio the publisher analyzes
+		int getSampleRate() const;
+
+		/// @brief Frames that were overwritten before readNext reached them
+		uint64_t getDroppedFrames() const {return droppedFrames;}
+
+		/// @brief Publisher to reader latency of all frames returned so far
+		const FrameLatencyStats& getLatencyStats() const {return latency;}
+
+		/// @brief Checks if the ring is mapped
+		bool isOpen() const {return mapping != nullptr;}
+
+		/// @brief Current CLOCK_MONOTONIC time, the clock frames are stamped with
+		static int64_t monotonicNowNs();
+
+		/// @brief Polls a ring as fast as possible and prints the publisher to reader latency every second, until no
+		/// frame arrived for two seconds (the publisher stopped)
+		/// @param shmName Name passed to shm_open by the publisher
+		/// @return False if the ring could not be opened
+		static bool monitorLatency(const char* shmName);
+
+		// Disable copy constructor and assignment operator
+		FrameReader(const FrameReader&) = delete;
+		FrameReader& operator=(const FrameReader&) = delete;
+};
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef INPUT_SOURCE_H
+#define INPUT_SOURCE_H
+
+/**
+ * @class InputSource
+ * @brief Interface for live sample sources that push audio into an AudioBuffer as it arrives
+ *
+ * File playback pulls samples with AudioBuffer::fillBuffer, live sources instead write into the buffer
+ * from their own thread (the PortAudio input callback, or a pacing thread for the virtual device).
+ * Every implementation stamps the newest sample it wrote so end to end latency can be measured.
+ */
+class InputSource{
+	public:
+		virtual ~InputSource() = default;
+
+		/// @brief Starts delivering samples into the AudioBuffer
+		/// @return True on success, false on failure
+		virtual bool start() = 0;
+
+		/// @brief Stops delivering samples
+		/// @return True on success, false on failure
+		virtual bool stop() = 0;
+
+		/// @brief Checks if the source is still delivering samples
+		virtual bool isActive() const = 0;
+
+		/// @brief Sample rate of the delivered samples
+		virtual int getSampleRate() const = 0;
+
+		/// @brief Number of interleaved channels of the delivered samples
+		virtual int getChannels() const = 0;
+
+		/// @brief Age of the newest sample written into the AudioBuffer
+		/// @return Seconds since the newest delivered sample was captured, negative if nothing was captured yet
+		virtual double getCaptureLatency() const = 0;
+
+		/// @brief Samples dropped because the AudioBuffer was full
+		virtual long long getDroppedSamples() const = 0;
+};
+
+#endif
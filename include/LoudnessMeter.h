@@ -0,0 +1,141 @@
+#ifndef LOUDNESS_METER_H
+#define LOUDNESS_METER_H
+
+#include <vector>
+#include <atomic>
+#include <cstdint>
+#include "SampleTap.h"
+
+/**
+ * @class LoudnessMeter
+ * @brief Streaming ITU-R BS.1770 loudness meter (momentary, short-term, integrated LUFS and true peak)
+ *
+ * Every sample is processed exactly once: samples are K-weighted with two biquads per channel,
+ * accumulated into 100 ms sub-blocks, and the 400 ms / 3 s windows are assembled from those sub-blocks.
+ * The filter state of all channels sits side by side, so each frame runs the biquads of two channels per
+ * SSE2 / NEON (AArch64) instruction, and the four true peak phases of a channel are evaluated together.
+ * Integrated loudness uses the absolute (-70 LUFS) and relative (-10 LU) gates over a fixed-size
+ * histogram of gating blocks, so memory stays constant no matter how long the stream runs. Loudness range
+ * (EBU Tech 3342) comes from a second histogram of the short-term values, one per 100 ms.
+ * True peak is measured on a 4x polyphase oversampled signal.
+ *
+ * Results are published through atomics, so getters can be called from a different thread than processSamples.
+ */
+class LoudnessMeter : public SampleTap{
+	private:
+		static constexpr int maxChannels = 8;				///< Highest channel count the meter supports
+		static constexpr int oversampleFactor = 4;			///< True peak oversampling factor
+		static constexpr int tapsPerPhase = 12;				///< FIR taps per polyphase branch
+		static constexpr int shortTermSubBlocks = 30;		///< 100 ms sub-blocks in the 3 s short-term window
+		static constexpr int momentarySubBlocks = 4;		///< 100 ms sub-blocks in the 400 ms momentary window
+		static constexpr float histogramMinLufs = -70.0f;	///< Absolute gate, lowest loudness kept in the histogram
+		static constexpr float histogramStepLu = 0.1f;		///< Histogram resolution
+		static constexpr int histogramBins = 800;			///< Covers -70 to +10 LUFS
+
+		int sampleRate;						///< Sample rate of the metered stream
+		int channels;						///< Number of interleaved channels
+
+		// K-weighting filter (stage 1 high shelf, stage 2 RLB high pass), shared coefficients, per channel state
+		double shelfB[3];					///< High shelf feed-forward coefficients
+		double shelfA[2];					///< High shelf feedback coefficients (a1, a2)
+		double highPassB[3];				///< RLB high pass feed-forward coefficients
+		double highPassA[2];				///< RLB high pass feedback coefficients (a1, a2)
+		int filterChannels;					///< Channel count rounded up to even, the biquads run in pairs
+		double shelfState[2][maxChannels];	///< Transposed direct form II state of the shelf, per channel
+		double highPassState[2][maxChannels];	///< Transposed direct form II state of the high pass, per channel
+		double channelWeights[maxChannels];	///< BS.1770 channel weights (surrounds 1.41, LFE 0)
+
+		// Partial frame carried between calls, since fillBuffer may stop in the middle of a frame
+		float carry[maxChannels];			///< Samples of the incomplete frame
+		int carryCount;						///< Number of samples held in carry
+
+		// 100 ms sub-block accumulation
+		int subBlockSize;					///< Frames per 100 ms sub-block
+		int subBlockFill;					///< Frames accumulated in the current sub-block
+		double subBlockEnergy[maxChannels];	///< Sum of squared K-weighted samples per channel
+		double subBlockHistory[shortTermSubBlocks];	///< Weighted mean square of recent sub-blocks (ring)
+		int historyIndex;					///< Next write position in subBlockHistory
+		int historyCount;					///< Valid entries in subBlockHistory
+
+		// Integrated loudness histogram of gated 400 ms blocks
+		std::vector<double> histogramEnergy;	///< Sum of block energies that fell into each bin
+		std::vector<uint64_t> histogramCount;	///< Number of blocks that fell into each bin
+
+		// Loudness range histogram of 3 s short-term values
+		std::vector<double> rangeEnergy;		///< Sum of short-term energies that fell into each bin
+		std::vector<uint64_t> rangeCount;		///< Number of short-term values that fell into each bin
+
+		// True peak
+		float polyphaseTaps[tapsPerPhase][oversampleFactor];	///< Interpolation filter, the phases of each tap side by side
+		std::vector<float> peakHistory;		///< Per channel input history, stored twice so each window is contiguous
+		int peakHistoryPos;					///< Current position in the doubled history
+		float truePeakLinear;				///< Highest oversampled absolute value seen so far
+
+		// Published results
+		std::atomic<float> momentaryLufs;
+		std::atomic<float> shortTermLufs;
+		std::atomic<float> integratedLufs;
+		std::atomic<float> loudnessRange;
+		std::atomic<float> truePeakDb;
+
+		/// @brief Computes K-weighting biquad coefficients for the current sample rate
+		void _computeFilterCoefficients();
+
+		/// @brief Designs the windowed-sinc interpolation filter and splits it into polyphase branches
+		void _computePolyphaseTaps();
+
+		/// @brief Runs one complete interleaved frame through K-weighting, gating accumulation and true peak
+		void _processFrame(const float* frame);
+
+		/// @brief Closes the current 100 ms sub-block and updates momentary, short-term and integrated values
+		void _finishSubBlock();
+
+		/// @brief Mean weighted energy of the newest count sub-blocks
+		double _windowEnergy(int count) const;
+
+		/// @brief Applies the relative gate to the histogram and publishes integrated loudness
+		void _updateIntegrated();
+
+		/// @brief Applies the -20 LU relative gate to the short-term histogram and publishes the loudness range
+		void _updateRange();
+
+	public:
+		/// @brief Constructs a meter for a stream of the given format
+		/// @param sampleRate Sample rate in Hz
+		/// @param channels Number of interleaved channels (1 to 8)
+		LoudnessMeter(int sampleRate, int channels);
+
+		/// @brief Feeds interleaved samples, called by AudioBuffer as it fills or directly for offline measurement
+		/// @param samples Interleaved samples
+		/// @param sampleCount Number of samples, does not need to be a whole number of frames
+		void processSamples(const float* samples, int sampleCount) override;
+
+		/// @brief Clears all filter state, windows, histogram and peak
+		void reset();
+
+		/// @brief Loudness of the last 400 ms
+		/// @return Momentary loudness in LUFS, -inf until 400 ms were processed
+		float getMomentaryLoudness() const {return momentaryLufs.load(std::memory_order_relaxed);}
+
+		/// @brief Loudness of the last 3 s
+		/// @return Short-term loudness in LUFS, -inf until 3 s were processed
+		float getShortTermLoudness() const {return shortTermLufs.load(std::memory_order_relaxed);}
+
+		/// @brief Gated loudness of everything processed since construction or reset
+		/// @return Integrated loudness in LUFS, -inf if no block passed the gates
+		float getIntegratedLoudness() const {return integratedLufs.load(std::memory_order_relaxed);}
+
+		/// @brief Spread of the short-term loudness, 95th minus 10th percentile of the gated short-term values
+		/// @return Loudness range in LU, 0 until 3 s were processed
+		float getLoudnessRange() const {return loudnessRange.load(std::memory_order_relaxed);}
+
+		/// @brief Highest 4x oversampled peak seen so far
+		/// @return True peak in dBTP
+		float getTruePeak() const {return truePeakDb.load(std::memory_order_relaxed);}
+
+		// Disable copy constructor and assignment operator
+		LoudnessMeter(const LoudnessMeter&) = delete;
+		LoudnessMeter& operator=(const LoudnessMeter&) = delete;
+};
+
+#endif
@@ -0,0 +1,125 @@
+#ifndef PITCH_ANALYZER_H
+#define PITCH_ANALYZER_H
+
+#include <vector>
+#include <atomic>
+#include <cstdint>
+#include <fftw3.h>
+#include "SampleTap.h"
+
+/**
+ * @class PitchAnalyzer
+ * @brief Fundamental frequency (YIN) and 12 bin chroma of the stream, for note reactive visuals
+ *
+ * As a SampleTap it only downmixes every sample into a mono history ring, which is cheap enough for the
+ * thread filling the AudioBuffer (or an input callback). update() runs on the analysis thread and analyzes the
+ * newest window once, however many samples arrived, so its cost per analysis frame is fixed: one forward FFT
+ * of the Hann windowed block (zero padded to twice its length), the power spectrum, one inverse FFT for the
+ * autocorrelation and O(lags + bins) loops. The autocorrelation is divided by the window's own autocorrelation
+ * (Boersma) and fed to YIN's cumulative mean normalized difference; the chroma comes from the same power
+ * spectrum's peaks and is smoothed with a time constant, so it does not depend on how often update() runs.
+ * The window is the power of two that holds two periods of minFreq, AudioAnalyzer's interleaved block is too
+ * short for bass notes.
+ */
+class PitchAnalyzer : public SampleTap{
+	public:
+		static constexpr int pitchClasses = 12;		///< Chroma bins, C = 0 ... B = 11
+
+	private:
+		static constexpr int maxChannels = 8;		///< Highest channel count the downmix supports
+
+		int sampleRate;							///< Sample rate of the stream
+		int channels;							///< Interleaved channels of the stream
+		int windowSize;							///< Mono samples analyzed per update
+		int minLag;								///< Shortest period searched (maxFreq), in samples
+		int maxLag;								///< Longest period searched (minFreq), in samples
+		float threshold;						///< YIN absolute threshold on the normalized difference
+		float chromaSeconds;					///< Chroma smoothing time constant
+
+		// Mono history, written by processSamples and read by update() from another thread
+		std::vector<float> history;				///< Ring of mono samples, four windows long (power of two)
+		std::atomic<uint64_t> framesWritten;	///< Mono samples written since construction
+		float carry[maxChannels];				///< Samples of an incomplete interleaved frame
+		int carryCount;							///< Number of samples held in carry
+		uint64_t framesAnalyzed;				///< framesWritten at the latest update
+
+		// FFT of the zero padded window, planned by initialize()
+		int fftSize;							///< Twice windowSize, so the autocorrelation does not wrap
+		float* fftInput;						///< Windowed block, then the autocorrelation
+		fftwf_complex* fftOutput;				///< Spectrum, then the power spectrum
+		fftwf_plan forwardPlan;					///< fftInput to fftOutput
+		fftwf_plan inversePlan;					///< fftOutput to fftInput
+		std::vector<float> windowFunction;		///< Hann window
+		std::vector<float> windowCorrelation;	///< Autocorrelation of the Hann window per lag
+		std::vector<float> difference;			///< Cumulative mean normalized difference per lag
+		int chromaHighBin;						///< Last spectrum bin searched for chroma peaks
+
+		// Results of the latest update
+		std::vector<float> chroma;				///< Smoothed chroma, the strongest class tends to 1
+		std::vector<float> frameChroma;			///< Chroma of the latest window alone
+		float frequency;						///< Fundamental frequency in Hz, 0 if unvoiced
+		float confidence;						///< 1 - normalized difference at the chosen lag, 0 if unvoiced
+		int pitchClass;							///< Pitch class of frequency, -1 if unvoiced
+
+		/// @brief Copies the newest window from the ring, retried if the writer lapped it
+		bool _readWindow(uint64_t& written);
+
+		/// @brief YIN on the autocorrelation in fftInput, sets frequency, confidence and pitchClass
+		void _estimatePitch();
+
+		/// @brief Accumulates the power spectrum's peaks into frameChroma and smooths chroma
+		void _updateChroma(double elapsedSeconds);
+
+	public:
+		/// @brief Constructor sizes all buffers, the FFT is planned by initialize()
+		/// @param sampleRate Sample rate of the stream
+		/// @param channels Interleaved channels, downmixed to mono
+		/// @param minFreq Lowest fundamental searched
+		/// @param maxFreq Highest fundamental searched
+		/// @param threshold YIN threshold, lower is stricter
+		/// @param chromaSeconds Chroma smoothing time constant
+		PitchAnalyzer(int sampleRate, int channels, float minFreq = 50.0f, float maxFreq = 1000.0f, float threshold = 0.15f, float chromaSeconds = 0.15f);
+
+		/// @brief Frees FFTW buffers and plans
+		~PitchAnalyzer();
+
+		/// @brief Plans the FFTs, must not run concurrently with other FFTW planning
+		/// @return True on success
+		bool initialize();
+
+		/// @brief Downmixes interleaved samples into the history, lock free
+		/// @param samples Interleaved samples
+		/// @param sampleCount Number of samples, does not need to be a whole number of frames
+		void processSamples(const float* samples, int sampleCount) override;
+
+		/// @brief Analyzes the newest window
+		/// @return False if nothing new arrived since the last update, the history is shorter than a window or the FFT is not planned
+		bool update();
+
+		/// @brief Smoothed chroma, C to B, each window normalized so its strongest class is 1 (decays to 0 in silence)
+		const std::vector<float>& getChroma() const {return chroma;}
+
+		/// @brief Fundamental frequency of the latest window
+		/// @return Hz, 0 if unvoiced
+		float getFrequency() const {return frequency;}
+
+		/// @brief How periodic the latest window is at the reported frequency (0 to 1)
+		float getConfidence() const {return confidence;}
+
+		/// @brief Pitch class of the fundamental (C = 0)
+		/// @return 0 to 11, -1 if unvoiced
+		int getPitchClass() const {return pitchClass;}
+
+		/// @brief Strongest chroma class, also defined for chords and unpitched frames
+		/// @return 0 to 11, -1 in silence
+		int getDominantChroma() const;
+
+		/// @brief Mono samples analyzed per update
+		int getWindowSize() const {return windowSize;}
+
+		// Disable copy constructor and assignment operator
+		PitchAnalyzer(const PitchAnalyzer&) = delete;
+		PitchAnalyzer& operator=(const PitchAnalyzer&) = delete;
+};
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef PRESENTATION_SCHEDULER_H
+#define PRESENTATION_SCHEDULER_H
+
+#include <vector>
+#include <cstddef>
+
+/**
+ * @class PresentationScheduler
+ * @brief Turns timestamped analysis frames into bar heights for the exact audio time on screen
+ *
+ * Analysis frames are stamped with the audio time at the center of their window and kept in a short history.
+ * Every rendered frame asks for the audio time being heard: the buckets are interpolated linearly between the
+ * two frames around it (held at the newest frame if playback got ahead of analysis), then smoothed with separate
+ * attack and release time constants in seconds, so motion no longer depends on how often analysis or rendering runs.
+ * Peak caps hold each bar's maximum for peakHoldSeconds and then fall at peakFallRate per second.
+ */
+class PresentationScheduler{
+	public:
+		static constexpr int historyFrames = 8;		///< Analysis frames kept for interpolation
+
+	private:
+		float attackSeconds;					///< Time constant while a bar rises
+		float releaseSeconds;					///< Time constant while a bar falls
+		float peakHoldSeconds;					///< How long a peak cap stays put
+		float peakFallRate;						///< Bucket units per second a cap falls after the hold
+
+		// History of analysis frames, a ring ordered by audio time
+		std::vector<std::vector<float>> frames;	///< Buckets of each frame
+		std::vector<double> frameTimes;			///< Audio time of each frame
+		int newest;								///< Index of the newest frame
+		int count;								///< Valid frames in the history
+
+		std::vector<float> target;				///< Interpolated buckets at the presented time
+		std::vector<float> heights;				///< Smoothed bar heights
+		std::vector<float> peaks;				///< Peak cap heights
+		std::vector<float> peakAges;			///< Seconds since each cap was last pushed up
+		double lastDisplayTime;					///< Display time of the previous present, negative if none
+
+		/// @brief Resizes all per bar state, clearing it
+		void _resize(size_t bars);
+
+	public:
+		/// @brief Constructor sets the smoothing and peak cap behaviour
+		/// @param attackSeconds Rise time constant
+		/// @param releaseSeconds Fall time constant
+		/// @param peakHoldSeconds Time a peak cap holds before falling
+		/// @param peakFallRate Speed of a falling cap, in bucket units per second
+		PresentationScheduler(float attackSeconds = 0.015f, float releaseSeconds = 0.12f, float peakHoldSeconds = 0.4f, float peakFallRate = 0.15f);
+
+		/// @brief Adds an analysis frame
+		/// @param buckets Visualization buckets, a different count than before restarts the history
+		/// @param audioTime Audio time of the frame in seconds, a time before the newest frame (seek, restart) clears the history
+		void pushFrame(const std::vector<float>& buckets, double audioTime);
+
+		/// @brief Computes heights and peaks for one rendered frame
+		/// @param audioTime Audio time being heard
+		/// @param displayTime Wall clock time of the frame, the smoothing step is the time since the previous call
+		/// @return False if no analysis frame arrived yet
+		bool present(double audioTime, double displayTime);
+
+		/// @brief Clears the history and all bars
+		void reset();
+
+		/// @brief Bar heights of the latest present()
+		const std::vector<float>& getHeights() const {return heights;}
+
+		/// @brief Peak cap heights of the latest present()
+		const std::vector<float>& getPeaks() const {return peaks;}
+
+		/// @brief Audio time of the newest analysis frame, negative if none
+		double getNewestFrameTime() const {return count ? frameTimes[newest] : -1.0;}
+};
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef QUALITY_SCHEDULER_H
+#define QUALITY_SCHEDULER_H
+
+#include <vector>
+
+/// @brief One step of the quality ladder
+struct QualityLevel{
+	int fftSize;					///< Samples per FFT
+	int numBars;					///< Visualization buckets / bars
+	double analysisInterval;		///< Seconds between analysis frames (the analysis hop)
+	double frameInterval;			///< Seconds between rendered frames
+};
+
+/**
+ * @class QualityScheduler
+ * @brief Deadline aware scheduler that steps analysis and render work down or up to hold a CPU budget
+ *
+ * The main loop reports the work time and lateness of every rendered frame. The scheduler keeps a smoothed
+ * cost estimate and a window of recent deadline misses, and moves one level along the quality ladder when the
+ * cost stays above the budget (or deadlines are missed) or when there is sustained headroom.
+ * A cooldown after each change gives the new level time to settle before it is judged.
+ * Audio feeding is not part of the ladder, the main loop always feeds first.
+ */
+class QualityScheduler{
+	private:
+		std::vector<QualityLevel> levels;	///< Quality ladder, index 0 is the highest quality
+		int currentLevel;					///< Index of the active level
+		double cpuBudget;					///< Fraction of each frame interval the work may use
+		double costEstimate;				///< Smoothed work time per frame in seconds
+		std::vector<bool> missWindow;		///< Ring of recent frames, true where the deadline was missed
+		int missIndex;						///< Next write position in missWindow
+		int missCount;						///< Misses currently in missWindow
+		double lastChangeTime;				///< Time of the last level change
+		double headroomSince;				///< Start of the current stretch with headroom, negative if none
+		long long framesTotal;				///< Frames reported so far
+		long long framesMissed;				///< Frames that missed their deadline
+
+		/// @brief Switches level and resets the per level statistics
+		void _changeLevel(int level, double now, const char* reason);
+
+	public:
+		/// @brief Constructor sets up the default ladder
+		/// @param cpuBudget Fraction of the frame interval the per frame work may use (0 to 1)
+		/// @param initialLevel Starting level, 1 matches the fixed 1024 / 32 / 60 Hz setup
+		QualityScheduler(double cpuBudget = 0.5, int initialLevel = 1);
+
+		/// @brief Reports one rendered frame
+		/// @param workSeconds Time spent analyzing and rendering the frame, excluding sleeps
+		/// @param lateSeconds How far past its deadline the frame finished (0 or negative if on time)
+		/// @param now Current time in seconds
+		/// @return True if the level changed and the caller must apply getLevel()
+		bool recordFrame(double workSeconds, double lateSeconds, double now);
+
+		/// @brief Active quality level
+		const QualityLevel& getLevel() const {return levels[currentLevel];}
+
+		/// @brief Index of the active level, 0 is the highest quality
+		int getLevelIndex() const {return currentLevel;}
+
+		/// @brief Frames reported so far
+		long long getFramesTotal() const {return framesTotal;}
+
+		/// @brief Frames that missed their deadline
+		long long getFramesMissed() const {return framesMissed;}
+};
+
+#endif
@@ -0,0 +1,159 @@
+#ifndef SAMPLE_STORE_H
+#define SAMPLE_STORE_H
+
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <cstddef>
+#include <cstdint>
+
+/// @brief In memory layout of decoded samples
+enum class SampleFormat{
+	Auto,			///< Native integer layout for 8/16/24 bit PCM sources, float for everything else
+	Float32,		///< 4 bytes per sample, the original layout
+	Int16,			///< 2 bytes per sample, lossless for 16 bit sources
+	Int24,			///< 3 bytes per sample, lossless for 24 bit sources
+	Compressed		///< Lossless blocks of 16 bit samples (fixed predictor + Rice codes), decoded on read
+};
+
+/**
+ * @class SampleStore
+ * @brief Storage for a file's interleaved samples, written as float by the decoder and read back as float
+ *
+ * Backends trade memory for read cost. Reads convert straight into the caller's memory (the ring buffer's
+ * write regions in AudioBuffer::fillBuffer), with SSE2 / NEON conversion from 16 bit samples.
+ * Writes to different ranges may run concurrently, as may reads of ranges that are not being written.
+ */
+class SampleStore{
+	public:
+		virtual ~SampleStore() = default;
+
+		/// @brief Creates the backend for a format
+		/// @param format Storage layout, Auto must be resolved by the caller first
+		/// @param channels Interleaved channels, blocks of the compressed backend hold whole frames
+		static std::unique_ptr<SampleStore> create(SampleFormat format, int channels);
+
+		/// @brief Sizes the store for a number of samples, all silent
+		virtual void resize(size_t sampleCount) = 0;
+
+		/// @brief Stores samples, converting from float
+		/// @param offset First sample to write, must be a multiple of getWriteAlignment()
+		/// @param source Samples in the -1 to 1 range
+		/// @param count Number of samples
+		virtual void write(size_t offset, const float* source, size_t count) = 0;
+
+		/// @brief Reads samples back as float
+		/// @param offset First sample to read
+		/// @param destination Output, count floats
+		/// @param count Number of samples
+		virtual void read(size_t offset, float* destination, size_t count) const = 0;
+
+		/// @brief Checks if storing source at offset would leave the store unchanged
+		virtual bool matches(size_t offset, const float* source, size_t count) const = 0;
+
+		/// @brief Number of samples
+		virtual size_t size() const = 0;
+
+		/// @brief Heap memory used for the samples in bytes
+		virtual size_t getMemoryBytes() const = 0;
+
+		/// @brief Writes must start at a multiple of this many samples
+		virtual size_t getWriteAlignment() const {return 1;}
+
+		/// @brief Short backend name for logs
+		virtual const char* getName() const = 0;
+};
+
+/// @brief 32 bit float samples, the layout AudioLoader always used
+class FloatSampleStore : public SampleStore{
+	private:
+		std::vector<float> samples;
+
+	public:
+		void resize(size_t sampleCount) override;
+		void write(size_t offset, const float* source, size_t count) override;
+		void read(size_t offset, float* destination, size_t count) const override;
+		bool matches(size_t offset, const float* source, size_t count) const override;
+		size_t size() const override {return samples.size();}
+		size_t getMemoryBytes() const override {return samples.size() * sizeof(float);}
+		const char* getName() const override {return "float32";}
+};
+
+/// @brief 16 bit samples, half the memory of float
+class Int16SampleStore : public SampleStore{
+	private:
+		std::vector<int16_t> samples;
+
+	public:
+		void resize(size_t sampleCount) override;
+		void write(size_t offset, const float* source, size_t count) override;
+		void read(size_t offset, float* destination, size_t count) const override;
+		bool matches(size_t offset, const float* source, size_t count) const override;
+		size_t size() const override {return samples.size();}
+		size_t getMemoryBytes() const override {return samples.size() * sizeof(int16_t);}
+		const char* getName() const override {return "int16";}
+};
+
+/// @brief 24 bit samples packed in 3 little endian bytes
+class Int24SampleStore : public SampleStore{
+	private:
+		std::vector<uint8_t> bytes;
+
+	public:
+		void resize(size_t sampleCount) override;
+		void write(size_t offset, const float* source, size_t count) override;
+		void read(size_t offset, float* destination, size_t count) const override;
+		bool matches(size_t offset, const float* source, size_t count) const override;
+		size_t size() const override {return bytes.size() / 3;}
+		size_t getMemoryBytes() const override {return bytes.size();}
+		const char* getName() const override {return "int24";}
+};
+
+/**
+ * @class CompressedSampleStore
+ * @brief Lossless compression of 16 bit samples in independent blocks of blockFrames frames
+ *
+ * Each channel of a block is coded as the residual of a second order fixed predictor (as in FLAC) with a
+ * per block Rice parameter, or stored verbatim if that is smaller. Reads decode whole blocks into a one block
+ * cache, so sequential reads decode every block once.
+ */
+class CompressedSampleStore : public SampleStore{
+	public:
+		static constexpr size_t blockFrames = 4096;		///< Frames per block, a multiple of AudioLoader's chunk sizes
+
+	private:
+		int channels;
+		size_t sampleCount;
+		std::vector<std::vector<uint8_t>> blocks;		///< Encoded blocks, empty means silence
+
+		mutable std::mutex cacheMutex;					///< Guards the cache, reads may come from several threads
+		mutable std::vector<int16_t> cache;				///< Decoded samples of cachedBlock
+		mutable size_t cachedBlock;						///< Block held in cache, SIZE_MAX if none
+
+		/// @brief Number of samples in a block (the last one may be short)
+		size_t _blockSamples(size_t block) const;
+
+		/// @brief Encodes interleaved samples into a block
+		void _encodeBlock(size_t block, const int16_t* samples, size_t count);
+
+		/// @brief Decodes a block into interleaved samples
+		void _decodeBlock(size_t block, int16_t* samples) const;
+
+		/// @brief Makes cache hold block, call with cacheMutex held
+		void _loadBlock(size_t block) const;
+
+	public:
+		/// @param channels Interleaved channels per frame
+		explicit CompressedSampleStore(int channels);
+
+		void resize(size_t sampleCount) override;
+		void write(size_t offset, const float* source, size_t count) override;
+		void read(size_t offset, float* destination, size_t count) const override;
+		bool matches(size_t offset, const float* source, size_t count) const override;
+		size_t size() const override {return sampleCount;}
+		size_t getMemoryBytes() const override;
+		size_t getWriteAlignment() const override {return blockFrames * channels;}
+		const char* getName() const override {return "compressed";}
+};
+
+#endif
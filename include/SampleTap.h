@@ -0,0 +1,21 @@
+#ifndef SAMPLE_TAP_H
+#define SAMPLE_TAP_H
+
+/**
+ * @class SampleTap
+ * @brief Interface for streaming stages that must see every sample exactly once
+ *
+ * AudioBuffer forwards each chunk it writes into the ring buffer to its attached taps,
+ * so a tap sees the whole stream in order without the overlapping windows AudioAnalyzer peeks.
+ */
+class SampleTap{
+	public:
+		virtual ~SampleTap() = default;
+
+		/// @brief Processes a chunk of interleaved samples, called from the thread that fills the AudioBuffer
+		/// @param samples Interleaved audio samples
+		/// @param sampleCount Number of samples (not frames) in the chunk, may end mid-frame
+		virtual void processSamples(const float* samples, int sampleCount) = 0;
+};
+
+#endif
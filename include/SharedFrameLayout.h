@@ -0,0 +1,49 @@
+#ifndef SHARED_FRAME_LAYOUT_H
+#define SHARED_FRAME_LAYOUT_H
+
+#include <atomic>
+#include <cstdint>
+
+/**
+ * @file SharedFrameLayout.h
+ * @brief Memory layout of the analysis frame ring shared between FramePublisher and FrameReader
+ *
+ * The shared memory object holds one SharedFrameHeader followed by slotCount SharedFrameSlot entries.
+ * Frame n is written to slot n % slotCount. Each slot is guarded by a seqlock counter that is odd while
+ * the publisher writes and even when the slot is stable, so readers never block the publisher and
+ * need no syscalls to poll.
+ */
+
+namespace SharedFrames {
+	constexpr uint32_t magic = 0x47415646;		///< "GAVF"
+	constexpr uint32_t layoutVersion = 1;		///< Bumped whenever the structs below change
+	constexpr int maxBuckets = 128;				///< Bucket capacity of each slot
+	constexpr const char* defaultName = "/grantAudioVisualizer";	///< Default shm_open name
+
+	static_assert(std::atomic<uint32_t>::is_always_lock_free, "seqlock counters must be lock free to work across processes");
+	static_assert(std::atomic<uint64_t>::is_always_lock_free, "sequence counter must be lock free to work across processes");
+}
+
+/// @brief Ring description at the start of the shared memory object
+struct alignas(64) SharedFrameHeader{
+	uint32_t magic;							///< SharedFrames::magic once the publisher finished initializing
+	uint32_t version;						///< SharedFrames::layoutVersion
+	uint32_t slotCount;						///< Number of slots following the header
+	uint32_t maxBuckets;					///< Bucket capacity per slot
+	uint32_t sampleRate;					///< Sample rate of the analyzed audio
+	uint32_t reserved;
+	std::atomic<uint64_t> latestSequence;	///< Sequence number of the newest complete frame, 0 if none yet
+};
+
+/// @brief One published analysis frame
+struct alignas(64) SharedFrameSlot{
+	std::atomic<uint32_t> seqlock;			///< Odd while being written
+	uint32_t bucketCount;					///< Valid entries in buckets
+	uint64_t sequence;						///< Frame sequence number, starts at 1
+	int64_t timestampNs;					///< CLOCK_MONOTONIC time of publication in nanoseconds
+	float rms;								///< RMS of the analysis block
+	float peak;								///< Peak amplitude of the analysis block
+	float buckets[SharedFrames::maxBuckets];	///< Visualization buckets
+};
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef SLIDING_DFT_H
+#define SLIDING_DFT_H
+
+#include <vector>
+#include <fftw3.h>
+
+/**
+ * @class SlidingDft
+ * @brief Damped sliding DFT of a contiguous range of bins, updated sample by sample in O(bins)
+ *
+ * Each new sample rotates every tracked bin once: X_k = W_k (r X_k + x_new - r^N x_old), with W_k = e^(j2πk/N).
+ * The damping r (r^N = dampingPerWindow) keeps every pole inside the unit circle, so rounding errors of the
+ * float state and twiddles die out instead of accumulating, at the cost of a slight exponential taper of the
+ * window. The state is the DFT of the block weighted by r^(N-1-m), which is what reset() expects, so a full
+ * FFT can resynchronize it at any time. Bins are stored as separate real / imaginary arrays and updated four
+ * at a time with SSE2 / NEON. The Hann window is applied in the frequency domain when magnitudes are read.
+ */
+class SlidingDft{
+	public:
+		static constexpr float dampingPerWindow = 0.999f;	///< r^N, errors decay by this factor per window
+
+	private:
+		int size;								///< Window length N
+		int firstBin;							///< First output bin
+		int lastBin;							///< Last output bin
+		int stateFirst;							///< First tracked bin, one below firstBin for the window
+		int stateCount;							///< Tracked bins, padded to a multiple of four
+		float damping;							///< r, applied once per sample
+		float dampingN;							///< r^N, weight of the sample leaving the window
+		float gain;								///< Undoes the taper's loss of coherent gain
+
+		std::vector<float> stateReal;			///< Real part per tracked bin
+		std::vector<float> stateImag;			///< Imaginary part per tracked bin
+		std::vector<float> twiddleReal;			///< cos(2πk/N) per tracked bin, 0 in the padding
+		std::vector<float> twiddleImag;			///< sin(2πk/N) per tracked bin, 0 in the padding
+		std::vector<float> ramp;				///< r^(N-1-m), the weighting of a resync block
+
+		/// @brief Real / imaginary part of any bin k (including -1 and N/2 + 1) from the tracked state
+		void _bin(int k, float& real, float& imag) const;
+
+	public:
+		/// @brief Constructor, configure() sets the size and bins
+		SlidingDft();
+
+		/// @brief Sizes the state for a window and the bins read by windowedMagnitudes, clears the state
+		/// @param windowSize Window length N
+		/// @param first First bin to output
+		/// @param last Last bin to output (at most N / 2)
+		void configure(int windowSize, int first, int last);
+
+		/// @brief Weights a block by r^(N-1-m) in place, before the FFT whose output goes to reset()
+		void weightBlock(float* block) const;
+
+		/// @brief Takes the tracked bins from a full FFT of a weightBlock() weighted block
+		void reset(const fftwf_complex* spectrum);
+
+		/// @brief Slides the window by count samples
+		/// @param leaving Oldest count samples of the previous window
+		/// @param entering count samples following the previous window
+		void slide(const float* leaving, const float* entering, int count);
+
+		/// @brief Hann windowed magnitudes of the output bins, times scale
+		/// @param magnitudes Spectrum indexed by bin, only firstBin to lastBin are written
+		void windowedMagnitudes(float* magnitudes, float scale) const;
+
+		/// @brief Bins updated per sample
+		int getTrackedBins() const {return stateCount;}
+};
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef SPECTRUM_ANALYZER_H
+#define SPECTRUM_ANALYZER_H
+
+/**
+ * @class SpectrumAnalyzer
+ * @brief Common interface of the runtime sized AudioAnalyzer and the compile time specialized AnalyzerT
+ *
+ * Results are exposed as pointer + size so fixed size implementations can keep them in std::array.
+ */
+class SpectrumAnalyzer{
+	public:
+		virtual ~SpectrumAnalyzer() = default;
+
+		/// @brief Peeks the next block from the AudioBuffer and runs the full analysis on it
+		/// @return True if analysis was successful, false if not enough data available
+		virtual bool analyzeNextBlock() = 0;
+
+		/// @brief Magnitude spectrum of the latest block (fftSize / 2 + 1 bins)
+		virtual const float* getSpectrumData() const = 0;
+
+		/// @brief Number of bins in the magnitude spectrum
+		virtual int getSpectrumSize() const = 0;
+
+		/// @brief Log-spaced visualization buckets of the latest block
+		virtual const float* getBucketData() const = 0;
+
+		/// @brief Number of visualization buckets
+		virtual int getBucketCount() const = 0;
+
+		/// @brief Root mean square of the latest block
+		virtual float getRmsVal() const = 0;
+
+		/// @brief Peak amplitude of the latest block
+		virtual float getPeakAmplitude() const = 0;
+};
+
+#endif
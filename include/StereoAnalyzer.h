@@ -0,0 +1,103 @@
+#ifndef STEREO_ANALYZER_H
+#define STEREO_ANALYZER_H
+
+#include <vector>
+#include <atomic>
+#include <cstdint>
+#include "SampleTap.h"
+
+/**
+ * @class StereoAnalyzer
+ * @brief Correlation meter, balance and goniometer points of the first two channels
+ *
+ * Every L/R frame is processed once as a SampleTap. Sums of L², R² and L·R are accumulated with SSE2 / NEON over
+ * 10 ms blocks, and each block updates exponentially decaying sums (integrationSeconds), from which the
+ * correlation coefficient (+1 mono, 0 unrelated, -1 out of phase) and the balance (-1 left, +1 right) are
+ * published through atomics. For the goniometer, every decimation-th frame is stored as a side / mid point in a
+ * lock free ring; update() copies the newest pointCount points into a fixed buffer. The decimation is chosen
+ * from the sample rate so the points always span about 50 ms, the point count (and the vertex count of the
+ * view) stays the same at any rate, and nothing allocates after construction.
+ */
+class StereoAnalyzer : public SampleTap{
+	public:
+		static constexpr int pointCount = 1024;		///< Goniometer points per update
+
+	private:
+		static constexpr int maxChannels = 8;		///< Highest channel count the tap supports
+		static constexpr int ringPoints = 4 * pointCount;	///< Points kept in the ring, power of two
+
+		int sampleRate;							///< Sample rate of the stream
+		int channels;							///< Interleaved channels, the first two are analyzed
+		int decimation;							///< Frames per goniometer point
+		int blockFrames;						///< Frames per accumulation block
+		float blockDecay;						///< Weight of the running sums after one block
+
+		// Partial frame carried between calls, since fillBuffer may stop in the middle of a frame
+		float carry[maxChannels];				///< Samples of the incomplete frame
+		int carryCount;							///< Number of samples held in carry
+
+		// Current block and running sums
+		int blockFill;							///< Frames accumulated in the current block
+		double blockLeft;						///< Sum of L² in the current block
+		double blockRight;						///< Sum of R² in the current block
+		double blockCross;						///< Sum of L·R in the current block
+		double sumLeft;							///< Decaying sum of L²
+		double sumRight;						///< Decaying sum of R²
+		double sumCross;						///< Decaying sum of L·R
+		int decimationPhase;					///< Frames until the next goniometer point
+
+		// Goniometer ring, written by processSamples and read by update() from another thread
+		std::vector<float> ring;				///< Side / mid pairs
+		std::atomic<uint64_t> pointsWritten;	///< Points written since construction
+		uint64_t pointsCopied;					///< pointsWritten at the latest update
+		std::vector<float> points;				///< Newest pointCount side / mid pairs, oldest first
+
+		// Published results
+		std::atomic<float> correlation;
+		std::atomic<float> balance;
+
+		/// @brief Accumulates whole interleaved frames, block boundaries are handled by the caller
+		void _accumulate(const float* frames, int frameCount);
+
+		/// @brief Appends goniometer points for frames, continuing the decimation phase
+		void _storePoints(const float* frames, int frameCount, uint64_t& written);
+
+		/// @brief Folds the finished block into the running sums and publishes correlation and balance
+		void _finishBlock();
+
+	public:
+		/// @brief Constructs an analyzer for a stream of the given format
+		/// @param sampleRate Sample rate in Hz
+		/// @param channels Interleaved channels (2 to 8, channels after the first two are ignored)
+		/// @param integrationSeconds Time constant of correlation and balance
+		StereoAnalyzer(int sampleRate, int channels, float integrationSeconds = 0.3f);
+
+		/// @brief Feeds interleaved samples, called by AudioBuffer as it fills
+		/// @param samples Interleaved samples
+		/// @param sampleCount Number of samples, does not need to be a whole number of frames
+		void processSamples(const float* samples, int sampleCount) override;
+
+		/// @brief Copies the newest goniometer points into getPoints()
+		/// @return False if no new point arrived since the last update
+		bool update();
+
+		/// @brief Goniometer points of the latest update, pointCount (side, mid) pairs, oldest first
+		const std::vector<float>& getPoints() const {return points;}
+
+		/// @brief Correlation of left and right over the integration time
+		/// @return -1 (out of phase) to +1 (mono), 0 in silence
+		float getCorrelation() const {return correlation.load(std::memory_order_relaxed);}
+
+		/// @brief Energy balance over the integration time
+		/// @return -1 (left only) to +1 (right only), 0 in silence
+		float getBalance() const {return balance.load(std::memory_order_relaxed);}
+
+		/// @brief Frames per goniometer point
+		int getDecimation() const {return decimation;}
+
+		// Disable copy constructor and assignment operator
+		StereoAnalyzer(const StereoAnalyzer&) = delete;
+		StereoAnalyzer& operator=(const StereoAnalyzer&) = delete;
+};
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef THREAD_CONFIG_H
+#define THREAD_CONFIG_H
+
+#ifndef _WIN32
+#include <pthread.h>
+#include <sys/types.h>
+#endif
+
+/// @brief Scheduling class requested for a thread
+enum class SchedulingPolicy{
+	Normal,			///< Default time sharing scheduler
+	Fifo,			///< SCHED_FIFO real-time
+	RoundRobin		///< SCHED_RR real-time
+};
+
+/// @brief Real-time settings for one thread of the audio path
+struct ThreadConfig{
+	SchedulingPolicy policy = SchedulingPolicy::Normal;	///< Requested scheduling class
+	int priority = 0;				///< Real-time priority (1-99 on Linux), ignored for Normal
+	int cpuCore = -1;				///< Core to pin the thread to, -1 to leave unpinned
+	const char* name = nullptr;		///< Thread name for logs and debuggers, nullptr to keep the current one
+};
+
+/// @brief Identity of a thread, taken on the thread itself so another thread can apply settings to it
+struct ThreadHandle{
+#ifdef _WIN32
+	unsigned long id = 0;			///< GetCurrentThreadId of the thread
+#else
+	pthread_t thread = {};			///< pthread_self of the thread
+	pid_t systemId = 0;				///< Kernel thread id for the per thread nice fallback (Linux), 0 elsewhere
+#endif
+};
+
+/**
+ * @namespace ThreadTuning
+ * @brief Applies ThreadConfig settings and locks memory, falling back gracefully without privileges
+ *
+ * Real-time scheduling is first tried at the requested priority, then clamped to RLIMIT_RTPRIO, and finally
+ * replaced by the highest nice value the process may use. Every step logs what was actually applied,
+ * so an unprivileged run still works, just without the real-time guarantees.
+ */
+namespace ThreadTuning{
+	/// @brief Applies the configuration to the calling thread
+	/// @param config Settings to apply
+	/// @return True if every requested setting was applied as asked, false if anything fell back
+	bool applyToCurrentThread(const ThreadConfig& config);
+
+	/// @brief Applies the configuration to another thread, e.g. a real-time callback thread, which then does none
+	/// of the scheduler calls or logging itself
+	/// @param thread Handle the thread took with currentThread()
+	/// @param config Settings to apply
+	/// @return True if every requested setting was applied as asked, false if anything fell back
+	bool applyToThread(const ThreadHandle& thread, const ThreadConfig& config);
+
+	/// @brief Handle of the calling thread, safe in a real-time callback (no locks, no allocation, at most gettid)
+	ThreadHandle currentThread();
+
+	/// @brief Locks the process's pages into RAM (mlockall) so the audio path never page faults,
+	/// future pages too when RLIMIT_MEMLOCK allows it
+	/// @return True on success, false if not permitted or unsupported
+	bool lockProcessMemory();
+
+	/// @brief Number of CPU cores available, at least 1
+	int coreCount();
+
+	/// @brief CPU time the whole process used so far, user plus kernel, over all threads
+	/// @return Seconds, 0 if unsupported
+	double processCpuSeconds();
+}
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef VIRTUAL_INPUT_DEVICE_H
+#define VIRTUAL_INPUT_DEVICE_H
+
+#include <atomic>
+#include <thread>
+#include "AudioBuffer.h"
+#include "AudioLoader.h"
+#include "InputSource.h"
+
+/**
+ * @class VirtualInputDevice
+ * @brief File backed stand-in for a capture device, replays decoded audio into an AudioBuffer at real time rate
+ *
+ * A pacing thread writes one period of samples at a time on an absolute schedule, the same way a sound card
+ * delivers input blocks, so the live analysis path can be exercised and its latency measured without hardware.
+ */
+class VirtualInputDevice : public InputSource{
+	private:
+		AudioBuffer* audioBuffer;				///< Pointer to shared AudioBuffer that receives the samples
+		const AudioLoader& loader;				///< Decoded file that is replayed
+		int framesPerBuffer;					///< Frames delivered per period, like a device buffer size
+		std::thread pacingThread;				///< Thread that delivers periods on schedule
+		std::atomic<bool> running;				///< True while the pacing thread delivers samples
+		std::atomic<bool> stopRequested;		///< Set by stop() to end the pacing thread
+		std::atomic<double> newestSampleTime;	///< Steady clock time (seconds) of the newest delivered period
+		std::atomic<long long> droppedSamples;	///< Samples that did not fit into the ring buffer
+
+		/// @brief Pacing thread body
+		void _run();
+
+		/// @brief Steady clock time in seconds
+		static double _now();
+
+	public:
+		/// @brief Constructor stores the source, replay starts with start()
+		/// @param buffer Pointer to the AudioBuffer that receives the samples
+		/// @param loader Loaded audio file to replay
+		/// @param framesPerBuffer Frames per delivered period
+		VirtualInputDevice(AudioBuffer* buffer, const AudioLoader& loader, int framesPerBuffer = 256);
+
+		/// @brief Destructor stops the pacing thread
+		~VirtualInputDevice() override;
+
+		bool start() override;
+		bool stop() override;
+		bool isActive() const override {return running.load(std::memory_order_acquire);}
+		int getSampleRate() const override {return loader.getSampleRate();}
+		int getChannels() const override {return loader.getChannels();}
+		double getCaptureLatency() const override;
+		long long getDroppedSamples() const override {return droppedSamples.load(std::memory_order_relaxed);}
+
+		// Disable copy constructor and assignment operator
+		VirtualInputDevice(const VirtualInputDevice&) = delete;
+		VirtualInputDevice& operator=(const VirtualInputDevice&) = delete;
+};
+
+#endif
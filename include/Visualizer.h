@@ -4,9 +4,17 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <vector>
+#include <algorithm>
 #include <iostream>
 
 class Visualizer{
+	public:
+		// bar capacity of the shader's uniform array
+		static constexpr int maxBars = 128;
+		// analysis frames kept by the waterfall view
+		static constexpr int waterfallHistory = 512;
+		// goniometer points drawn per frame, the instance count of its single draw
+		static constexpr int maxGoniometerPoints = 1024;
 	private:
 		GLFWwindow* window;
 		int windowWidth;
@@ -20,12 +28,54 @@ class Visualizer{
 		GLint uniformBarHeights;
 		GLint uniformBarCount;
 		GLint uniformBarColor;
+		GLint uniformBarPeaks;
+		GLint uniformDrawCaps;
 		// Bar data
 		int numBars;
 		std::vector<float> barHeights;
 		// smoothing info
 		std::vector<float> smoothedHeights;
 		float smoothingFactor; 
+		// peak caps, drawn once setBarHeights was given peaks
+		std::vector<float> barPeaks;
+		bool showPeaks;
+		// beat flash intensity, decays every rendered frame
+		float beatPulse;
+		// hue of the detected note, the bars ease toward it every rendered frame
+		float noteColor[3];
+		float noteTint;
+		float noteTintTarget;
+		bool showNotes;
+		// seconds the last buffer swap blocked, the vsync wait
+		double lastSwapWait;
+		// Waterfall: ring of the last waterfallHistory spectra in one texture (x = frame, y = FFT bin)
+		GLuint waterfallProgram;
+		GLuint waterfallTexture;
+		GLint uniformColumnOffset;
+		GLint uniformHistorySize;
+		GLint uniformBinCount;
+		GLint uniformNyquist;
+		GLint uniformMaxFreq;
+		int waterfallBins;		// texture height, reallocated when the FFT size changes
+		int waterfallColumn;	// next column to write, also the oldest column on screen
+		float spectrumNyquist;	// frequency of the last bin
+		bool waterfallMode;
+		// Goniometer: side / mid points as instances of a small quad, drawn over the bars or the waterfall
+		GLuint goniometerProgram;
+		GLuint goniometerVAO;
+		GLuint goniometerVBO;	// per instance point positions, maxGoniometerPoints pairs
+		GLint uniformGoniometerArea;
+		GLint uniformGoniometerColor;
+		int goniometerPoints;	// points uploaded by the last setGoniometerPoints
+		float goniometerCorrelation;
+		bool showGoniometer;
+		// Redraw tracking for demand rendering: what the last render() drew, and changes since
+		bool redrawPending;			// window, mode or content changed in a way heights do not show
+		float redrawThreshold;		// pixels a bar or cap has to move before it is redrawn
+		std::vector<float> drawnHeights;
+		std::vector<float> drawnPeaks;
+		int waterfallActiveColumns;	// columns on screen that are not silent, the waterfall scrolls while any are
+		bool goniometerActive;		// the last uploaded points were not all at the center
 		// Sets up GLFW window and OpenGL context
 		bool setupWindow();
 		// compiiles shader from source code
@@ -36,8 +86,22 @@ class Visualizer{
 		bool setupShaders();
 		// Sets up vertex buffer for rendering bars
 		void setupGeometry();
+		// Sets up the waterfall shader and texture
+		bool setupWaterfall();
+		// Creates the goniometer's program and instance buffer
+		bool setupGoniometer();
+		// Draws the waterfall texture over the whole window
+		void renderWaterfall();
+		// draws the goniometer in the top right corner, one instanced draw
+		void renderGoniometer();
+		// swaps buffers and measures how long the swap blocked
+		void _swapBuffers();
 		// GLFW callback for window resizing
 		static void framebufferSizeCallback(GLFWwindow* window, int width, int height);
+		// GLFW callback for key presses (W toggles the waterfall)
+		static void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods);
+		// GLFW callback when the window's contents were damaged (uncovered, restored)
+		static void windowRefreshCallback(GLFWwindow* window);
 	public:
 		//initializes window dimensions and bar count
 		Visualizer(int width = 800, int height = 600, int numBars = 32);
@@ -47,14 +111,52 @@ class Visualizer{
 		bool initialize();
 		// updates bar heights from analyzer data
 		void updateData(const std::vector<float>& buckets);
+		// sets bar heights and peak caps smoothed elsewhere (PresentationScheduler), no smoothing applied
+		void setBarHeights(const std::vector<float>& heights, const std::vector<float>& peaks);
 		// Renders the frequency bars to the window
 		void render();
 		// Checks if window should close 
 		bool shouldClose() const;
 		// polls for input
 		void pollEvents();
+		// blocks until a window event, wakeUp() or the timeout (seconds), processing the events
+		void waitEvents(double timeout);
+		// makes a waitEvents() on the main thread return, callable from any thread
+		static void wakeUp();
+		// true if the last render() no longer matches what would be drawn now: bars or caps moved more than the
+		// redraw threshold, a beat flash or note tint is still fading, the waterfall or goniometer shows signal,
+		// or the window, a mode or the bar count changed
+		bool needsRedraw() const;
+		// pixels a bar has to move before needsRedraw() reports it
+		void setRedrawThreshold(float pixels) { redrawThreshold = std::max(pixels, 0.0f); }
+		// true while the window is minimized, nothing drawn would be seen
+		bool isMinimized() const;
 		
 		void setSmoothingFactor(float factor);
+		// changes the number of bars (clamped to maxBars), must match the analyzer's bucket count
+		void setBarCount(int count);
+		int getBarCount() const { return numBars; }
+		// flashes the bars toward white, strength 0 to 1
+		void triggerBeat(float strength);
+		// tints the bars with the hue of a pitch class (C = 0 ... B = 11), -1 fades the tint out (N toggles it)
+		void setNoteColor(int pitchClass, float strength);
+		// adds the full magnitude spectrum as the newest waterfall column, uploads one column per call
+		void pushSpectrum(const std::vector<float>& spectrum);
+		// sample rate the spectrum's bins are spaced for, the waterfall's frequency axis
+		void setSpectrumSampleRate(float sampleRate);
+		// waits for vertical blank in render() when enabled, so the display paces rendering
+		void setVsync(bool enabled);
+		// refresh rate of the primary monitor in Hz, 60 if unknown
+		double getRefreshRate() const;
+		// seconds render() spent blocked in the buffer swap, the vsync wait when enabled
+		double getLastSwapWait() const { return lastSwapWait; }
+		// switches between bars and the waterfall (also toggled with W)
+		void setWaterfallMode(bool enabled);
+		bool isWaterfallMode() const { return waterfallMode; }
+		// uploads side / mid point pairs (at most maxGoniometerPoints), colored by the correlation (-1 red to +1 green)
+		void setGoniometerPoints(const std::vector<float>& points, float correlation);
+		// shows the goniometer (also toggled with G)
+		void setGoniometerVisible(bool visible);
 		//? maybe void setBarColor(float r, float g, float b)
 		//TODO	add smoothing if needed in future??
 		// Disable copy constructor and assignment operator
@@ -0,0 +1,149 @@
+#include "AnalysisLog.h"
+#include <iostream>
+#include <cstring>
+#include <filesystem>
+
+namespace {
+	// Reads count floats into values, sized first
+	bool readFloats(std::FILE* file, std::vector<float>& values, size_t count){
+		values.resize(count);
+		return std::fread(values.data(), sizeof(float), count, file) == count;
+	}
+}
+
+uint32_t AnalysisLogs::checksum(const float* samples, size_t count){
+	const unsigned char* bytes = reinterpret_cast<const unsigned char*>(samples);
+	uint32_t hash = 2166136261u;
+	for(size_t i = 0; i < count * sizeof(float); i++){
+		hash = (hash ^ bytes[i]) * 16777619u;
+	}
+	return hash;
+}
+
+// Writer
+
+// Constructor
+AnalysisLogWriter::AnalysisLogWriter() : file(nullptr), withInputs(false), frameCount(0){
+}
+
+// Destructor
+AnalysisLogWriter::~AnalysisLogWriter(){
+	close();
+}
+
+bool AnalysisLogWriter::open(const char* path, int sampleRate, int channels, const std::string& source, bool inputs){
+	close();
+	file = std::fopen(path, "wb");
+	if(!file){
+		std::cout << "Failed to create analysis log " << path << std::endl;
+		return false;
+	}
+	withInputs = inputs;
+	frameCount = 0;
+
+	AnalysisLogHeader header = {};
+	header.magic = AnalysisLogs::magic;
+	header.version = AnalysisLogs::layoutVersion;
+	header.sampleRate = static_cast<uint32_t>(sampleRate);
+	header.channels = static_cast<uint32_t>(channels);
+	header.flags = inputs ? AnalysisLogs::hasInputs : 0;
+	header.sourceLength = static_cast<uint32_t>(source.size());
+	std::fwrite(&header, sizeof(header), 1, file);
+	std::fwrite(source.data(), 1, source.size(), file);
+	return true;
+}
+
+void AnalysisLogWriter::write(const AnalysisLogFrame& frame){
+	if(!file){
+		return;
+	}
+	std::fwrite(&frame.info, sizeof(frame.info), 1, file);
+	std::fwrite(frame.buckets.data(), sizeof(float), frame.info.bucketCount, file);
+	std::fwrite(frame.heights.data(), sizeof(float), frame.info.bucketCount, file);
+	std::fwrite(frame.peaks.data(), sizeof(float), frame.info.bucketCount, file);
+	if(withInputs){
+		std::fwrite(frame.input.data(), sizeof(float), frame.info.fftSize, file);
+	}
+	frameCount++;
+}
+
+void AnalysisLogWriter::close(){
+	if(file){
+		std::fclose(file);
+		file = nullptr;
+	}
+}
+
+// Reader
+
+// Constructor
+AnalysisLogReader::AnalysisLogReader() : file(nullptr), header{}, remaining(0), damaged(false){
+}
+
+// Destructor
+AnalysisLogReader::~AnalysisLogReader(){
+	if(file){
+		std::fclose(file);
+	}
+}
+
+bool AnalysisLogReader::open(const char* path){
+	if(file){
+		std::fclose(file);
+	}
+	damaged = false;
+	file = std::fopen(path, "rb");
+	if(!file){
+		return false;
+	}
+	std::error_code error;
+	remaining = std::filesystem::file_size(path, error);
+	if(error || remaining < sizeof(header) || std::fread(&header, sizeof(header), 1, file) != 1
+		|| header.magic != AnalysisLogs::magic || header.version != AnalysisLogs::layoutVersion
+		|| header.sourceLength > remaining - sizeof(header)){
+		std::fclose(file);
+		file = nullptr;
+		return false;
+	}
+	remaining -= sizeof(header) + header.sourceLength;
+	source.resize(header.sourceLength);
+	if(header.sourceLength && std::fread(&source[0], 1, header.sourceLength, file) != header.sourceLength){
+		std::fclose(file);
+		file = nullptr;
+		return false;
+	}
+	return true;
+}
+
+bool AnalysisLogReader::read(AnalysisLogFrame& frame){
+	if(!file || damaged || remaining == 0){
+		return false;
+	}
+	// Sizes come from the file, they are checked before anything is allocated for them
+	if(remaining < sizeof(frame.info) || std::fread(&frame.info, sizeof(frame.info), 1, file) != 1){
+		damaged = true;
+		return false;
+	}
+	remaining -= sizeof(frame.info);
+	const uint32_t size = frame.info.fftSize;
+	const uint64_t payload = sizeof(float) * (3ull * frame.info.bucketCount + (hasInputs() ? size : 0));
+	if(frame.info.bucketCount > AnalysisLogs::maxBuckets || size == 0 || (size & (size - 1)) != 0
+		|| size > AnalysisLogs::maxFftSize || payload > remaining){
+		std::cerr << "Damaged analysis log record (" << frame.info.bucketCount << " buckets, FFT size " << size << ", "
+				  << remaining << " bytes left)\n";
+		damaged = true;
+		return false;
+	}
+	remaining -= payload;
+	bool complete = readFloats(file, frame.buckets, frame.info.bucketCount)
+		&& readFloats(file, frame.heights, frame.info.bucketCount)
+		&& readFloats(file, frame.peaks, frame.info.bucketCount);
+	if(hasInputs()){
+		complete = complete && readFloats(file, frame.input, frame.info.fftSize);
+	}
+	else{
+		frame.input.clear();
+	}
+	damaged = !complete;
+	return complete;
+}
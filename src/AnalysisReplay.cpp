@@ -0,0 +1,292 @@
+#include "AnalysisReplay.h"
+#include "AudioLoader.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <string>
+
+namespace {
+	using Clock = std::chrono::steady_clock;
+
+	double secondsSince(Clock::time_point since){
+		return std::chrono::duration<double>(Clock::now() - since).count();
+	}
+
+	constexpr float absoluteTolerance = 1.0e-6f;	// Floor for values near zero
+}
+
+// Constructor
+AnalysisReplay::AnalysisReplay(int sampleRate)
+	: sampleRate(sampleRate), presentation(0.015f, 0.12f, 0.4f, 0.15f), beatSeconds(0.0), presentationSeconds(0.0){
+}
+
+void AnalysisReplay::run(const float* block, AnalysisLogFrame& frame){
+	const int size = static_cast<int>(frame.info.fftSize);
+	if(!analyzer){
+		// Planned like the live analyzer, at 1024 with FFTW_MEASURE, then switched to the frame's size
+		analyzer = std::make_unique<AudioAnalyzer>(nullptr, 1024, sampleRate);
+		analyzer->setProfiling(true);
+	}
+	// The live loop recreates the beat detector whenever the analysis level changes
+	if(!beatDetector || (frame.info.flags & AnalysisLogs::frameReset)){
+		analyzer->setFftSize(size);
+		beatDetector = std::make_unique<BeatDetector>(size / 2 + 1, frame.info.analysisRate);
+	}
+	if(static_cast<int>(frame.info.bucketCount) != analyzer->getBucketCount()){
+		analyzer->setNumBuckets(static_cast<int>(frame.info.bucketCount));
+	}
+
+	analyzer->analyzeBlock(block, frame.info.samplePosition);
+	frame.info.inputChecksum = AnalysisLogs::checksum(block, frame.info.fftSize);
+
+	Clock::time_point stageStart = Clock::now();
+	beatDetector->process(analyzer->getSpectrum(), frame.info.frameTime);
+	beatSeconds += secondsSince(stageStart);
+
+	stageStart = Clock::now();
+	capture(*analyzer, *beatDetector, presentation, frame);
+	presentationSeconds += secondsSince(stageStart);
+}
+
+void AnalysisReplay::capture(const AudioAnalyzer& analyzer, const BeatDetector& beatDetector, PresentationScheduler& presentation, AnalysisLogFrame& frame){
+	const std::vector<float>& spectrum = analyzer.getSpectrum();
+	double energy = 0.0, weighted = 0.0, total = 0.0;
+	for(size_t i = 0; i < spectrum.size(); i++){
+		energy += static_cast<double>(spectrum[i]) * spectrum[i];
+		weighted += static_cast<double>(spectrum[i]) * i;
+		total += spectrum[i];
+	}
+
+	frame.info.fftSize = static_cast<uint32_t>(analyzer.getFftSize());
+	frame.info.bucketCount = static_cast<uint32_t>(analyzer.getBucketCount());
+	frame.info.rms = analyzer.getRmsVal();
+	frame.info.peak = analyzer.getPeakAmplitude();
+	frame.info.spectrumEnergy = static_cast<float>(energy);
+	frame.info.spectrumCentroid = total > 0.0 ? static_cast<float>(weighted / total) : 0.0f;
+	frame.info.onset = beatDetector.getOnsetStrength();
+	frame.info.flags = (frame.info.flags & ~AnalysisLogs::frameBeat) | (beatDetector.isBeat() ? AnalysisLogs::frameBeat : 0);
+	frame.info.beatStrength = beatDetector.getBeatStrength();
+	frame.info.tempo = beatDetector.getTempo();
+	frame.buckets = analyzer.getBuckets();
+
+	// Presented at the frame's own audio time, one step per frame, so heights do not depend on the render rate
+	presentation.pushFrame(frame.buckets, frame.info.audioTime);
+	presentation.present(frame.info.audioTime, frame.info.audioTime);
+	frame.heights = presentation.getHeights();
+	frame.peaks = presentation.getPeaks();
+}
+
+void AnalysisReplay::printTimings(double inputSeconds) const{
+	if(!analyzer){
+		std::cout << "No frames replayed\n";
+		return;
+	}
+	const AnalyzerTimings& timings = analyzer->getTimings();
+	const double frames = static_cast<double>(std::max(1LL, timings.blocks));
+	struct Stage{
+		const char* name;
+		double seconds;
+	};
+	const Stage stages[] = {
+		{"input", inputSeconds},
+		{"window", timings.window},
+		{"fft", timings.fft},
+		{"magnitudes", timings.magnitudes},
+		{"buckets", timings.buckets},
+		{"beat", beatSeconds},
+		{"presentation", presentationSeconds},
+	};
+	double total = 0.0;
+	std::cout << "Stage timings over " << timings.blocks << " frames:\n";
+	for(const Stage& stage : stages){
+		total += stage.seconds;
+		std::cout << "  " << stage.name << ": " << stage.seconds * 1000.0 << " ms, "
+			<< stage.seconds * 1.0e6 / frames << " us/frame\n";
+	}
+	std::cout << "  total: " << total * 1000.0 << " ms, " << frames / std::max(total, 1.0e-9) << " frames/s\n";
+}
+
+// Frames of a log are replayed with the recorded positions and times, audio files at every hop of half a window.
+// recordLog keeps the replayed frames, e.g. as the golden log of a file.
+bool AnalysisReplay::replayFile(const char* source, const char* goldenLog, const char* recordLog, float tolerance, SampleFormat format){
+	AnalysisLogReader replayLog;
+	const bool fromLog = replayLog.open(source);
+	const std::string audioPath = fromLog ? replayLog.getSource() : std::string(source);
+	AudioLoader replayLoader;
+	replayLoader.setSampleFormat(format);
+	if((!fromLog || !replayLog.hasInputs()) && !replayLoader.loadAudioFile(audioPath.c_str())){
+		std::cerr << "Error: Could not load audio file " << audioPath << "\n";
+		return false;
+	}
+	const int replayRate = fromLog ? replayLog.getSampleRate() : replayLoader.getSampleRate();
+	const int replayChannels = fromLog ? replayLog.getChannels() : replayLoader.getChannels();
+	const SampleStore& store = replayLoader.getAudioData();
+
+	AnalysisLogReader golden;
+	const char* goldenPath = goldenLog ? goldenLog : (fromLog ? source : nullptr);
+	if(goldenPath && !golden.open(goldenPath)){
+		std::cerr << "Error: " << goldenPath << " is not an analysis log\n";
+		return false;
+	}
+	AnalysisLogWriter replayOut;
+	if(recordLog && !replayOut.open(recordLog, replayRate, replayChannels, audioPath, fromLog && replayLog.hasInputs())){
+		return false;
+	}
+
+	// Audio files are replayed like the fixed 1024 FFT / 32 bar setup, at a hop of half a window
+	const int replayFftSize = 1024;
+	const int hop = std::max(replayChannels, replayFftSize / 2 - (replayFftSize / 2) % replayChannels);
+	AnalysisReplay replay(replayRate);
+	AnalysisDiff diff(tolerance);
+	AnalysisLogFrame frame, goldenFrame;
+	std::vector<float> block;
+	double inputSeconds = 0.0;
+	for(long long index = 0;; index++){
+		Clock::time_point inputBegin = Clock::now();
+		if(fromLog){
+			if(!replayLog.read(frame)){
+				break;
+			}
+			if(replayLog.hasInputs()){
+				block = frame.input;
+			}
+			else{
+				// Past the end of the file reads as silence, the checksum reports it
+				block.assign(frame.info.fftSize, 0.0f);
+				size_t position = static_cast<size_t>(std::max<int64_t>(0, frame.info.samplePosition));
+				if(position < store.size()){
+					store.read(position, block.data(), std::min(block.size(), store.size() - position));
+				}
+			}
+		}
+		else{
+			size_t position = static_cast<size_t>(index) * hop;
+			if(position + replayFftSize > store.size()){
+				break;
+			}
+			frame = AnalysisLogFrame();
+			frame.info.samplePosition = static_cast<int64_t>(position);
+			frame.info.fftSize = replayFftSize;
+			frame.info.bucketCount = 32;
+			frame.info.analysisRate = static_cast<float>(replayRate) * replayChannels / hop;
+			frame.info.audioTime = (position + 0.5 * replayFftSize) / replayChannels / replayRate;
+			frame.info.frameTime = frame.info.audioTime;
+			frame.info.flags = index == 0 ? AnalysisLogs::frameReset : 0;
+			block.resize(replayFftSize);
+			store.read(position, block.data(), replayFftSize);
+		}
+		inputSeconds += secondsSince(inputBegin);
+
+		replay.run(block.data(), frame);
+		replayOut.write(frame);
+		if(golden.read(goldenFrame)){
+			diff.compare(frame, goldenFrame);
+		}
+		else if(goldenPath){
+			diff.addMissing("golden log ended");
+		}
+	}
+	while(golden.read(goldenFrame)){
+		diff.addMissing("replay ended");
+	}
+	// A damaged record ends a log early, which must fail the comparison even when both logs are the same file
+	if(replayLog.isDamaged()){
+		diff.addMissing("replayed log damaged");
+	}
+	if(golden.isDamaged()){
+		diff.addMissing("golden log damaged");
+	}
+
+	replay.printTimings(inputSeconds);
+	if(replayOut.isOpen()){
+		std::cout << "Wrote " << replayOut.getFrameCount() << " frames to " << recordLog << "\n";
+		replayOut.close();
+	}
+	if(!goldenPath){
+		return !replayLog.isDamaged();
+	}
+	diff.print();
+	return diff.passed();
+}
+
+// Diff
+
+// Constructor
+AnalysisDiff::AnalysisDiff(float tolerance) : tolerance(tolerance), frames(0), mismatches(0), firstMismatch(-1), firstField(nullptr),
+	maxBucketError(0.0f), maxHeightError(0.0f), maxScalarError(0.0f){
+}
+
+bool AnalysisDiff::_close(float result, float golden, float& maxError, const char* field, bool& ok){
+	float error = std::fabs(result - golden);
+	maxError = std::max(maxError, error);
+	// Written so NaN on either side fails
+	if(!(error <= absoluteTolerance + tolerance * std::fabs(golden))){
+		if(ok && firstMismatch < 0){
+			firstField = field;
+		}
+		ok = false;
+	}
+	return ok;
+}
+
+bool AnalysisDiff::compare(const AnalysisLogFrame& result, const AnalysisLogFrame& golden){
+	bool ok = true;
+	auto exact = [&](bool same, const char* field) {
+		if(!same){
+			if(ok && firstMismatch < 0){
+				firstField = field;
+			}
+			ok = false;
+		}
+	};
+
+	exact(result.info.samplePosition == golden.info.samplePosition, "sample position");
+	exact(result.info.fftSize == golden.info.fftSize, "fft size");
+	exact(result.info.bucketCount == golden.info.bucketCount, "bucket count");
+	exact(result.info.inputChecksum == golden.info.inputChecksum, "input checksum");
+	exact((result.info.flags & AnalysisLogs::frameBeat) == (golden.info.flags & AnalysisLogs::frameBeat), "beat");
+
+	_close(result.info.rms, golden.info.rms, maxScalarError, "rms", ok);
+	_close(result.info.peak, golden.info.peak, maxScalarError, "peak", ok);
+	_close(result.info.spectrumEnergy, golden.info.spectrumEnergy, maxScalarError, "spectrum energy", ok);
+	_close(result.info.spectrumCentroid, golden.info.spectrumCentroid, maxScalarError, "spectrum centroid", ok);
+	_close(result.info.onset, golden.info.onset, maxScalarError, "onset", ok);
+	_close(result.info.beatStrength, golden.info.beatStrength, maxScalarError, "beat strength", ok);
+	_close(result.info.tempo, golden.info.tempo, maxScalarError, "tempo", ok);
+
+	if(result.info.bucketCount == golden.info.bucketCount){
+		for(size_t i = 0; i < golden.buckets.size(); i++){
+			_close(result.buckets[i], golden.buckets[i], maxBucketError, "buckets", ok);
+			_close(result.heights[i], golden.heights[i], maxHeightError, "heights", ok);
+			_close(result.peaks[i], golden.peaks[i], maxHeightError, "peak caps", ok);
+		}
+	}
+
+	if(!ok){
+		if(firstMismatch < 0){
+			firstMismatch = frames;
+		}
+		mismatches++;
+	}
+	frames++;
+	return ok;
+}
+
+void AnalysisDiff::addMissing(const char* side){
+	if(firstMismatch < 0){
+		firstMismatch = frames;
+		firstField = side;
+	}
+	mismatches++;
+	frames++;
+}
+
+void AnalysisDiff::print() const{
+	std::cout << "Compared " << frames << " frames (relative tolerance " << tolerance << "): "
+		<< mismatches << " mismatched, max error buckets " << maxBucketError << ", heights " << maxHeightError
+		<< ", scalars " << maxScalarError << "\n";
+	if(firstMismatch >= 0){
+		std::cout << "First mismatch at frame " << firstMismatch << " (" << firstField << ")\n";
+	}
+}
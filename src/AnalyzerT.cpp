@@ -0,0 +1,52 @@
+#include "AnalyzerT.h"
+#include "AudioAnalyzer.h"
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+
+// Both analyzers peek the same block of a synthetic signal from a buffer
+void benchmarkAnalyzerT(){
+	using Clock = std::chrono::steady_clock;
+	const int rate = 44100;
+	AudioBuffer benchmarkBuffer(8192);
+	std::vector<float> signal(4096);
+	for(size_t i = 0; i < signal.size(); i++){
+		double t = static_cast<double>(i) / rate;
+		signal[i] = static_cast<float>(0.5 * std::sin(2.0 * ConstexprMath::pi * 220.0 * t) + 0.25 * std::sin(2.0 * ConstexprMath::pi * 3520.0 * t)
+			+ 0.1 * std::sin(2.0 * ConstexprMath::pi * 9000.0 * t * (1.0 + t)));
+	}
+	benchmarkBuffer.writeBuffer(signal.data(), static_cast<int>(signal.size()));
+
+	// Microseconds per analyzed block, the median of several runs
+	auto timeAnalyzer = [](SpectrumAnalyzer& analyzer){
+		const int blocks = 2000;
+		for(int i = 0; i < blocks / 10; i++){
+			analyzer.analyzeNextBlock();
+		}
+		std::vector<double> runs;
+		for(int run = 0; run < 5; run++){
+			Clock::time_point begin = Clock::now();
+			for(int i = 0; i < blocks; i++){
+				analyzer.analyzeNextBlock();
+			}
+			runs.push_back(std::chrono::duration<double, std::micro>(Clock::now() - begin).count() / blocks);
+		}
+		std::sort(runs.begin(), runs.end());
+		return runs[runs.size() / 2];
+	};
+	auto compare = [&](SpectrumAnalyzer& fixed, int size, int buckets){
+		AudioAnalyzer runtime(&benchmarkBuffer, size, rate, buckets);
+		double fixedMicros = timeAnalyzer(fixed);
+		double runtimeMicros = timeAnalyzer(runtime);
+		std::cout << "AnalyzerT<" << size << ", " << buckets << ">: " << fixedMicros << " us per block, AudioAnalyzer: "
+			  << runtimeMicros << " us per block, " << runtimeMicros / fixedMicros << "x\n";
+	};
+	// On the stack, AnalyzerT keeps its arrays inline (about 40 KB at 4096 points)
+	Analyzer1024x32 fixed1024(&benchmarkBuffer);
+	Analyzer2048x64 fixed2048(&benchmarkBuffer);
+	Analyzer4096x128 fixed4096(&benchmarkBuffer);
+	compare(fixed1024, 1024, 32);
+	compare(fixed2048, 2048, 64);
+	compare(fixed4096, 4096, 128);
+}
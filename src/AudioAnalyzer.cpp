@@ -1,7 +1,33 @@
 #include "AudioAnalyzer.h"
+#include "AudioLoader.h"
+#include <algorithm>
+
+namespace {
+	constexpr int defaultResyncWindows = 8;		// Windows of slid samples between full FFTs
+	constexpr int calibrationRuns = 16;			// Transforms and slides timed by _configureSliding
+}
 
 // Constructor 
-AudioAnalyzer::AudioAnalyzer(AudioBuffer* buffer, int fftSize, int sampleRate, int numBuckets, float lowFreq, float highFreq) : audioBuffer(buffer), fftSize(fftSize), sampleRate(sampleRate), numBuckets(numBuckets), lowFreq(lowFreq), highFreq(highFreq), fftInput(nullptr), fftOutput(nullptr), plan(nullptr), rmsVal(0.0f), peakAmplitude(0.0f){
+AudioAnalyzer::AudioAnalyzer(AudioBuffer* buffer, int fftSize, int sampleRate, int numBuckets, float lowFreq, float highFreq) : audioBuffer(buffer), fftSize(fftSize), sampleRate(sampleRate), numBuckets(numBuckets), lowFreq(lowFreq), highFreq(highFreq), fftInput(nullptr), fftOutput(nullptr), plan(nullptr), rmsVal(0.0f), peakAmplitude(0.0f), blockPosition(0), keepInput(false), profiling(false),
+	sliding(false), previousPosition(-1), samplesSinceResync(0), resyncWindows(defaultResyncWindows), maxSlideHop(0){
+	// Create FFTW execution plan using FFTW_MEASURE for optimal performance (creates fastest possible plan for repeated use, but takes longer for setup)
+	if(!_createPlan(FFTW_MEASURE)){
+		return;
+	}
+
+	// Precompute Hanning window function
+	_computeWindowFunction();
+	// Setup log-based bucket ranges for visualizationBuckets
+	_setupBuckets();
+
+}
+
+// Destructor, frees FFTW resources
+AudioAnalyzer::~AudioAnalyzer(){
+	_destroyPlan();
+}
+
+bool AudioAnalyzer::_createPlan(unsigned planFlags){
 	// Allocate fftw arrays for real to complex transform
 	fftInput = fftwf_alloc_real(fftSize);
 	fftOutput = fftwf_alloc_complex(fftSize / 2 + 1);
@@ -9,36 +35,65 @@ AudioAnalyzer::AudioAnalyzer(AudioBuffer* buffer, int fftSize, int sampleRate, i
 	// Check memory allocation succeeded
 	if (!fftInput || !fftOutput) {
         std::cout << "Failed to allocate FFTW arrays" << std::endl;
-        return;
+        return false;
     }
 
-	// Create FFTW execution plan using FFTW_MEASURE for optimal performance (creates fastest possible plan for repeated use, but takes longer for setup)
-	plan = fftwf_plan_dft_r2c_1d(fftSize, fftInput, fftOutput, FFTW_MEASURE);
+	plan = fftwf_plan_dft_r2c_1d(fftSize, fftInput, fftOutput, planFlags);
 	// Verify plan creation succeeded
 	if(!plan){
         std::cout << "Failed to create fftwfplan" << std::endl;
-        return;
+        return false;
     }
 
 	// Initialize magnitude spectrum vector to hold FFT output magnitudes
-	magnitudeSpectrum.resize(fftSize / 2 + 1);
-	// Precompute Hanning window function
-	_computeWindowFunction();
-	// Setup log-based bucket ranges for visualizationBuckets
-	_setupBuckets();
-
+	magnitudeSpectrum.assign(fftSize / 2 + 1, 0.0f);
+	return true;
 }
 
-// Destructor, frees FFTW resources
-AudioAnalyzer::~AudioAnalyzer(){
+void AudioAnalyzer::_destroyPlan(){
 	if(plan){
 		fftwf_destroy_plan(plan);
+		plan = nullptr;
 	}
 	if(fftInput){
 		fftwf_free(fftInput);
+		fftInput = nullptr;
 	}
 	if(fftOutput){
 		fftwf_free(fftOutput);
+		fftOutput = nullptr;
+	}
+}
+
+bool AudioAnalyzer::setFftSize(int size){
+	if(size == fftSize && plan){
+		return true;
+	}
+	_destroyPlan();
+	fftSize = size;
+	if(!_createPlan(FFTW_ESTIMATE)){
+		return false;
+	}
+	_computeWindowFunction();
+	_setupBuckets();
+	if(sliding){
+		_configureSliding();
+	}
+	return true;
+}
+
+void AudioAnalyzer::setNumBuckets(int count){
+	numBuckets = count;
+	_setupBuckets();
+	if(sliding){
+		_configureSliding();
+	}
+}
+
+void AudioAnalyzer::setSlidingDft(bool enabled){
+	sliding = enabled && plan;
+	if(sliding){
+		_configureSliding();
 	}
 }
 
@@ -49,24 +104,68 @@ bool AudioAnalyzer::analyzeNextBlock(){
 		return false;
 	}
 	// Peek samples from buffer (non destructive)
-	int samplesRead = audioBuffer->peekBuffer(fftInput, fftSize);
+	int samplesRead = audioBuffer->peekBuffer(fftInput, fftSize, &blockPosition);
 	// Make sure enough samples were read
 	if(samplesRead < fftSize){
 		return false;
 	}
+	_analyzeInput();
+	return true;
+}
+
+// Analyzes a block the caller already has, used by offline passes over a decoded file
+bool AudioAnalyzer::analyzeBlock(const float* samples, long long position){
+	if(!fftInput || !fftOutput || !plan ){
+		return false;
+	}
+	std::copy(samples, samples + fftSize, fftInput);
+	blockPosition = position;
+	_analyzeInput();
+	return true;
+}
+
+// Runs the analysis on the samples in fftInput
+void AudioAnalyzer::_analyzeInput(){
+	using Clock = std::chrono::steady_clock;
+	auto elapsed = [](Clock::time_point& since) {
+		Clock::time_point now = Clock::now();
+		double seconds = std::chrono::duration<double>(now - since).count();
+		since = now;
+		return seconds;
+	};
+	Clock::time_point stageStart = profiling ? Clock::now() : Clock::time_point();
+
+	if(keepInput){
+		rawInput.assign(fftInput, fftInput + fftSize);
+	}
 	// Compute RMS and peak amplitude on raw data
 	_computeRmsAndPeak();
-	// Apply Hanning window for FFT
-	_applyWindowFunction();
-	// Execute FFT plan
-	fftwf_execute(plan);
-	// Convert complex FFT output to real magnitudes
-	_convertOutputToMagnitudes();
+	if(sliding){
+		if(profiling) timings.window += elapsed(stageStart);
+		// Slide or resynchronize, then window in the frequency domain
+		_slideSpectrum();
+		if(profiling) timings.fft += elapsed(stageStart);
+		slidingDft.windowedMagnitudes(magnitudeSpectrum.data(), (fftSize - 1.0f) / (static_cast<float>(fftSize) * fftSize));
+		if(profiling) timings.magnitudes += elapsed(stageStart);
+	}
+	else{
+		// Apply Hanning window for FFT
+		_applyWindowFunction();
+		if(profiling) timings.window += elapsed(stageStart);
+		// Execute FFT plan
+		fftwf_execute(plan);
+		if(profiling) timings.fft += elapsed(stageStart);
+		// Convert complex FFT output to real magnitudes
+		_convertOutputToMagnitudes();
+		if(profiling) timings.magnitudes += elapsed(stageStart);
+	}
 	// Convert magnitudes to 32 buckets for visualization
 	_computeBuckets();
-
-	return true;
-} 
+	if(profiling){
+		timings.buckets += elapsed(stageStart);
+		timings.blocks++;
+	}
+}
 
 // Precompute Hanning window coefficients
 void AudioAnalyzer::_computeWindowFunction(){
@@ -113,14 +212,29 @@ void AudioAnalyzer::_convertOutputToMagnitudes(){
 	}
 }
 
-// Setup frequency bucket ranges (currently hardcoded for 32 buckets, 20Hz–16kHz)
-// In future, change this so we can choose buckets?
+// Setup frequency bucket ranges
+// The default 1024 / 32 geometry keeps its hand tuned table, anything else is spaced logarithmically
+// between lowFreq and highFreq with bucket i covering floor(f_i / binWidth) to floor(f_i+1 / binWidth)
 void AudioAnalyzer::_setupBuckets(){
-	numBuckets = 32;
-	//hardcoded using logarithmic scaling
-	bucketRanges = {{0,0},{0,0},{0,0},{0,1},{1,1},{1,1},{1,1},{1,2},{2,3},{3,3},{3,4},{4,5},{5,7},{7,8},{8,10},{10,13},{13,16},{16,19},{19,24},{24,30},{30,37},{37,45},{45,56},{56,69},{69,86},{86,106},{106,130},{130,161},{161,198},{198,244},{244,301},{301,371}};
+	if(fftSize == 1024 && numBuckets == 32){
+		//hardcoded using logarithmic scaling
+		bucketRanges = {{0,0},{0,0},{0,0},{0,1},{1,1},{1,1},{1,1},{1,2},{2,3},{3,3},{3,4},{4,5},{5,7},{7,8},{8,10},{10,13},{13,16},{16,19},{19,24},{24,30},{30,37},{37,45},{45,56},{56,69},{69,86},{86,106},{106,130},{130,161},{161,198},{198,244},{244,301},{301,371}};
+	}
+	else{
+		int lastBin = fftSize / 2;
+		float binWidth = static_cast<float>(sampleRate) / fftSize;
+		float ratio = highFreq / lowFreq;
+		bucketRanges.resize(numBuckets);
+		for(int i = 0; i < numBuckets; i++){
+			int startBin = static_cast<int>(lowFreq * powf(ratio, static_cast<float>(i) / numBuckets) / binWidth);
+			int endBin = static_cast<int>(lowFreq * powf(ratio, static_cast<float>(i + 1) / numBuckets) / binWidth);
+			startBin = std::min(startBin, lastBin);
+			endBin = std::max(startBin, std::min(endBin, lastBin));
+			bucketRanges[i] = {startBin, endBin};
+		}
+	}
 
-	visualizationBuckets.resize(numBuckets);
+	visualizationBuckets.assign(numBuckets, 0.0f);
 }
 
 // Collapse FFT magnitudes into log spaced buckets
@@ -138,4 +252,111 @@ void AudioAnalyzer::_computeBuckets(){
 		int binCount = endBin - startBin + 1;
 		visualizationBuckets[i] = sum / binCount;
 	}
-}
\ No newline at end of file
+}
+
+// Sliding DFT over the bins the buckets read
+// Both costs are measured with this analyzer's plan, so the choice between sliding and transforming fits the machine
+void AudioAnalyzer::_configureSliding(){
+	using Clock = std::chrono::steady_clock;
+	int firstBin = fftSize / 2;
+	int lastBin = 0;
+	for(const std::pair<int, int>& range : bucketRanges){
+		firstBin = std::min(firstBin, range.first);
+		lastBin = std::max(lastBin, range.second);
+	}
+	slidingDft.configure(fftSize, firstBin, lastBin);
+
+	// Full FFT of a block (weighting included) against sliding a window of samples
+	std::fill(fftInput, fftInput + fftSize, 0.0f);
+	Clock::time_point begin = Clock::now();
+	for(int i = 0; i < calibrationRuns; i++){
+		slidingDft.weightBlock(fftInput);
+		fftwf_execute(plan);
+	}
+	double transformSeconds = std::chrono::duration<double>(Clock::now() - begin).count() / calibrationRuns;
+	begin = Clock::now();
+	for(int i = 0; i < calibrationRuns; i++){
+		slidingDft.slide(fftInput, fftInput, fftSize);
+	}
+	double sampleSeconds = std::chrono::duration<double>(Clock::now() - begin).count() / (static_cast<double>(calibrationRuns) * fftSize);
+	maxSlideHop = static_cast<int>(std::min(transformSeconds / std::max(sampleSeconds, 1.0e-12), static_cast<double>(fftSize)));
+
+	// Bins outside the buckets are never computed, the first block is a full FFT
+	slidingDft.configure(fftSize, firstBin, lastBin);
+	magnitudeSpectrum.assign(fftSize / 2 + 1, 0.0f);
+	previousInput.assign(fftSize, 0.0f);
+	previousPosition = -1;
+	samplesSinceResync = 0;
+}
+
+// Slides the spectrum from previousInput to fftInput, or transforms fftInput when sliding would cost more
+void AudioAnalyzer::_slideSpectrum(){
+	long long hop = blockPosition - previousPosition;
+	bool slide = previousPosition >= 0 && hop >= 0 && hop <= maxSlideHop
+		&& samplesSinceResync + hop <= static_cast<long long>(resyncWindows) * fftSize;
+	if(slide){
+		// The oldest hop samples of the previous block leave, the newest hop samples of this one enter
+		int count = static_cast<int>(hop);
+		slidingDft.slide(previousInput.data(), fftInput + fftSize - count, count);
+		samplesSinceResync += count;
+		if(profiling) timings.slid++;
+	}
+	std::copy(fftInput, fftInput + fftSize, previousInput.begin());
+	previousPosition = blockPosition;
+	if(!slide){
+		slidingDft.weightBlock(fftInput);
+		fftwf_execute(plan);
+		slidingDft.reset(fftOutput);
+		samplesSinceResync = 0;
+	}
+}
+
+// Both paths see the first 30 s of the file at every hop, as the live analyzer does (interleaved)
+bool AudioAnalyzer::benchmarkSlidingDft(const char* filename, SampleFormat format){
+	AudioLoader benchmarkLoader;
+	benchmarkLoader.setSampleFormat(format);
+	if(!benchmarkLoader.loadAudioFile(filename)){
+		std::cerr << "Error: Could not load audio file\n";
+		return false;
+	}
+	const SampleStore& store = benchmarkLoader.getAudioData();
+	const int benchmarkFftSize = 1024;
+	const int channelCount = benchmarkLoader.getChannels();
+	std::vector<float> samples(std::min(store.size(), static_cast<size_t>(30) * benchmarkLoader.getSampleRate() * channelCount));
+	store.read(0, samples.data(), samples.size());
+
+	auto microsecondsPerBlock = [](const AnalyzerTimings& timings){
+		return 1.0e6 * (timings.window + timings.fft + timings.magnitudes + timings.buckets) / std::max(timings.blocks, 1LL);
+	};
+	for(int hopFrames : {8, 16, 32, 64, 128, 256, 512}){
+		const size_t hop = static_cast<size_t>(hopFrames) * channelCount;
+		AudioAnalyzer transform(nullptr, benchmarkFftSize, benchmarkLoader.getSampleRate());
+		AudioAnalyzer sliding(nullptr, benchmarkFftSize, benchmarkLoader.getSampleRate());
+		sliding.setSlidingDft(true);
+		transform.setProfiling(true);
+		sliding.setProfiling(true);
+
+		// Bucket errors relative to the loudest bucket of the FFT path
+		double maxError = 0.0, errorSum = 0.0, fullScale = 1.0e-9;
+		long long values = 0;
+		for(size_t position = 0; position + benchmarkFftSize <= samples.size(); position += hop){
+			transform.analyzeBlock(samples.data() + position, static_cast<long long>(position));
+			sliding.analyzeBlock(samples.data() + position, static_cast<long long>(position));
+			const std::vector<float>& expected = transform.getBuckets();
+			const std::vector<float>& result = sliding.getBuckets();
+			for(size_t b = 0; b < expected.size(); b++){
+				double error = std::fabs(result[b] - expected[b]);
+				maxError = std::max(maxError, error);
+				errorSum += error;
+				fullScale = std::max(fullScale, static_cast<double>(expected[b]));
+				values++;
+			}
+		}
+		const AnalyzerTimings& slidTimings = sliding.getTimings();
+		std::cout << "hop " << hopFrames << " frames: FFT " << microsecondsPerBlock(transform.getTimings()) << " us/block, sliding "
+				  << microsecondsPerBlock(slidTimings) << " us/block (" << 100.0 * slidTimings.slid / std::max(slidTimings.blocks, 1LL)
+				  << "% slid, limit " << sliding.getMaxSlideHop() << " samples), bucket error max "
+				  << 100.0 * maxError / fullScale << "%, mean " << 100.0 * errorSum / std::max(values, 1LL) / fullScale << "% of full scale\n";
+	}
+	return true;
+}
@@ -2,12 +2,24 @@
 
 // Constructor initializes ring buffer and sets source position to start
 AudioBuffer::AudioBuffer(int bufferSizeInSamples, const AudioLoader& loader){
-	audioData = &loader.getAudioData();
+	this->loader = &loader;
 	sourcePosition = 0;
+	readSequence.store(0);
+	samplesConsumed.store(0);
 	bufferData = new float[bufferSizeInSamples]; 	//allocates ring buffer storage
 	PaUtil_InitializeRingBuffer(&ringBuffer, sizeof(float), bufferSizeInSamples, bufferData);
 }
 
+// Constructor for live sources, there is no file to pull from
+AudioBuffer::AudioBuffer(int bufferSizeInSamples){
+	loader = nullptr;
+	sourcePosition = 0;
+	readSequence.store(0);
+	samplesConsumed.store(0);
+	bufferData = new float[bufferSizeInSamples];
+	PaUtil_InitializeRingBuffer(&ringBuffer, sizeof(float), bufferSizeInSamples, bufferData);
+}
+
 // Destructor frees ring buffer memory
 AudioBuffer::~AudioBuffer(){
 	delete[] bufferData;
@@ -15,29 +27,86 @@ AudioBuffer::~AudioBuffer(){
 
 bool AudioBuffer::fillBuffer(int samplesToWrite){
 	
+	// No file source (live input writes through writeBuffer)
+	if(!loader){
+		return false;
+	}
+	const SampleStore& audioData = loader->getAudioData();
+	// The end is wherever the decoder stopped once it finished, otherwise the full file length
+	bool decodeFinished = loader->isFullyDecoded();
+	size_t decoded = loader->getDecodedSamples();
+	size_t endPosition = decodeFinished ? decoded : audioData.size();
+
 	// Stop if we reach the end of the audio
-	if(sourcePosition >= audioData->size()){
+	if(sourcePosition >= endPosition){
 		return false;
 	}
 	
 	// Check available space in the buffer
 	int freeSpace = PaUtil_GetRingBufferWriteAvailable(&ringBuffer);
-	// Calculate how much data is left
-	int availableData = static_cast<int>(audioData->size() - sourcePosition);
+	// Calculate how much data is left, only samples the decoder already produced can be used
+	int availableData = static_cast<int>(std::min(decoded - std::min(decoded, sourcePosition), static_cast<size_t>(samplesToWrite)));
 	// Determine how many samples we can actually write
 	int actualSamples = std::min({samplesToWrite, availableData, freeSpace});
 
-	// Write samples from audioData into ring buffer
-	int written = PaUtil_WriteRingBuffer(&ringBuffer, audioData->data() + sourcePosition, actualSamples);
+	// Convert samples from audioData straight into the ring's free space (one or two regions when it wraps)
+	void* regions[2];
+	ring_buffer_size_t regionSizes[2];
+	int written = PaUtil_GetRingBufferWriteRegions(&ringBuffer, actualSamples, &regions[0], &regionSizes[0], &regions[1], &regionSizes[1]);
+	size_t position = sourcePosition;
+	for(int i = 0; i < 2 && regionSizes[i] > 0; i++){
+		float* region = static_cast<float*>(regions[i]);
+		audioData.read(position, region, regionSizes[i]);
+		// Forward the written chunk to streaming stages so each sample is processed exactly once
+		for(SampleTap* tap : taps){
+			tap->processSamples(region, regionSizes[i]);
+		}
+		position += regionSizes[i];
+	}
+	PaUtil_AdvanceRingBufferWriteIndex(&ringBuffer, written);
 	// Advance read pointer in source audio
 	sourcePosition += written;
 	// Return false if we've reached the end, true if more data remains
-	return sourcePosition < audioData->size();
+	return sourcePosition < endPosition;
 }
 
 
+// Called from the live source's thread, PaUtil ring buffer is single producer single consumer lock free
+int AudioBuffer::writeBuffer(const float* samples, int sampleCount){
+	int written = PaUtil_WriteRingBuffer(&ringBuffer, samples, sampleCount);
+	for(SampleTap* tap : taps){
+		tap->processSamples(samples, written);
+	}
+	return written;
+}
+
+// Seqlock write around the read index move, the counter is odd while the index and samplesConsumed disagree
+template <typename Advance>
+int AudioBuffer::_consume(Advance advance){
+	uint32_t sequence = readSequence.load(std::memory_order_relaxed);
+	readSequence.store(sequence + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	int consumed = advance();
+	samplesConsumed.store(samplesConsumed.load(std::memory_order_relaxed) + consumed, std::memory_order_relaxed);
+	readSequence.store(sequence + 2, std::memory_order_release);
+	return consumed;
+}
+
+// Advances the read index past everything but the newest samples (consumer side)
+int AudioBuffer::skipToLatest(int keepSamples){
+	int available = PaUtil_GetRingBufferReadAvailable(&ringBuffer);
+	if(available <= keepSamples){
+		return 0;
+	}
+	return _consume([&]() {
+		return static_cast<int>(PaUtil_AdvanceRingBufferReadIndex(&ringBuffer, available - keepSamples));
+	});
+}
+
 int AudioBuffer::readBuffer(float* output, int frameCount){
-	return PaUtil_ReadRingBuffer(&ringBuffer, output, frameCount);
+	return _consume([&]() {
+		return static_cast<int>(PaUtil_ReadRingBuffer(&ringBuffer, output, frameCount));
+	});
 }
 
 // Copies current buffer as a temp buffer and reads from it to peek without destroying
@@ -46,10 +115,33 @@ int AudioBuffer::peekBuffer(float* output, int frameCount){
 	return PaUtil_ReadRingBuffer(&tempBuffer, output, frameCount);
 }
 
+// Snapshot of the ring and the matching position, retried if the consumer moved in between
+int AudioBuffer::peekBuffer(float* output, int frameCount, long long* position){
+	PaUtilRingBuffer tempBuffer;
+	uint32_t before;
+	uint32_t after;
+	do{
+		before = readSequence.load(std::memory_order_acquire);
+		tempBuffer = ringBuffer;
+		*position = samplesConsumed.load(std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_acquire);
+		after = readSequence.load(std::memory_order_relaxed);
+	} while((before & 1) || before != after);
+	return PaUtil_ReadRingBuffer(&tempBuffer, output, frameCount);
+}
+
 int AudioBuffer::getAvailableReadSamples() const{
 	return PaUtil_GetRingBufferReadAvailable(&ringBuffer);
 }
 
+int AudioBuffer::getAvailableWriteSamples() const{
+	return PaUtil_GetRingBufferWriteAvailable(&ringBuffer);
+}
+
+void AudioBuffer::addTap(SampleTap* tap){
+	taps.push_back(tap);
+}
+
 bool AudioBuffer::hasData() const{
 	return PaUtil_GetRingBufferReadAvailable(&ringBuffer) > 0;
 }
\ No newline at end of file
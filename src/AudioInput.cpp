@@ -0,0 +1,132 @@
+#include "AudioInput.h"
+#include <cstdio>
+#include <algorithm>
+
+// Constructor
+AudioInput::AudioInput(AudioBuffer* buffer, int sampleRate, int channels)
+						: stream(nullptr), audioBuffer(buffer), sampleRate(sampleRate), channels(channels),
+						initialized(false), newestSampleTime(-1.0), droppedSamples(0)
+{
+	PaError err = Pa_Initialize();
+	if(err != paNoError){
+		printf(  "Failed to initialize PortAudio. PortAudio error: %s\n", Pa_GetErrorText( err ) );
+		return;
+	}
+	initialized = true;
+
+	PaDeviceIndex device = Pa_GetDefaultInputDevice();
+	const PaDeviceInfo* info = (device != paNoDevice) ? Pa_GetDeviceInfo(device) : nullptr;
+	if(!info || info->maxInputChannels < 1){
+		printf(  "No default input device available\n" );
+		return;
+	}
+
+	// Fall back to the device's own format where the caller did not ask for one
+	if(this->sampleRate <= 0){
+		this->sampleRate = static_cast<int>(info->defaultSampleRate);
+	}
+	if(this->channels <= 0){
+		this->channels = std::min(2, info->maxInputChannels);
+	}
+
+	PaStreamParameters inputParameters;
+	inputParameters.device = device;
+	inputParameters.channelCount = this->channels;
+	inputParameters.sampleFormat = paFloat32;
+	inputParameters.suggestedLatency = info->defaultLowInputLatency;
+	inputParameters.hostApiSpecificStreamInfo = nullptr;
+
+	err = Pa_OpenStream(&stream,
+						&inputParameters,
+						nullptr,			// no output
+						this->sampleRate,
+						256,				// frames per buffer, matches AudioOutput
+						paNoFlag,
+						inputCallback,
+						this);
+
+	if(err != paNoError){
+		printf(  "Failed to open PortAudio input stream. PortAudio error: %s\n", Pa_GetErrorText( err ) );
+		stream = nullptr;
+	}
+}
+
+// Destructor, stops and closes stream, then shuts down portaudio.
+AudioInput::~AudioInput(){
+	if(stream){
+		Pa_StopStream(stream);
+		Pa_CloseStream(stream);
+		stream = nullptr;
+	}
+	if(initialized){
+		Pa_Terminate();
+	}
+}
+
+// Runs on the PortAudio thread: only a ring buffer write and two atomic stores
+int AudioInput::inputCallback( const void *inputBuffer, void *outputBuffer,
+						unsigned long framesPerBuffer,
+						const PaStreamCallbackTimeInfo* timeInfo,
+						PaStreamCallbackFlags statusFlags,
+						void *userData )
+{
+	(void)outputBuffer;
+	(void)statusFlags;
+	AudioInput* self = static_cast<AudioInput*>(userData);
+	if(!inputBuffer){
+		return paContinue;
+	}
+
+	// Only write whole frames so the interleaving in the ring never slips
+	const float* in = static_cast<const float*>(inputBuffer);
+	int samples = static_cast<int>(framesPerBuffer) * self->channels;
+	int space = self->audioBuffer->getAvailableWriteSamples();
+	int toWrite = std::min(samples, space - space % self->channels);
+	int written = self->audioBuffer->writeBuffer(in, toWrite);
+	if(written < samples){
+		self->droppedSamples.fetch_add(samples - written, std::memory_order_relaxed);
+	}
+
+	// The last sample of this block reached the ADC one block after the first one
+	PaTime adcTime = (timeInfo->inputBufferAdcTime > 0.0) ? timeInfo->inputBufferAdcTime : timeInfo->currentTime;
+	self->newestSampleTime.store(adcTime + static_cast<double>(framesPerBuffer) / self->sampleRate, std::memory_order_release);
+
+	return paContinue;
+}
+
+bool AudioInput::start(){
+	if(!stream) return false;
+
+	PaError err = Pa_StartStream(stream);
+	if(err != paNoError){
+		printf(  "Failed to start PortAudio input stream. PortAudio error: %s\n", Pa_GetErrorText(err) );
+		return false;
+	}
+
+	return true;
+}
+
+bool AudioInput::stop(){
+	if(!stream) return false;
+	PaError err = Pa_StopStream(stream);
+	if(err != paNoError){
+		printf(  "Failed to stop PortAudio input stream. PortAudio error: %s\n", Pa_GetErrorText(err) );
+		return false;
+	}
+
+	return true;
+}
+
+bool AudioInput::isActive() const{
+	if (!stream) return false;
+	return Pa_IsStreamActive(stream) == 1;
+}
+
+// Both times come from the stream clock
+double AudioInput::getCaptureLatency() const{
+	double newest = newestSampleTime.load(std::memory_order_acquire);
+	if(!stream || newest < 0.0){
+		return -1.0;
+	}
+	return Pa_GetStreamTime(stream) - newest;
+}
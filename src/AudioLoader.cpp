@@ -1,27 +1,423 @@
 #include "AudioLoader.h"
 #include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <memory>
+#include <cstdio>
+#include <cmath>
+
+namespace {
+    // Frames decoded per sf_readf_float call while publishing progress (~1.5 s at 44.1 kHz)
+    constexpr sf_count_t decodeChunkFrames = 65536;
+    // Shortest segment worth its own thread and file handle (~6 s at 44.1 kHz)
+    constexpr sf_count_t minSegmentFrames = 262144;
+    // Frames a segment decoder starts early and throws away, so it has settled by its first real frame
+    constexpr sf_count_t prerollFrames = 8192;
+    // Frames compared (and rewritten if they differ) at a time across a segment boundary
+    constexpr sf_count_t verifyChunkFrames = 4096;
+
+    // State of the boundary at the start of a segment
+    constexpr int headPending = 0;      // Not checked yet
+    constexpr int headVerified = 1;     // Previous decoder agreed with this segment's decoder, its data is final
+    constexpr int headTakenOver = 2;    // Decoders never agreed, the previous decoder rewrote the whole segment
+
+    // One segment of a parallel decode, shared between its own thread and the thread of the previous segment
+    struct Segment{
+        sf_count_t start = 0;                   // First frame
+        sf_count_t end = 0;                     // One past the last frame
+        std::atomic<sf_count_t> decoded{0};     // Frames from start written by the segment's own decoder
+        std::atomic<bool> done{false};          // Own decoder finished, failed or hit the end of the file
+        std::atomic<sf_count_t> repaired{0};    // Frames from start confirmed or rewritten by the previous decoder
+        std::atomic<int> head{headPending};     // Boundary state
+    };
+
+    // True if every channel holds one value for the whole chunk (silence or DC). Such a chunk matches at
+    // any offset, so agreeing on it does not prove two decoders are at the same sample
+    bool isConstant(const float* samples, size_t count, int channels){
+        for(size_t i = static_cast<size_t>(channels); i < count; i++){
+            if(samples[i] != samples[i - channels]){
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Largest difference between two stores, sample by sample
+    float maxDifference(const SampleStore& a, const SampleStore& b){
+        if(a.size() != b.size()){
+            return 1.0e9f;
+        }
+        std::vector<float> chunkA(4096), chunkB(4096);
+        float difference = 0.0f;
+        for(size_t position = 0; position < a.size(); position += chunkA.size()){
+            size_t count = std::min(chunkA.size(), a.size() - position);
+            a.read(position, chunkA.data(), count);
+            b.read(position, chunkB.data(), count);
+            for(size_t i = 0; i < count; i++){
+                difference = std::max(difference, std::fabs(chunkA[i] - chunkB[i]));
+            }
+        }
+        return difference;
+    }
+
+    // Uncompressed formats seek sample exactly and need neither preroll nor verification
+    bool hasExactSeek(int format){
+        int major = format & SF_FORMAT_TYPEMASK;
+        if(major == SF_FORMAT_FLAC || major == SF_FORMAT_OGG || major == SF_FORMAT_MPEG){
+            return false;
+        }
+        switch(format & SF_FORMAT_SUBMASK){
+            case SF_FORMAT_PCM_S8:
+            case SF_FORMAT_PCM_16:
+            case SF_FORMAT_PCM_24:
+            case SF_FORMAT_PCM_32:
+            case SF_FORMAT_PCM_U8:
+            case SF_FORMAT_FLOAT:
+            case SF_FORMAT_DOUBLE:
+                return true;
+            default:
+                return false;
+        }
+    }
+}
 
 // Constructor initializes sfInfo.format to 0, as required by libsndfile
-AudioLoader::AudioLoader(){
+AudioLoader::AudioLoader() : audioData(SampleStore::create(SampleFormat::Float32, 1)), sampleFormat(SampleFormat::Auto),
+    openFile(nullptr), decodedSamples(0), fullyDecoded(false), cancelRequested(false), decodeThreads(0){
     sfInfo.format = 0;
 }
 
+AudioLoader::~AudioLoader(){
+    if(openFile){
+        sf_close(openFile);
+    }
+}
+
 // libsndfile is used to load audio file into memory
 bool AudioLoader::loadAudioFile(const char* filename ){
+    return openAudioFile(filename) && decodeAudioFile();
+}
+
+bool AudioLoader::openAudioFile(const char* filename){
+    if(openFile){
+        sf_close(openFile);
+        openFile = nullptr;
+    }
+    decodedSamples.store(0);
+    fullyDecoded.store(false);
+    cancelRequested.store(false);
+
     // Open audio file for reading
-    SNDFILE *infile = sf_open(filename, SFM_READ, &sfInfo);
+    sfInfo.format = 0;
+    openFile = sf_open(filename, SFM_READ, &sfInfo);
     // Check if opening the file failed
-    if(!infile) {
+    if(!openFile) {
         std::cerr << "Failed to open audio file: " << filename << "\n";
         return false;
     }
+    fileName = filename;
+
+    // Auto keeps integer sources in their native width, anything decoded from a float format stays float
+    SampleFormat format = sampleFormat;
+    if(format == SampleFormat::Auto){
+        switch(sfInfo.format & SF_FORMAT_SUBMASK){
+            case SF_FORMAT_PCM_S8:
+            case SF_FORMAT_PCM_U8:
+            case SF_FORMAT_PCM_16:
+                format = SampleFormat::Int16;
+                break;
+            case SF_FORMAT_PCM_24:
+                format = SampleFormat::Int24;
+                break;
+            default:
+                format = SampleFormat::Float32;
+                break;
+        }
+    }
+
+    // Size the store for all frames, decoding fills it in place so readers never see it move
+    audioData = SampleStore::create(format, sfInfo.channels);
+    audioData->resize(sfInfo.frames * sfInfo.channels);
+    return true;
+}
+
+bool AudioLoader::decodeAudioFile(){
+    if(!openFile){
+        return false;
+    }
+
+    int threads = decodeThreads > 0 ? decodeThreads : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    int segmentCount = static_cast<int>(std::min<sf_count_t>(threads, sfInfo.frames / minSegmentFrames));
+    bool parallel = segmentCount > 1 && sfInfo.seekable;
+
+    auto begin = std::chrono::steady_clock::now();
+    sf_count_t framesDone = parallel ? _decodeParallel(segmentCount) : _decodeSerial();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
 
-    // Resize audioData vector to fit all frames
-    audioData.resize(sfInfo.frames * sfInfo.channels);
-    // Read audio data as float samples into the vector 
-    sf_readf_float(infile, audioData.data(), sfInfo.frames);
     // Close audio file
-    sf_close(infile);
+    sf_close(openFile);
+    openFile = nullptr;
+    fullyDecoded.store(true, std::memory_order_release);
+
+    if(cancelRequested.load(std::memory_order_relaxed)){
+        return framesDone > 0;
+    }
+    // Frame counts of compressed formats can be estimates, a short file still plays (the tail stays silent)
+    if(framesDone < sfInfo.frames){
+        std::cerr << "Audio file ended after " << framesDone << " of " << sfInfo.frames << " frames\n";
+    }
+    if(framesDone > 0 && seconds > 0.0){
+        double audioSeconds = static_cast<double>(framesDone) / sfInfo.samplerate;
+        std::cout << "Decoded " << audioSeconds << " s of audio in " << seconds * 1000.0 << " ms on "
+                  << (parallel ? segmentCount : 1) << " thread(s), " << audioSeconds / seconds << "x real time, "
+                  << audioData->getMemoryBytes() / (1024.0 * 1024.0) << " MB as " << audioData->getName() << "\n";
+    }
+    return framesDone > 0;
+}
+
+sf_count_t AudioLoader::_decodeSerial(){
+    // Read audio data as float samples into the store, one chunk at a time so progress is visible to other threads
+    std::vector<float> chunk(static_cast<size_t>(decodeChunkFrames * sfInfo.channels));
+    sf_count_t framesDone = 0;
+    while(framesDone < sfInfo.frames && !cancelRequested.load(std::memory_order_relaxed)){
+        sf_count_t framesToRead = std::min(decodeChunkFrames, sfInfo.frames - framesDone);
+        sf_count_t framesRead = sf_readf_float(openFile, chunk.data(), framesToRead);
+        if(framesRead <= 0){
+            break;
+        }
+        audioData->write(static_cast<size_t>(framesDone * sfInfo.channels), chunk.data(), static_cast<size_t>(framesRead * sfInfo.channels));
+        framesDone += framesRead;
+        decodedSamples.store(static_cast<size_t>(framesDone * sfInfo.channels), std::memory_order_release);
+    }
+    return framesDone;
+}
+
+sf_count_t AudioLoader::_decodeParallel(int segmentCount){
+    const int channels = sfInfo.channels;
+    const bool exactSeek = hasExactSeek(sfInfo.format);
 
+    // Segments start on the store's write alignment (compressed blocks), so no two threads share a block
+    const sf_count_t alignFrames = std::max<sf_count_t>(1, static_cast<sf_count_t>(audioData->getWriteAlignment()) / channels);
+    std::unique_ptr<Segment[]> segments(new Segment[segmentCount]);
+    for(int k = 0; k < segmentCount; k++){
+        segments[k].start = sfInfo.frames * k / segmentCount / alignFrames * alignFrames;
+        segments[k].end = (k + 1 < segmentCount) ? sfInfo.frames * (k + 1) / segmentCount / alignFrames * alignFrames : sfInfo.frames;
+    }
+    // Segment 0 starts at the beginning of the file, nothing to verify
+    segments[0].head.store(headVerified);
+
+    auto isCancelled = [this]() {
+        return cancelRequested.load(std::memory_order_relaxed);
+    };
+
+    // The contiguous prefix of final frames, what readers may see while the decode runs
+    auto finalPrefix = [&]() {
+        sf_count_t prefix = 0;
+        for(int k = 0; k < segmentCount; k++){
+            const Segment& segment = segments[k];
+            sf_count_t final = segment.head.load(std::memory_order_acquire) == headVerified
+                ? segment.decoded.load(std::memory_order_acquire)
+                : segment.repaired.load(std::memory_order_acquire);
+            prefix = segment.start + final;
+            if(final < segment.end - segment.start){
+                break;
+            }
+        }
+        return prefix;
+    };
+    auto publishPrefix = [&]() {
+        size_t samples = static_cast<size_t>(finalPrefix() * channels);
+        size_t current = decodedSamples.load(std::memory_order_relaxed);
+        // Several threads publish, the prefix only grows
+        while(samples > current && !decodedSamples.compare_exchange_weak(current, samples, std::memory_order_release, std::memory_order_relaxed)){}
+    };
+
+    auto decodeSegment = [&](int k) {
+        Segment& segment = segments[k];
+        SNDFILE* file = openFile;
+        bool ok = true;
+
+        // Own handle, started early by the preroll where seeking may not be sample exact
+        if(k > 0){
+            SF_INFO info;
+            info.format = 0;
+            file = sf_open(fileName.c_str(), SFM_READ, &info);
+            sf_count_t preroll = exactSeek ? 0 : std::min(prerollFrames, segment.start);
+            ok = file && sf_seek(file, segment.start - preroll, SEEK_SET) == segment.start - preroll;
+            if(ok && preroll > 0){
+                std::vector<float> discard(static_cast<size_t>(preroll * channels));
+                ok = sf_readf_float(file, discard.data(), preroll) == preroll;
+            }
+        }
+
+        // Own segment, chunk by chunk into the store
+        std::vector<float> chunk(static_cast<size_t>(decodeChunkFrames * channels));
+        sf_count_t length = segment.end - segment.start;
+        sf_count_t decoded = 0;
+        while(ok && decoded < length && !isCancelled()){
+            sf_count_t framesRead = sf_readf_float(file, chunk.data(), std::min(decodeChunkFrames, length - decoded));
+            if(framesRead <= 0){
+                break;
+            }
+            audioData->write(static_cast<size_t>((segment.start + decoded) * channels), chunk.data(), static_cast<size_t>(framesRead * channels));
+            decoded += framesRead;
+            segment.decoded.store(decoded, std::memory_order_release);
+            publishPrefix();
+        }
+        segment.done.store(true, std::memory_order_release);
+
+        // Only a decoder the previous one agreed with may vouch for the next boundary
+        while(segment.head.load(std::memory_order_acquire) == headPending && !isCancelled()){
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        bool authoritative = ok && segment.head.load(std::memory_order_acquire) == headVerified;
+
+        // Keep decoding across the following boundaries until this decoder and the next one agree
+        std::vector<float> scratch(static_cast<size_t>(verifyChunkFrames * channels));
+        bool endOfFile = !authoritative || decoded < length;
+        for(int next = k + 1; authoritative && next < segmentCount && !isCancelled(); next++){
+            Segment& target = segments[next];
+            sf_count_t targetLength = target.end - target.start;
+            sf_count_t position = 0;
+            bool agreed = false;
+
+            while(position < targetLength && !endOfFile && !isCancelled()){
+                sf_count_t framesToRead = std::min(verifyChunkFrames, targetLength - position);
+                sf_count_t framesRead = sf_readf_float(file, scratch.data(), framesToRead);
+                if(framesRead <= 0){
+                    endOfFile = true;
+                    break;
+                }
+                endOfFile = framesRead < framesToRead;
+
+                // Decoders are deterministic, once both are in the same state they agree bit for bit
+                // Wait for the target's own decoder to get this far, unless it stopped short
+                while(target.decoded.load(std::memory_order_acquire) < position + framesRead
+                      && !target.done.load(std::memory_order_acquire) && !isCancelled()){
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+
+                size_t destination = static_cast<size_t>((target.start + position) * channels);
+                size_t samples = static_cast<size_t>(framesRead * channels);
+                if(target.decoded.load(std::memory_order_acquire) >= position + framesRead
+                   && audioData->matches(destination, scratch.data(), samples)){
+                    // Only content that differs from frame to frame pins both decoders to the same sample
+                    if(!isConstant(scratch.data(), samples, channels)){
+                        agreed = true;
+                        break;
+                    }
+                }else{
+                    audioData->write(destination, scratch.data(), samples);
+                }
+                position += framesRead;
+                target.repaired.store(position, std::memory_order_release);
+                publishPrefix();
+            }
+
+            if(agreed){
+                target.head.store(headVerified, std::memory_order_release);
+                publishPrefix();
+                break;
+            }
+            // Rewrote the whole segment (or the file ended), this decoder also owns the next boundary
+            target.head.store(headTakenOver, std::memory_order_release);
+        }
+
+        if(k > 0 && file){
+            sf_close(file);
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for(int k = 1; k < segmentCount; k++){
+        workers.emplace_back(decodeSegment, k);
+    }
+    decodeSegment(0);
+    for(std::thread& worker : workers){
+        worker.join();
+    }
+
+    int repairedBoundaries = 0;
+    sf_count_t repairedFrames = 0;
+    for(int k = 1; k < segmentCount; k++){
+        sf_count_t repaired = segments[k].repaired.load();
+        repairedBoundaries += repaired > 0;
+        repairedFrames += repaired;
+    }
+    if(repairedFrames > 0){
+        std::cout << "Decode: " << repairedBoundaries << " of " << segmentCount - 1 << " segment boundaries repaired, "
+                  << repairedFrames << " frames decoded again\n";
+    }
+    return finalPrefix();
+}
+
+// Every parallel decode is checked against the serial one
+bool AudioLoader::benchmarkDecode(const char* filename){
+    using Clock = std::chrono::steady_clock;
+    AudioLoader serialLoader;
+    serialLoader.setDecodeThreads(1);
+    Clock::time_point serialBegin = Clock::now();
+    if(!serialLoader.loadAudioFile(filename)){
+        std::cerr << "Error: Could not load audio file\n";
+        return false;
+    }
+    double serialSeconds = std::chrono::duration<double>(Clock::now() - serialBegin).count();
+
+    const int cores = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    for(int threads = 2; threads < 2 * cores; threads *= 2){
+        threads = std::min(threads, cores);
+        AudioLoader parallelLoader;
+        parallelLoader.setDecodeThreads(threads);
+        Clock::time_point begin = Clock::now();
+        parallelLoader.loadAudioFile(filename);
+        double seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+
+        bool identical = parallelLoader.getDecodedSamples() == serialLoader.getDecodedSamples()
+            && maxDifference(serialLoader.getAudioData(), parallelLoader.getAudioData()) == 0.0f;
+        std::cout << threads << " threads: " << serialSeconds / seconds << "x the serial speed"
+                  << (identical ? ", identical to the serial decode\n" : ", DIFFERS from the serial decode\n");
+    }
+    return true;
+}
+
+// Every layout is filled in the pieces AudioBuffer::fillBuffer asks for and compared to the float layout
+bool AudioLoader::benchmarkStorage(const char* filename){
+    using Clock = std::chrono::steady_clock;
+    const std::pair<const char*, SampleFormat> layouts[] = {
+        {"float32", SampleFormat::Float32}, {"int16", SampleFormat::Int16},
+        {"int24", SampleFormat::Int24}, {"compressed", SampleFormat::Compressed}
+    };
+    AudioLoader reference;
+    reference.setSampleFormat(SampleFormat::Float32);
+    if(!reference.loadAudioFile(filename)){
+        std::cerr << "Error: Could not load audio file\n";
+        return false;
+    }
+
+    for(const auto& layout : layouts){
+        AudioLoader layoutLoader;
+        layoutLoader.setSampleFormat(layout.second);
+        layoutLoader.loadAudioFile(filename);
+        const SampleStore& store = layoutLoader.getAudioData();
+
+        // Convert the whole file in the pieces fillBuffer asks for (half the ring), repeated for a stable time
+        std::vector<float> piece(4096);
+        size_t converted = 0;
+        Clock::time_point begin = Clock::now();
+        while(Clock::now() - begin < std::chrono::milliseconds(250)){
+            for(size_t position = 0; position < store.size(); position += piece.size()){
+                size_t count = std::min(piece.size(), store.size() - position);
+                store.read(position, piece.data(), count);
+                converted += count;
+            }
+        }
+        double seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+
+        std::cout << layout.first << ": " << store.getMemoryBytes() / (1024.0 * 1024.0) << " MB ("
+                  << static_cast<double>(store.getMemoryBytes()) / std::max<size_t>(store.size(), 1) << " bytes/sample), fill "
+                  << converted / seconds / 1.0e6 << " Msamples/s, max difference to float32 "
+                  << maxDifference(reference.getAudioData(), store) << "\n";
+    }
     return true;
-}   
\ No newline at end of file
+}
@@ -1,8 +1,14 @@
 #include "AudioOutput.h"
+#include <cmath>
+#include <algorithm>
+#include <thread>
 
 // Constructor
 AudioOutput::AudioOutput(AudioBuffer* buffer, int sampleRate, int channels) 
-						: stream(nullptr), audioBuffer(buffer), sampleRate(sampleRate), channels(channels)
+						: stream(nullptr), audioBuffer(buffer), sampleRate(sampleRate), channels(channels),
+						callbackConfigWanted(false), callbackThreadSeen(false), callbackCount(0), underrunCount(0), sourceFinished(false),
+						jitterSquaredSum(0.0), maxJitter(0.0), framesConsumed(0), clockSequence(0), clockFramePosition(0),
+						clockDacTime(0.0), clockFrames(0), outputLatency(0.0)
 {
 	PaError err = Pa_Initialize();
 	if(err != paNoError){
@@ -48,10 +54,51 @@ int AudioOutput::outputCallback( const void *inputBuffer, void *outputBuffer,
 	//Casts userdata back into AudioOutput*
 	AudioOutput* self = static_cast<AudioOutput*>(userData);
 	float* out = static_cast<float*>(outputBuffer);
+
+	// The callback thread only exists once the stream runs. It hands start() its handle and nothing more,
+	// the scheduler calls and their logging stay off the real-time path.
+	if(self->callbackConfigWanted && !self->callbackThreadSeen.load(std::memory_order_relaxed)){
+		self->callbackThread = ThreadTuning::currentThread();
+		self->callbackThreadSeen.store(true, std::memory_order_release);
+	}
+
+	// Interval between callbacks against the nominal buffer period
+	auto now = std::chrono::steady_clock::now();
+	long long count = self->callbackCount.load(std::memory_order_relaxed);
+	if(count > 0){
+		double interval = std::chrono::duration<double>(now - self->lastCallbackTime).count();
+		double deviation = std::fabs(interval - static_cast<double>(framesPerBuffer) / self->sampleRate);
+		self->jitterSquaredSum.store(self->jitterSquaredSum.load(std::memory_order_relaxed) + deviation * deviation, std::memory_order_relaxed);
+		if(deviation > self->maxJitter.load(std::memory_order_relaxed)){
+			self->maxJitter.store(deviation, std::memory_order_relaxed);
+		}
+	}
+	self->lastCallbackTime = now;
+	self->callbackCount.store(count + 1, std::memory_order_relaxed);
 	
 	//Attempt to read samples
 	int samplesRequested = framesPerBuffer * self->channels;
 	int samplesRead = self->audioBuffer->readBuffer(out, samplesRequested);
+
+	// Publish when this buffer's audio will be heard, some host APIs leave the DAC time at 0
+	double dacTime = timeInfo->outputBufferDacTime;
+	if(dacTime <= 0.0){
+		dacTime = Pa_GetStreamTime(self->stream) + self->outputLatency;
+	}
+	long long position = self->framesConsumed.load(std::memory_order_relaxed);
+	uint32_t sequence = self->clockSequence.load(std::memory_order_relaxed);
+	self->clockSequence.store(sequence + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	self->clockFramePosition.store(position, std::memory_order_relaxed);
+	self->clockDacTime.store(dacTime, std::memory_order_relaxed);
+	self->clockFrames.store(samplesRead / self->channels, std::memory_order_relaxed);
+	self->clockSequence.store(sequence + 2, std::memory_order_release);
+	self->framesConsumed.store(position + samplesRead / self->channels, std::memory_order_relaxed);
+
+	if((samplesRead < samplesRequested && !self->sourceFinished.load(std::memory_order_relaxed))
+		|| (statusFlags & paOutputUnderflow)){
+		self->underrunCount.fetch_add(1, std::memory_order_relaxed);
+	}
 	
 	//If not enough samples were read, fill the rest with silence
 	for(int i = samplesRead; i < framesPerBuffer * self->channels; i++){
@@ -66,12 +113,29 @@ int AudioOutput::outputCallback( const void *inputBuffer, void *outputBuffer,
 bool AudioOutput::start(){
 	if(!stream) return false;
 
+	const PaStreamInfo* info = Pa_GetStreamInfo(stream);
+	outputLatency = info ? info->outputLatency : 0.0;
+
 	PaError err = Pa_StartStream(stream);
 	if(err != paNoError){
 		printf(  "Failed to start PortAudio stream. PortAudio error: %s\n", Pa_GetErrorText(err) );
 		return false;
 	}
 
+	// Wait for the first callback to publish its thread, then tune it from here
+	if(callbackConfigWanted){
+		auto giveUp = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+		while(!callbackThreadSeen.load(std::memory_order_acquire) && std::chrono::steady_clock::now() < giveUp){
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		if(callbackThreadSeen.load(std::memory_order_acquire)){
+			ThreadTuning::applyToThread(callbackThread, callbackConfig);
+		}
+		else{
+			printf(  "No audio callback within 2 s, callback thread settings not applied\n" );
+		}
+	}
+
 	return true;
 }
 
@@ -93,3 +157,37 @@ bool AudioOutput::isActive() const{
 	return Pa_IsStreamActive(stream) == 1;
 }
 
+void AudioOutput::setCallbackThreadConfig(const ThreadConfig& config){
+	callbackConfig = config;
+	callbackConfigWanted = true;
+}
+
+double AudioOutput::getCallbackJitter() const{
+	long long intervals = callbackCount.load(std::memory_order_relaxed) - 1;
+	if(intervals <= 0) return 0.0;
+	return std::sqrt(jitterSquaredSum.load(std::memory_order_relaxed) / intervals);
+}
+
+// Heard position = frames before the latest callback + stream time elapsed since its DAC time, never past the
+// frames it delivered (the clock stalls instead of running ahead when the callback is late)
+double AudioOutput::getPlaybackTime() const{
+	if(!stream) return 0.0;
+	long long position;
+	double dacTime;
+	int frames;
+	uint32_t before;
+	uint32_t after;
+	do{
+		before = clockSequence.load(std::memory_order_acquire);
+		position = clockFramePosition.load(std::memory_order_relaxed);
+		dacTime = clockDacTime.load(std::memory_order_relaxed);
+		frames = clockFrames.load(std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_acquire);
+		after = clockSequence.load(std::memory_order_relaxed);
+	} while((before & 1) || before != after);
+
+	if(before == 0) return 0.0;
+	double heard = position + (Pa_GetStreamTime(stream) - dacTime) * sampleRate;
+	heard = std::min(std::max(heard, 0.0), static_cast<double>(position + frames));
+	return heard / sampleRate;
+}
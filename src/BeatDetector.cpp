@@ -0,0 +1,202 @@
+#include "BeatDetector.h"
+#include <cmath>
+#include <algorithm>
+
+namespace {
+	constexpr int thresholdWindowFrames = 32;	// ~0.5 s at 60 frames per second
+	constexpr float noveltySeconds = 6.0f;		// Length of the tempo autocorrelation window
+	constexpr float preferredBpm = 120.0f;		// Center of the perceptual tempo prior
+}
+
+// Constructor
+BeatDetector::BeatDetector(int spectrumSize, float frameRate, float minBpm, float maxBpm)
+	: spectrumSize(spectrumSize), compression(1000.0f), thresholdMultiplier(1.5f), minimumThreshold(0.02f){
+	previousLogSpectrum.resize(spectrumSize);
+	fluxHistory.resize(thresholdWindowFrames);
+
+	// Lag range in frames from the tempo range at the nominal frame rate
+	minLag = std::max(1, static_cast<int>(std::floor(60.0f * frameRate / maxBpm)));
+	maxLag = std::max(minLag + 2, static_cast<int>(std::ceil(60.0f * frameRate / minBpm)));
+	noveltyWindow = std::max(2 * maxLag, static_cast<int>(noveltySeconds * frameRate));
+	novelty.resize(noveltyWindow + maxLag + 1);
+	autocorrelation.resize(maxLag - minLag + 1);
+	framePeriod = 1.0 / frameRate;
+
+	reset();
+}
+
+void BeatDetector::reset(){
+	std::fill(previousLogSpectrum.begin(), previousLogSpectrum.end(), 0.0f);
+	hasPrevious = false;
+
+	std::fill(fluxHistory.begin(), fluxHistory.end(), 0.0f);
+	fluxIndex = 0;
+	fluxCount = 0;
+	fluxSum = 0.0;
+	fluxSumSquares = 0.0;
+
+	lastFlux = 0.0f;
+	lastThreshold = 0.0f;
+	secondLastFlux = 0.0f;
+	lastFrameTime = -1.0;
+	lastBeatTime = -1.0e9;
+
+	std::fill(novelty.begin(), novelty.end(), 0.0f);
+	noveltyIndex = 0;
+	noveltyCount = 0;
+	std::fill(autocorrelation.begin(), autocorrelation.end(), 0.0);
+
+	beat = false;
+	beatStrength = 0.0f;
+	tempoBpm = 0.0f;
+	currentNovelty = 0.0f;
+}
+
+void BeatDetector::process(const std::vector<float>& spectrum, double frameTime){
+	beat = false;
+	if(static_cast<int>(spectrum.size()) != spectrumSize){
+		return;
+	}
+
+	// Track the real frame rate, analysis frames are not perfectly periodic
+	if(lastFrameTime >= 0.0){
+		double dt = frameTime - lastFrameTime;
+		if(dt > 0.0 && dt < 1.0){
+			framePeriod += 0.05 * (dt - framePeriod);
+		}
+	}
+
+	float flux = _computeFlux(spectrum);
+	float threshold = _updateThreshold(flux);
+	currentNovelty = flux;
+
+	// Confirm the previous frame as an onset if it is a local maximum above its threshold
+	double refractory = (tempoBpm > 0.0f) ? 0.4 * 60.0 / tempoBpm : 0.1;
+	if(lastFlux > lastThreshold && lastFlux > secondLastFlux && lastFlux >= flux
+		&& lastFrameTime - lastBeatTime >= refractory){
+		beat = true;
+		beatStrength = std::min(1.0f, (lastFlux - lastThreshold) / lastThreshold);
+		lastBeatTime = lastFrameTime;
+	}
+
+	secondLastFlux = lastFlux;
+	lastFlux = flux;
+	lastThreshold = threshold;
+	lastFrameTime = frameTime;
+
+	_updateAutocorrelation(flux);
+	_estimateTempo();
+}
+
+// Half wave rectified difference of log compressed magnitudes, averaged over bins
+float BeatDetector::_computeFlux(const std::vector<float>& spectrum){
+	float flux = 0.0f;
+	for(int i = 0; i < spectrumSize; i++){
+		float logMagnitude = std::log1p(compression * spectrum[i]);
+		flux += std::max(0.0f, logMagnitude - previousLogSpectrum[i]);
+		previousLogSpectrum[i] = logMagnitude;
+	}
+
+	if(!hasPrevious){
+		hasPrevious = true;
+		return 0.0f;
+	}
+	return flux / spectrumSize;
+}
+
+// Running mean and standard deviation over the threshold window, O(1) per frame
+float BeatDetector::_updateThreshold(float flux){
+	float threshold = minimumThreshold;
+	if(fluxCount > 0){
+		double mean = fluxSum / fluxCount;
+		double variance = std::max(0.0, fluxSumSquares / fluxCount - mean * mean);
+		threshold = std::max(minimumThreshold, static_cast<float>(mean + thresholdMultiplier * std::sqrt(variance)));
+	}
+
+	if(fluxCount == thresholdWindowFrames){
+		float oldest = fluxHistory[fluxIndex];
+		fluxSum -= oldest;
+		fluxSumSquares -= static_cast<double>(oldest) * oldest;
+	}
+	else{
+		fluxCount++;
+	}
+	fluxHistory[fluxIndex] = flux;
+	fluxSum += flux;
+	fluxSumSquares += static_cast<double>(flux) * flux;
+	fluxIndex = (fluxIndex + 1) % thresholdWindowFrames;
+
+	return threshold;
+}
+
+float BeatDetector::_noveltyAt(long long age) const{
+	if(age >= noveltyCount){
+		return 0.0f;
+	}
+	int size = static_cast<int>(novelty.size());
+	return novelty[(noveltyIndex - 1 - static_cast<int>(age) + 2 * size) % size];
+}
+
+// Adds the pairs formed by the new value and removes the pairs whose newer element left the window.
+// A full recompute every window length keeps the running sums exact, so the amortized cost stays O(lags).
+void BeatDetector::_updateAutocorrelation(float value){
+	novelty[noveltyIndex] = value;
+	noveltyIndex = (noveltyIndex + 1) % static_cast<int>(novelty.size());
+	noveltyCount++;
+
+	if(noveltyCount % noveltyWindow == 0){
+		_recomputeAutocorrelation();
+		return;
+	}
+
+	float leaving = _noveltyAt(noveltyWindow);
+	for(int lag = minLag; lag <= maxLag; lag++){
+		autocorrelation[lag - minLag] += static_cast<double>(value) * _noveltyAt(lag)
+			- static_cast<double>(leaving) * _noveltyAt(noveltyWindow + lag);
+	}
+}
+
+void BeatDetector::_recomputeAutocorrelation(){
+	long long span = std::min<long long>(noveltyWindow, noveltyCount);
+	for(int lag = minLag; lag <= maxLag; lag++){
+		double sum = 0.0;
+		for(long long age = 0; age < span; age++){
+			sum += static_cast<double>(_noveltyAt(age)) * _noveltyAt(age + lag);
+		}
+		autocorrelation[lag - minLag] = sum;
+	}
+}
+
+// Strongest lag weighted by a log-Gaussian prior around 120 BPM, refined with parabolic interpolation
+void BeatDetector::_estimateTempo(){
+	if(noveltyCount < 2 * maxLag){
+		return;
+	}
+
+	int bestIndex = -1;
+	double bestScore = 0.0;
+	for(int i = 0; i < static_cast<int>(autocorrelation.size()); i++){
+		double bpm = 60.0 / ((minLag + i) * framePeriod);
+		double octaves = std::log2(bpm / preferredBpm);
+		double score = autocorrelation[i] * std::exp(-0.5 * octaves * octaves);
+		if(score > bestScore){
+			bestScore = score;
+			bestIndex = i;
+		}
+	}
+	if(bestIndex < 0){
+		return;
+	}
+
+	double lag = minLag + bestIndex;
+	if(bestIndex > 0 && bestIndex < static_cast<int>(autocorrelation.size()) - 1){
+		double left = autocorrelation[bestIndex - 1];
+		double center = autocorrelation[bestIndex];
+		double right = autocorrelation[bestIndex + 1];
+		double denominator = left - 2.0 * center + right;
+		if(denominator < 0.0){
+			lag += 0.5 * (left - right) / denominator;
+		}
+	}
+	tempoBpm = static_cast<float>(60.0 / (lag * framePeriod));
+}
@@ -0,0 +1,297 @@
+#include "FeatureExtractor.h"
+#include "FeatureWriter.h"
+#include "AudioLoader.h"
+#include "AudioAnalyzer.h"
+#include "LoudnessMeter.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <thread>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FEATURE_EXTRACTOR_SSE2 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define FEATURE_EXTRACTOR_NEON 1
+#endif
+
+namespace {
+	constexpr float pi = 3.14159265358979323846f;
+	constexpr float logFloor = 1.0e-10f;		// Power floor before the log, silence maps to ln(1e-10)
+
+	float hzToMel(float hz){
+		return 2595.0f * std::log10(1.0f + hz / 700.0f);
+	}
+
+	float melToHz(float mel){
+		return 700.0f * (std::pow(10.0f, mel / 2595.0f) - 1.0f);
+	}
+
+	// Dot product with four lanes, the kernel of both the filterbank and the DCT
+	float dot(const float* a, const float* b, int count){
+		int i = 0;
+		float sum = 0.0f;
+#if defined(FEATURE_EXTRACTOR_SSE2)
+		__m128 accumulator = _mm_setzero_ps();
+		for(; i + 4 <= count; i += 4){
+			accumulator = _mm_add_ps(accumulator, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+		}
+		float lanes[4];
+		_mm_storeu_ps(lanes, accumulator);
+		sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#elif defined(FEATURE_EXTRACTOR_NEON)
+		float32x4_t accumulator = vdupq_n_f32(0.0f);
+		for(; i + 4 <= count; i += 4){
+			accumulator = vmlaq_f32(accumulator, vld1q_f32(a + i), vld1q_f32(b + i));
+		}
+		float lanes[4];
+		vst1q_f32(lanes, accumulator);
+		sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#endif
+		for(; i < count; i++){
+			sum += a[i] * b[i];
+		}
+		return sum;
+	}
+}
+
+// Constructor
+FeatureExtractor::FeatureExtractor(int spectrumSize, float spectrumSampleRate, int melBands, int coefficients,
+	int deltaWidth, float lowFreq, float highFreq)
+	: spectrumSize(spectrumSize), spectrumSampleRate(spectrumSampleRate), melBands(std::max(1, melBands)),
+	coefficients(std::min(std::max(1, coefficients), std::max(1, melBands))), deltaWidth(std::min(std::max(1, deltaWidth), maxDeltaWidth)),
+	lowFreq(lowFreq), highFreq(std::min(highFreq, spectrumSampleRate / 2.0f)){
+	_setupFilterbank();
+
+	// Orthonormal DCT-II, row k: sqrt(2 / M) cos(pi k (m + 0.5) / M), row 0 scaled by 1 / sqrt(2)
+	dctMatrix.resize(static_cast<size_t>(this->coefficients) * this->melBands);
+	for(int k = 0; k < this->coefficients; k++){
+		float scale = std::sqrt((k == 0 ? 1.0f : 2.0f) / this->melBands);
+		for(int m = 0; m < this->melBands; m++){
+			dctMatrix[k * this->melBands + m] = scale * std::cos(pi * k * (m + 0.5f) / this->melBands);
+		}
+	}
+
+	history.resize(static_cast<size_t>(2 * this->deltaWidth + 1) * getColumns());
+	row.resize(getColumns());
+	reset();
+}
+
+void FeatureExtractor::setSpectrumSize(int size){
+	if(size != spectrumSize){
+		spectrumSize = size;
+		_setupFilterbank();
+	}
+}
+
+void FeatureExtractor::reset(){
+	std::fill(history.begin(), history.end(), 0.0f);
+	std::fill(row.begin(), row.end(), 0.0f);
+	framesIn = 0;
+	framesOut = 0;
+}
+
+// Triangles with edges evenly spaced on the mel scale, weights taken at each bin's center frequency.
+// A filter narrower than a bin gets its nearest bin, so every band sees some energy.
+void FeatureExtractor::_setupFilterbank(){
+	power.assign(spectrumSize, 0.0f);
+	filterStart.resize(melBands);
+	filterLength.resize(melBands);
+	filterOffset.resize(melBands);
+	filterWeights.clear();
+
+	float binWidth = spectrumSampleRate / (2.0f * (spectrumSize - 1));
+	float lowMel = hzToMel(lowFreq);
+	float highMel = hzToMel(highFreq);
+	std::vector<float> edges(melBands + 2);
+	for(int i = 0; i < melBands + 2; i++){
+		edges[i] = melToHz(lowMel + (highMel - lowMel) * i / (melBands + 1));
+	}
+
+	for(int i = 0; i < melBands; i++){
+		float left = edges[i];
+		float center = edges[i + 1];
+		float right = edges[i + 2];
+		int firstBin = std::max(0, static_cast<int>(std::ceil(left / binWidth)));
+		int lastBin = std::min(spectrumSize - 1, static_cast<int>(std::floor(right / binWidth)));
+
+		filterOffset[i] = static_cast<int>(filterWeights.size());
+		filterStart[i] = firstBin;
+		for(int bin = firstBin; bin <= lastBin; bin++){
+			float frequency = bin * binWidth;
+			float weight = (frequency <= center) ? (frequency - left) / (center - left) : (right - frequency) / (right - center);
+			filterWeights.push_back(std::max(0.0f, weight));
+		}
+		if(lastBin < firstBin){
+			filterStart[i] = std::min(spectrumSize - 1, static_cast<int>(std::lround(center / binWidth)));
+			filterWeights.push_back(1.0f);
+		}
+		filterLength[i] = static_cast<int>(filterWeights.size()) - filterOffset[i];
+	}
+}
+
+void FeatureExtractor::computeStatic(const float* spectrum, float* frame){
+	for(int i = 0; i < spectrumSize; i++){
+		power[i] = spectrum[i] * spectrum[i];
+	}
+
+	// Log mel energies
+	for(int i = 0; i < melBands; i++){
+		float energy = dot(filterWeights.data() + filterOffset[i], power.data() + filterStart[i], filterLength[i]);
+		frame[i] = std::log(std::max(energy, logFloor));
+	}
+
+	// MFCCs
+	float* mfcc = frame + melBands;
+	for(int k = 0; k < coefficients; k++){
+		mfcc[k] = dot(dctMatrix.data() + static_cast<size_t>(k) * melBands, frame, melBands);
+	}
+}
+
+// d = sum n (c[t + n] - c[t - n]) / (2 sum n^2), context[deltaWidth] is frame t itself
+void FeatureExtractor::_computeDelta(const float* const* context, float* delta) const{
+	float normalizer = 0.0f;
+	for(int n = 1; n <= deltaWidth; n++){
+		normalizer += 2.0f * n * n;
+	}
+	for(int k = 0; k < coefficients; k++){
+		float sum = 0.0f;
+		for(int n = 1; n <= deltaWidth; n++){
+			sum += n * (context[deltaWidth + n][k] - context[deltaWidth - n][k]);
+		}
+		delta[k] = sum / normalizer;
+	}
+}
+
+void FeatureExtractor::computeDeltas(float* rows, size_t rowCount) const{
+	const int columns = getColumns();
+	std::vector<const float*> context(2 * deltaWidth + 1);
+	for(size_t frame = 0; frame < rowCount; frame++){
+		for(int j = 0; j <= 2 * deltaWidth; j++){
+			long long neighbour = static_cast<long long>(frame) + j - deltaWidth;
+			neighbour = std::min(std::max(neighbour, 0LL), static_cast<long long>(rowCount) - 1);
+			context[j] = rows + neighbour * columns + melBands;
+		}
+		_computeDelta(context.data(), rows + frame * columns + melBands + coefficients);
+	}
+}
+
+void FeatureExtractor::_emitRow(long long frame, long long lastFrame){
+	const int columns = getColumns();
+	const long long slots = 2 * deltaWidth + 1;
+	const float* context[2 * maxDeltaWidth + 1];
+	for(int j = 0; j < slots; j++){
+		long long neighbour = std::min(std::max(frame + j - deltaWidth, 0LL), lastFrame);
+		context[j] = history.data() + (neighbour % slots) * columns + melBands;
+	}
+	std::memcpy(row.data(), history.data() + (frame % slots) * columns, sizeof(float) * (melBands + coefficients));
+	_computeDelta(context, row.data() + melBands + coefficients);
+	framesOut++;
+}
+
+bool FeatureExtractor::process(const float* spectrum){
+	const long long slots = 2 * deltaWidth + 1;
+	computeStatic(spectrum, history.data() + (framesIn % slots) * getColumns());
+	framesIn++;
+
+	// Frame t is complete once frame t + deltaWidth arrived
+	if(framesIn <= deltaWidth){
+		return false;
+	}
+	_emitRow(framesIn - 1 - deltaWidth, framesIn - 1);
+	return true;
+}
+
+bool FeatureExtractor::flush(){
+	if(framesOut >= framesIn){
+		return false;
+	}
+	_emitRow(framesOut, framesIn - 1);
+	return true;
+}
+
+// Frames are split across all cores and written as one feature matrix. The loudness of the whole file is measured
+// alongside on one more thread, every sample once in order.
+bool FeatureExtractor::extractFile(const char* audioFile, const char* outFile, SampleFormat format){
+	using Clock = std::chrono::steady_clock;
+	AudioLoader featureLoader;
+	featureLoader.setSampleFormat(format);
+	if(!featureLoader.loadAudioFile(audioFile)){
+		std::cerr << "Error: Could not load audio file\n";
+		return false;
+	}
+	const SampleStore& store = featureLoader.getAudioData();
+	const int featureFftSize = 1024;
+	const int channelCount = featureLoader.getChannels();
+	const int hop = std::max(channelCount, featureFftSize / 2 - (featureFftSize / 2) % channelCount);
+	const size_t frames = store.size() >= static_cast<size_t>(featureFftSize) ? (store.size() - featureFftSize) / hop + 1 : 0;
+
+	// Bins are spaced for the interleaved rate like the live analyzer's, the filterbank stops at the real Nyquist
+	const float spectrumRate = static_cast<float>(featureLoader.getSampleRate() * channelCount);
+	FeatureExtractor extractor(featureFftSize / 2 + 1, spectrumRate, 40, 13, 2, 20.0f, featureLoader.getSampleRate() / 2.0f);
+	const int columns = extractor.getColumns();
+	std::vector<float> matrix(frames * columns);
+
+	// FFTW's planner is not thread safe, every worker gets an analyzer planned here first
+	const int workers = static_cast<int>(std::max<size_t>(1, std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), frames)));
+	std::vector<std::unique_ptr<AudioAnalyzer>> analyzers;
+	for(int i = 0; i < workers; i++){
+		analyzers.push_back(std::make_unique<AudioAnalyzer>(nullptr, featureFftSize, featureLoader.getSampleRate()));
+	}
+
+	std::vector<double> busySeconds(workers, 0.0), featureSeconds(workers, 0.0);
+	std::vector<std::thread> threads;
+	Clock::time_point begin = Clock::now();
+	LoudnessMeter fileLoudness(featureLoader.getSampleRate(), channelCount);
+	threads.emplace_back([&](){
+		std::vector<float> chunk(4096 * channelCount);
+		for(size_t position = 0; position < store.size(); position += chunk.size()){
+			size_t count = std::min(chunk.size(), store.size() - position);
+			store.read(position, chunk.data(), count);
+			fileLoudness.processSamples(chunk.data(), static_cast<int>(count));
+		}
+	});
+	for(int w = 0; w < workers; w++){
+		threads.emplace_back([&, w](){
+			FeatureExtractor local = extractor;
+			std::vector<float> block(featureFftSize);
+			Clock::time_point threadBegin = Clock::now();
+			for(size_t frame = frames * w / workers; frame < frames * (w + 1) / workers; frame++){
+				store.read(frame * hop, block.data(), featureFftSize);
+				analyzers[w]->analyzeBlock(block.data());
+				Clock::time_point featureBegin = Clock::now();
+				local.computeStatic(analyzers[w]->getSpectrum().data(), matrix.data() + frame * columns);
+				featureSeconds[w] += std::chrono::duration<double>(Clock::now() - featureBegin).count();
+			}
+			busySeconds[w] = std::chrono::duration<double>(Clock::now() - threadBegin).count();
+		});
+	}
+	for(std::thread& thread : threads){
+		thread.join();
+	}
+	extractor.computeDeltas(matrix.data(), frames);
+	double seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+
+	double busy = 0.0, featureBusy = 0.0;
+	for(int w = 0; w < workers; w++){
+		busy += busySeconds[w];
+		featureBusy += featureSeconds[w];
+	}
+	std::cout << frames << " frames x " << columns << " features in " << seconds * 1000.0 << " ms on " << workers << " threads: "
+			  << frames / seconds << " frames/s, " << frames / std::max(busy, 1.0e-9) << " frames/s per core ("
+			  << frames / std::max(featureBusy, 1.0e-9) << " frames/s per core for the features alone)\n";
+	std::cout << "Integrated loudness: " << fileLoudness.getIntegratedLoudness() << " LUFS, "
+			  << "loudness range: " << fileLoudness.getLoudnessRange() << " LU, "
+			  << "true peak: " << fileLoudness.getTruePeak() << " dBTP\n";
+
+	FeatureWriter writer;
+	if(!writer.open(outFile, FeatureWriter::layoutOf(extractor, spectrumRate, featureFftSize, hop))){
+		return false;
+	}
+	writer.writeRows(matrix.data(), frames);
+	return writer.close();
+}
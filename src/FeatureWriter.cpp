@@ -0,0 +1,97 @@
+#include "FeatureWriter.h"
+#include "FeatureExtractor.h"
+#include <iostream>
+
+// Constructor
+FeatureWriter::FeatureWriter() : file(nullptr), header{}{
+}
+
+// Destructor
+FeatureWriter::~FeatureWriter(){
+	close();
+}
+
+FeatureFileHeader FeatureWriter::layoutOf(const FeatureExtractor& extractor, float spectrumRate, int fftSize, int hopSamples){
+	FeatureFileHeader layout = {};
+	layout.columns = static_cast<uint32_t>(extractor.getColumns());
+	layout.melBands = static_cast<uint32_t>(extractor.getMelBands());
+	layout.coefficients = static_cast<uint32_t>(extractor.getCoefficients());
+	layout.deltaWidth = static_cast<uint32_t>(extractor.getDeltaWidth());
+	layout.sampleRate = static_cast<uint32_t>(spectrumRate);
+	layout.fftSize = static_cast<uint32_t>(fftSize);
+	layout.hopSamples = static_cast<uint32_t>(hopSamples);
+	return layout;
+}
+
+bool FeatureWriter::open(const char* path, const FeatureFileHeader& layout){
+	close();
+	file = std::fopen(path, "wb");
+	if(!file){
+		std::cout << "Failed to create feature file " << path << std::endl;
+		return false;
+	}
+
+	header = layout;
+	header.magic = FeatureFiles::magic;
+	header.version = FeatureFiles::layoutVersion;
+	header.rows = 0;
+	pending.clear();
+	pending.reserve(static_cast<size_t>(FeatureFiles::batchRows) * header.columns);
+
+	if(std::fwrite(&header, sizeof(header), 1, file) != 1){
+		std::cout << "Failed to write feature file header" << std::endl;
+		std::fclose(file);
+		file = nullptr;
+		return false;
+	}
+	return true;
+}
+
+bool FeatureWriter::_writePending(){
+	if(pending.empty()){
+		return true;
+	}
+	bool written = std::fwrite(pending.data(), sizeof(float), pending.size(), file) == pending.size();
+	header.rows += pending.size() / header.columns;
+	pending.clear();
+	return written;
+}
+
+void FeatureWriter::writeRow(const float* row){
+	if(!file){
+		return;
+	}
+	pending.insert(pending.end(), row, row + header.columns);
+	if(pending.size() >= static_cast<size_t>(FeatureFiles::batchRows) * header.columns){
+		_writePending();
+	}
+}
+
+void FeatureWriter::writeRows(const float* rows, size_t rowCount){
+	if(!file){
+		return;
+	}
+	_writePending();
+	header.rows += std::fwrite(rows, sizeof(float) * header.columns, rowCount, file);
+}
+
+uint64_t FeatureWriter::getRowCount() const{
+	return header.rows + (header.columns ? pending.size() / header.columns : 0);
+}
+
+bool FeatureWriter::close(){
+	if(!file){
+		return false;
+	}
+	bool written = _writePending();
+
+	// Row count goes into the header last, so an interrupted file reads as empty instead of short
+	written = std::fseek(file, 0, SEEK_SET) == 0 && written;
+	written = std::fwrite(&header, sizeof(header), 1, file) == 1 && written;
+	written = std::fclose(file) == 0 && written;
+	file = nullptr;
+	if(!written){
+		std::cout << "Failed to write feature file" << std::endl;
+	}
+	return written;
+}
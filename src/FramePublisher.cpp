@@ -0,0 +1,152 @@
+#include "FramePublisher.h"
+#include "FrameReader.h"
+#include <iostream>
+#include <algorithm>
+#include <new>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstring>
+#include <cerrno>
+#endif
+
+// Constructor
+FramePublisher::FramePublisher() : mapping(nullptr), mappingSize(0), header(nullptr), slots(nullptr), nextSequence(1),
+	objectDevice(0), objectInode(0){
+}
+
+// Destructor, removes the ring (if it is still ours) so readers notice the publisher is gone
+FramePublisher::~FramePublisher(){
+	close();
+}
+
+bool FramePublisher::open(const char* shmName, int slotCount, int sampleRate, bool replace){
+#ifdef _WIN32
+	(void)shmName; (void)slotCount; (void)sampleRate; (void)replace;
+	std::cerr << "Shared memory frame publishing is not supported on Windows\n";
+	return false;
+#else
+	close();
+	if(slotCount < 2){
+		std::cerr << "FramePublisher needs at least 2 slots\n";
+		return false;
+	}
+
+	// An existing ring may belong to a running publisher, only an explicit replace unlinks it
+	if(replace){
+		shm_unlink(shmName);
+	}
+	int fd = shm_open(shmName, O_CREAT | O_EXCL | O_RDWR, 0644);
+	if(fd < 0 && errno == EEXIST){
+		std::cerr << "Shared memory " << shmName << " already exists, another instance may be publishing to it"
+				  << " (--force replaces it)\n";
+		return false;
+	}
+	if(fd < 0){
+		std::cerr << "Failed to create shared memory " << shmName << ": " << strerror(errno) << "\n";
+		return false;
+	}
+
+	size_t size = sizeof(SharedFrameHeader) + sizeof(SharedFrameSlot) * static_cast<size_t>(slotCount);
+	if(ftruncate(fd, static_cast<off_t>(size)) != 0){
+		std::cerr << "Failed to size shared memory " << shmName << ": " << strerror(errno) << "\n";
+		::close(fd);
+		shm_unlink(shmName);
+		return false;
+	}
+
+	// Remembered so close() can tell whether the name still refers to this object
+	struct stat info;
+	if(fstat(fd, &info) != 0){
+		std::cerr << "Failed to stat shared memory " << shmName << ": " << strerror(errno) << "\n";
+		::close(fd);
+		shm_unlink(shmName);
+		return false;
+	}
+
+	void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	::close(fd);
+	if(memory == MAP_FAILED){
+		std::cerr << "Failed to map shared memory " << shmName << ": " << strerror(errno) << "\n";
+		shm_unlink(shmName);
+		return false;
+	}
+
+	name = shmName;
+	mapping = memory;
+	mappingSize = size;
+	objectDevice = static_cast<uint64_t>(info.st_dev);
+	objectInode = static_cast<uint64_t>(info.st_ino);
+	header = static_cast<SharedFrameHeader*>(memory);
+	slots = reinterpret_cast<SharedFrameSlot*>(static_cast<char*>(memory) + sizeof(SharedFrameHeader));
+	nextSequence = 1;
+
+	// ftruncate zero fills, the atomics still get constructed properly
+	header->version = SharedFrames::layoutVersion;
+	header->slotCount = static_cast<uint32_t>(slotCount);
+	header->maxBuckets = SharedFrames::maxBuckets;
+	header->sampleRate = static_cast<uint32_t>(sampleRate);
+	new (&header->latestSequence) std::atomic<uint64_t>(0);
+	for(int i = 0; i < slotCount; i++){
+		new (&slots[i].seqlock) std::atomic<uint32_t>(0);
+	}
+	// Magic is written last so readers never accept a half initialized header
+	std::atomic_thread_fence(std::memory_order_release);
+	header->magic = SharedFrames::magic;
+
+	return true;
+#endif
+}
+
+void FramePublisher::close(){
+#ifndef _WIN32
+	if(mapping){
+		munmap(mapping, mappingSize);
+		// A second instance started with --force may own the name by now, never unlink its ring
+		int fd = shm_open(name.c_str(), O_RDONLY, 0);
+		if(fd >= 0){
+			struct stat info;
+			bool ours = fstat(fd, &info) == 0 && static_cast<uint64_t>(info.st_dev) == objectDevice
+						&& static_cast<uint64_t>(info.st_ino) == objectInode;
+			::close(fd);
+			if(ours){
+				shm_unlink(name.c_str());
+			}
+		}
+	}
+#endif
+	mapping = nullptr;
+	mappingSize = 0;
+	objectDevice = 0;
+	objectInode = 0;
+	header = nullptr;
+	slots = nullptr;
+}
+
+// Seqlock write: odd counter, fence, payload, even counter, then advertise the sequence number
+void FramePublisher::publish(const std::vector<float>& buckets, float rms, float peak){
+	if(!mapping){
+		return;
+	}
+
+	uint64_t sequence = nextSequence++;
+	SharedFrameSlot& slot = slots[sequence % header->slotCount];
+
+	uint32_t lock = slot.seqlock.load(std::memory_order_relaxed);
+	slot.seqlock.store(lock + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	int count = std::min(static_cast<int>(buckets.size()), SharedFrames::maxBuckets);
+	slot.bucketCount = static_cast<uint32_t>(count);
+	slot.sequence = sequence;
+	slot.timestampNs = FrameReader::monotonicNowNs();
+	slot.rms = rms;
+	slot.peak = peak;
+	std::copy(buckets.begin(), buckets.begin() + count, slot.buckets);
+
+	slot.seqlock.store(lock + 2, std::memory_order_release);
+	header->latestSequence.store(sequence, std::memory_order_release);
+}
@@ -0,0 +1,222 @@
+#include "FrameReader.h"
+#include <iostream>
+#include <algorithm>
+#include <limits>
+#include <chrono>
+#include <thread>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#endif
+
+namespace {
+	constexpr int readAttempts = 4;		// Retries when a slot is rewritten during a copy
+}
+
+// Constructor
+FrameReader::FrameReader() : mapping(nullptr), mappingSize(0), header(nullptr), slots(nullptr), lastSequence(0), droppedFrames(0){
+	latency = {0, std::numeric_limits<int64_t>::max(), 0, 0.0};
+}
+
+FrameReader::~FrameReader(){
+	close();
+}
+
+int64_t FrameReader::monotonicNowNs(){
+#ifdef _WIN32
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#else
+	timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return static_cast<int64_t>(now.tv_sec) * 1000000000LL + now.tv_nsec;
+#endif
+}
+
+bool FrameReader::open(const char* shmName){
+#ifdef _WIN32
+	(void)shmName;
+	std::cerr << "Shared memory frame reading is not supported on Windows\n";
+	return false;
+#else
+	close();
+	int fd = shm_open(shmName, O_RDONLY, 0);
+	if(fd < 0){
+		std::cerr << "Shared memory " << shmName << " does not exist, is the visualizer publishing?\n";
+		return false;
+	}
+
+	struct stat info;
+	if(fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(SharedFrameHeader)){
+		std::cerr << "Shared memory " << shmName << " is too small\n";
+		::close(fd);
+		return false;
+	}
+
+	size_t size = static_cast<size_t>(info.st_size);
+	void* memory = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd);
+	if(memory == MAP_FAILED){
+		std::cerr << "Failed to map shared memory " << shmName << "\n";
+		return false;
+	}
+
+	// Validate the layout before trusting any offsets
+	const SharedFrameHeader* candidate = static_cast<const SharedFrameHeader*>(memory);
+	bool valid = candidate->magic == SharedFrames::magic
+		&& candidate->version == SharedFrames::layoutVersion
+		&& candidate->maxBuckets == SharedFrames::maxBuckets
+		&& size >= sizeof(SharedFrameHeader) + sizeof(SharedFrameSlot) * static_cast<size_t>(candidate->slotCount);
+	if(!valid){
+		std::cerr << "Shared memory " << shmName << " has an incompatible layout\n";
+		munmap(memory, size);
+		return false;
+	}
+	std::atomic_thread_fence(std::memory_order_acquire);
+
+	mapping = memory;
+	mappingSize = size;
+	header = candidate;
+	slots = reinterpret_cast<const SharedFrameSlot*>(static_cast<const char*>(memory) + sizeof(SharedFrameHeader));
+	lastSequence = 0;
+	return true;
+#endif
+}
+
+void FrameReader::close(){
+#ifndef _WIN32
+	if(mapping){
+		munmap(mapping, mappingSize);
+	}
+#endif
+	mapping = nullptr;
+	mappingSize = 0;
+	header = nullptr;
+	slots = nullptr;
+}
+
+void FrameReader::skipToLatest(){
+	if(header){
+		lastSequence = std::max(lastSequence, header->latestSequence.load(std::memory_order_acquire));
+	}
+}
+
+int FrameReader::getSampleRate() const{
+	return header ? static_cast<int>(header->sampleRate) : 0;
+}
+
+// Seqlock read: the copy is only valid if the counter was even and unchanged around it
+bool FrameReader::_readSlot(uint64_t sequence, AnalysisFrame& frame) const{
+	const SharedFrameSlot& slot = slots[sequence % header->slotCount];
+
+	uint32_t before = slot.seqlock.load(std::memory_order_acquire);
+	if(before & 1u){
+		return false;
+	}
+
+	frame.sequence = slot.sequence;
+	frame.timestampNs = slot.timestampNs;
+	frame.rms = slot.rms;
+	frame.peak = slot.peak;
+	frame.bucketCount = static_cast<int>(std::min<uint32_t>(slot.bucketCount, SharedFrames::maxBuckets));
+	std::copy(slot.buckets, slot.buckets + frame.bucketCount, frame.buckets.begin());
+
+	std::atomic_thread_fence(std::memory_order_acquire);
+	uint32_t after = slot.seqlock.load(std::memory_order_relaxed);
+	return before == after && frame.sequence == sequence;
+}
+
+void FrameReader::_recordLatency(const AnalysisFrame& frame){
+	int64_t elapsed = monotonicNowNs() - frame.timestampNs;
+	latency.frames++;
+	latency.minNs = std::min(latency.minNs, elapsed);
+	latency.maxNs = std::max(latency.maxNs, elapsed);
+	latency.meanNs += (static_cast<double>(elapsed) - latency.meanNs) / static_cast<double>(latency.frames);
+}
+
+bool FrameReader::readLatest(AnalysisFrame& frame){
+	if(!mapping){
+		return false;
+	}
+
+	for(int attempt = 0; attempt < readAttempts; attempt++){
+		uint64_t latest = header->latestSequence.load(std::memory_order_acquire);
+		if(latest == 0 || latest <= lastSequence){
+			return false;
+		}
+		if(_readSlot(latest, frame)){
+			lastSequence = latest;
+			_recordLatency(frame);
+			return true;
+		}
+	}
+	return false;
+}
+
+bool FrameReader::readNext(AnalysisFrame& frame){
+	if(!mapping){
+		return false;
+	}
+
+	for(int attempt = 0; attempt < readAttempts; attempt++){
+		uint64_t latest = header->latestSequence.load(std::memory_order_acquire);
+		if(latest <= lastSequence){
+			return false;
+		}
+
+		// Skip frames the publisher already overwrote
+		uint64_t wanted = lastSequence + 1;
+		uint64_t oldest = (latest > header->slotCount) ? latest - header->slotCount + 1 : 1;
+		if(wanted < oldest){
+			droppedFrames += oldest - wanted;
+			lastSequence = oldest - 1;
+			wanted = oldest;
+		}
+
+		if(_readSlot(wanted, frame)){
+			lastSequence = wanted;
+			_recordLatency(frame);
+			return true;
+		}
+	}
+	return false;
+}
+
+bool FrameReader::monitorLatency(const char* shmName){
+	using Clock = std::chrono::steady_clock;
+	FrameReader reader;
+	if(!reader.open(shmName)){
+		return false;
+	}
+	std::cout << "Reading analysis frames from " << shmName << " (" << reader.getSampleRate() << " Hz audio)\n";
+	// Frames already in the ring were published before this reader started, they would only add their age
+	reader.skipToLatest();
+	AnalysisFrame frame;
+	Clock::time_point lastFrame = Clock::now();
+	Clock::time_point nextReport = lastFrame + std::chrono::seconds(1);
+	auto report = [&]() {
+		const FrameLatencyStats& stats = reader.getLatencyStats();
+		if(stats.frames == 0){
+			std::cout << "No frames yet\n";
+			return;
+		}
+		std::cout << stats.frames << " frames, " << reader.getDroppedFrames() << " dropped, latency min "
+				  << stats.minNs / 1000.0 << " us, mean " << stats.meanNs / 1000.0 << " us, max " << stats.maxNs / 1000.0 << " us\n";
+	};
+	while(Clock::now() - lastFrame < std::chrono::seconds(2)){
+		while(reader.readNext(frame)){
+			lastFrame = Clock::now();
+		}
+		if(Clock::now() >= nextReport){
+			report();
+			nextReport += std::chrono::seconds(1);
+		}
+		std::this_thread::yield();
+	}
+	std::cout << "No frame for 2 s, stopping. ";
+	report();
+	return true;
+}
@@ -0,0 +1,391 @@
+#define _USE_MATH_DEFINES
+#include "LoudnessMeter.h"
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <iostream>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define LOUDNESS_METER_SSE2 1
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define LOUDNESS_METER_NEON 1
+#endif
+
+namespace {
+	constexpr float negativeInfinity = -std::numeric_limits<float>::infinity();
+
+	// BS.1770 loudness of a weighted mean square energy
+	float energyToLufs(double energy){
+		if(energy <= 0.0){
+			return negativeInfinity;
+		}
+		return static_cast<float>(-0.691 + 10.0 * std::log10(energy));
+	}
+}
+
+// Constructor
+LoudnessMeter::LoudnessMeter(int sampleRate, int channels) : sampleRate(sampleRate), channels(channels), peakHistoryPos(0){
+	if(channels < 1 || channels > maxChannels){
+		std::cerr << "LoudnessMeter supports 1 to " << maxChannels << " channels, got " << channels << "\n";
+		this->channels = std::min(std::max(channels, 1), maxChannels);
+	}
+
+	// Channel weights from BS.1770 (surround channels +1.5 dB, LFE excluded)
+	for(int c = 0; c < maxChannels; c++){
+		channelWeights[c] = 1.0;
+	}
+	if(this->channels == 5){
+		channelWeights[3] = 1.41;
+		channelWeights[4] = 1.41;
+	}
+	else if(this->channels == 6){
+		channelWeights[3] = 0.0;
+		channelWeights[4] = 1.41;
+		channelWeights[5] = 1.41;
+	}
+
+	filterChannels = (this->channels + 1) & ~1;
+	subBlockSize = std::max(1, sampleRate / 10);
+	histogramEnergy.resize(histogramBins);
+	histogramCount.resize(histogramBins);
+	rangeEnergy.resize(histogramBins);
+	rangeCount.resize(histogramBins);
+	peakHistory.resize(this->channels * 2 * tapsPerPhase);
+
+	_computeFilterCoefficients();
+	_computePolyphaseTaps();
+	reset();
+}
+
+void LoudnessMeter::reset(){
+	for(int c = 0; c < maxChannels; c++){
+		shelfState[0][c] = shelfState[1][c] = 0.0;
+		highPassState[0][c] = highPassState[1][c] = 0.0;
+		subBlockEnergy[c] = 0.0;
+		carry[c] = 0.0f;
+	}
+	carryCount = 0;
+	subBlockFill = 0;
+	historyIndex = 0;
+	historyCount = 0;
+	std::fill(histogramEnergy.begin(), histogramEnergy.end(), 0.0);
+	std::fill(histogramCount.begin(), histogramCount.end(), 0);
+	std::fill(rangeEnergy.begin(), rangeEnergy.end(), 0.0);
+	std::fill(rangeCount.begin(), rangeCount.end(), 0);
+	std::fill(peakHistory.begin(), peakHistory.end(), 0.0f);
+	peakHistoryPos = 0;
+	truePeakLinear = 0.0f;
+
+	momentaryLufs.store(negativeInfinity, std::memory_order_relaxed);
+	shortTermLufs.store(negativeInfinity, std::memory_order_relaxed);
+	integratedLufs.store(negativeInfinity, std::memory_order_relaxed);
+	loudnessRange.store(0.0f, std::memory_order_relaxed);
+	truePeakDb.store(negativeInfinity, std::memory_order_relaxed);
+}
+
+// K-weighting coefficients derived for any sample rate from the analog prototypes behind the 48 kHz table in BS.1770
+void LoudnessMeter::_computeFilterCoefficients(){
+	// Stage 1, high shelf modelling the acoustic effect of the head
+	double f0 = 1681.974450955533;
+	double gainDb = 3.999843853973347;
+	double q = 0.7071752369554196;
+	double k = std::tan(M_PI * f0 / sampleRate);
+	double vh = std::pow(10.0, gainDb / 20.0);
+	double vb = std::pow(vh, 0.4996667741545416);
+	double a0 = 1.0 + k / q + k * k;
+	shelfB[0] = (vh + vb * k / q + k * k) / a0;
+	shelfB[1] = 2.0 * (k * k - vh) / a0;
+	shelfB[2] = (vh - vb * k / q + k * k) / a0;
+	shelfA[0] = 2.0 * (k * k - 1.0) / a0;
+	shelfA[1] = (1.0 - k / q + k * k) / a0;
+
+	// Stage 2, RLB high pass
+	f0 = 38.13547087602444;
+	q = 0.5003270373238773;
+	k = std::tan(M_PI * f0 / sampleRate);
+	a0 = 1.0 + k / q + k * k;
+	highPassB[0] = 1.0;
+	highPassB[1] = -2.0;
+	highPassB[2] = 1.0;
+	highPassA[0] = 2.0 * (k * k - 1.0) / a0;
+	highPassA[1] = (1.0 - k / q + k * k) / a0;
+}
+
+// 48 tap Blackman windowed sinc with cutoff at the original Nyquist, split into 4 phases of 12 taps.
+// Taps are stored reversed so each phase is a plain dot product with the contiguous history window,
+// and phase innermost so one history sample multiplies all four phases at once.
+void LoudnessMeter::_computePolyphaseTaps(){
+	const int totalTaps = oversampleFactor * tapsPerPhase;
+	const double center = (totalTaps - 1) / 2.0;
+
+	for(int phase = 0; phase < oversampleFactor; phase++){
+		double sum = 0.0;
+		double taps[tapsPerPhase];
+		for(int k = 0; k < tapsPerPhase; k++){
+			int n = phase + oversampleFactor * k;
+			double x = (n - center) / oversampleFactor;
+			double sinc = (x == 0.0) ? 1.0 : std::sin(M_PI * x) / (M_PI * x);
+			double window = 0.42 - 0.5 * std::cos(2.0 * M_PI * n / (totalTaps - 1)) + 0.08 * std::cos(4.0 * M_PI * n / (totalTaps - 1));
+			taps[k] = sinc * window;
+			sum += taps[k];
+		}
+		// Normalize each phase to unity DC gain
+		for(int k = 0; k < tapsPerPhase; k++){
+			polyphaseTaps[tapsPerPhase - 1 - k][phase] = static_cast<float>(taps[k] / sum);
+		}
+	}
+}
+
+void LoudnessMeter::processSamples(const float* samples, int sampleCount){
+	int index = 0;
+
+	// Complete a frame left over from the previous call
+	if(carryCount > 0){
+		while(carryCount < channels && index < sampleCount){
+			carry[carryCount++] = samples[index++];
+		}
+		if(carryCount < channels){
+			return;
+		}
+		_processFrame(carry);
+		carryCount = 0;
+	}
+
+	// Whole frames straight from the caller's memory
+	while(index + channels <= sampleCount){
+		_processFrame(samples + index);
+		index += channels;
+	}
+
+	// Keep the tail for the next call
+	while(index < sampleCount){
+		carry[carryCount++] = samples[index++];
+	}
+}
+
+// Every stage runs over all channels before the next one, the biquads two channels per instruction
+void LoudnessMeter::_processFrame(const float* frame){
+	const int historyStride = 2 * tapsPerPhase;
+	double x[maxChannels] = {};
+	double z[maxChannels];
+	for(int c = 0; c < channels; c++){
+		x[c] = frame[c];
+	}
+
+	// Stage 1 high shelf, then stage 2 high pass, transposed direct form II
+	int c = 0;
+#if defined(LOUDNESS_METER_SSE2)
+	for(; c < filterChannels; c += 2){
+		const __m128d in = _mm_loadu_pd(x + c);
+		const __m128d y = _mm_add_pd(_mm_mul_pd(_mm_set1_pd(shelfB[0]), in), _mm_loadu_pd(shelfState[0] + c));
+		_mm_storeu_pd(shelfState[0] + c, _mm_add_pd(_mm_sub_pd(_mm_mul_pd(_mm_set1_pd(shelfB[1]), in), _mm_mul_pd(_mm_set1_pd(shelfA[0]), y)), _mm_loadu_pd(shelfState[1] + c)));
+		_mm_storeu_pd(shelfState[1] + c, _mm_sub_pd(_mm_mul_pd(_mm_set1_pd(shelfB[2]), in), _mm_mul_pd(_mm_set1_pd(shelfA[1]), y)));
+
+		const __m128d out = _mm_add_pd(_mm_mul_pd(_mm_set1_pd(highPassB[0]), y), _mm_loadu_pd(highPassState[0] + c));
+		_mm_storeu_pd(highPassState[0] + c, _mm_add_pd(_mm_sub_pd(_mm_mul_pd(_mm_set1_pd(highPassB[1]), y), _mm_mul_pd(_mm_set1_pd(highPassA[0]), out)), _mm_loadu_pd(highPassState[1] + c)));
+		_mm_storeu_pd(highPassState[1] + c, _mm_sub_pd(_mm_mul_pd(_mm_set1_pd(highPassB[2]), y), _mm_mul_pd(_mm_set1_pd(highPassA[1]), out)));
+		_mm_storeu_pd(z + c, out);
+	}
+#elif defined(LOUDNESS_METER_NEON)
+	for(; c < filterChannels; c += 2){
+		const float64x2_t in = vld1q_f64(x + c);
+		const float64x2_t y = vaddq_f64(vmulq_n_f64(in, shelfB[0]), vld1q_f64(shelfState[0] + c));
+		vst1q_f64(shelfState[0] + c, vaddq_f64(vsubq_f64(vmulq_n_f64(in, shelfB[1]), vmulq_n_f64(y, shelfA[0])), vld1q_f64(shelfState[1] + c)));
+		vst1q_f64(shelfState[1] + c, vsubq_f64(vmulq_n_f64(in, shelfB[2]), vmulq_n_f64(y, shelfA[1])));
+
+		const float64x2_t out = vaddq_f64(vmulq_n_f64(y, highPassB[0]), vld1q_f64(highPassState[0] + c));
+		vst1q_f64(highPassState[0] + c, vaddq_f64(vsubq_f64(vmulq_n_f64(y, highPassB[1]), vmulq_n_f64(out, highPassA[0])), vld1q_f64(highPassState[1] + c)));
+		vst1q_f64(highPassState[1] + c, vsubq_f64(vmulq_n_f64(y, highPassB[2]), vmulq_n_f64(out, highPassA[1])));
+		vst1q_f64(z + c, out);
+	}
+#endif
+	for(; c < channels; c++){
+		double y = shelfB[0] * x[c] + shelfState[0][c];
+		shelfState[0][c] = shelfB[1] * x[c] - shelfA[0] * y + shelfState[1][c];
+		shelfState[1][c] = shelfB[2] * x[c] - shelfA[1] * y;
+
+		z[c] = highPassB[0] * y + highPassState[0][c];
+		highPassState[0][c] = highPassB[1] * y - highPassA[0] * z[c] + highPassState[1][c];
+		highPassState[1][c] = highPassB[2] * y - highPassA[1] * z[c];
+	}
+
+	for(c = 0; c < channels; c++){
+		subBlockEnergy[c] += z[c] * z[c];
+	}
+
+	// True peak: push into the doubled history, then all four phases accumulate over the contiguous window together
+	float framePeak = 0.0f;
+#if defined(LOUDNESS_METER_SSE2)
+	const __m128 signMask = _mm_set1_ps(-0.0f);
+	__m128 peaks = _mm_setzero_ps();
+#elif defined(LOUDNESS_METER_NEON)
+	float32x4_t peaks = vdupq_n_f32(0.0f);
+#endif
+	for(c = 0; c < channels; c++){
+		float* history = peakHistory.data() + c * historyStride;
+		history[peakHistoryPos] = frame[c];
+		history[peakHistoryPos + tapsPerPhase] = frame[c];
+		const float* window = history + peakHistoryPos + 1;
+#if defined(LOUDNESS_METER_SSE2)
+		// Two accumulators halve the chain of dependent adds
+		__m128 even = _mm_setzero_ps();
+		__m128 odd = _mm_setzero_ps();
+		for(int k = 0; k < tapsPerPhase; k += 2){
+			even = _mm_add_ps(even, _mm_mul_ps(_mm_loadu_ps(polyphaseTaps[k]), _mm_set1_ps(window[k])));
+			odd = _mm_add_ps(odd, _mm_mul_ps(_mm_loadu_ps(polyphaseTaps[k + 1]), _mm_set1_ps(window[k + 1])));
+		}
+		peaks = _mm_max_ps(peaks, _mm_andnot_ps(signMask, _mm_add_ps(even, odd)));
+#elif defined(LOUDNESS_METER_NEON)
+		float32x4_t even = vdupq_n_f32(0.0f);
+		float32x4_t odd = vdupq_n_f32(0.0f);
+		for(int k = 0; k < tapsPerPhase; k += 2){
+			even = vmlaq_n_f32(even, vld1q_f32(polyphaseTaps[k]), window[k]);
+			odd = vmlaq_n_f32(odd, vld1q_f32(polyphaseTaps[k + 1]), window[k + 1]);
+		}
+		peaks = vmaxq_f32(peaks, vabsq_f32(vaddq_f32(even, odd)));
+#else
+		float acc[oversampleFactor] = {};
+		for(int k = 0; k < tapsPerPhase; k++){
+			for(int phase = 0; phase < oversampleFactor; phase++){
+				acc[phase] += polyphaseTaps[k][phase] * window[k];
+			}
+		}
+		for(int phase = 0; phase < oversampleFactor; phase++){
+			framePeak = std::max(framePeak, std::fabs(acc[phase]));
+		}
+#endif
+	}
+#if defined(LOUDNESS_METER_SSE2)
+	peaks = _mm_max_ps(peaks, _mm_shuffle_ps(peaks, peaks, _MM_SHUFFLE(1, 0, 3, 2)));
+	peaks = _mm_max_ps(peaks, _mm_shuffle_ps(peaks, peaks, _MM_SHUFFLE(2, 3, 0, 1)));
+	framePeak = _mm_cvtss_f32(peaks);
+#elif defined(LOUDNESS_METER_NEON)
+	framePeak = vmaxvq_f32(peaks);
+#endif
+
+	peakHistoryPos = (peakHistoryPos + 1) % tapsPerPhase;
+
+	if(framePeak > truePeakLinear){
+		truePeakLinear = framePeak;
+		truePeakDb.store(20.0f * std::log10(truePeakLinear), std::memory_order_relaxed);
+	}
+
+	if(++subBlockFill == subBlockSize){
+		_finishSubBlock();
+	}
+}
+
+void LoudnessMeter::_finishSubBlock(){
+	double weighted = 0.0;
+	for(int c = 0; c < channels; c++){
+		weighted += channelWeights[c] * subBlockEnergy[c];
+		subBlockEnergy[c] = 0.0;
+	}
+	subBlockHistory[historyIndex] = weighted / subBlockSize;
+	historyIndex = (historyIndex + 1) % shortTermSubBlocks;
+	historyCount = std::min(historyCount + 1, shortTermSubBlocks);
+	subBlockFill = 0;
+
+	if(historyCount < momentarySubBlocks){
+		return;
+	}
+
+	// Every sub-block completes a new 400 ms gating block (75% overlap)
+	double blockEnergy = _windowEnergy(momentarySubBlocks);
+	float blockLufs = energyToLufs(blockEnergy);
+	momentaryLufs.store(blockLufs, std::memory_order_relaxed);
+
+	if(historyCount == shortTermSubBlocks){
+		double shortTermEnergy = _windowEnergy(shortTermSubBlocks);
+		float shortTerm = energyToLufs(shortTermEnergy);
+		shortTermLufs.store(shortTerm, std::memory_order_relaxed);
+		if(shortTerm >= histogramMinLufs){
+			int bin = std::min(static_cast<int>((shortTerm - histogramMinLufs) / histogramStepLu), histogramBins - 1);
+			rangeEnergy[bin] += shortTermEnergy;
+			rangeCount[bin]++;
+			_updateRange();
+		}
+	}
+
+	// Absolute gate
+	if(blockLufs >= histogramMinLufs){
+		int bin = static_cast<int>((blockLufs - histogramMinLufs) / histogramStepLu);
+		bin = std::min(bin, histogramBins - 1);
+		histogramEnergy[bin] += blockEnergy;
+		histogramCount[bin]++;
+		_updateIntegrated();
+	}
+}
+
+double LoudnessMeter::_windowEnergy(int count) const{
+	double sum = 0.0;
+	for(int i = 1; i <= count; i++){
+		sum += subBlockHistory[(historyIndex - i + shortTermSubBlocks) % shortTermSubBlocks];
+	}
+	return sum / count;
+}
+
+// Relative gate: blocks quieter than 10 LU below the absolute-gated mean are discarded
+void LoudnessMeter::_updateIntegrated(){
+	double totalEnergy = 0.0;
+	uint64_t totalCount = 0;
+	for(int i = 0; i < histogramBins; i++){
+		totalEnergy += histogramEnergy[i];
+		totalCount += histogramCount[i];
+	}
+	if(totalCount == 0){
+		return;
+	}
+
+	float relativeGate = energyToLufs(totalEnergy / totalCount) - 10.0f;
+	int firstBin = std::max(0, static_cast<int>((relativeGate - histogramMinLufs) / histogramStepLu));
+
+	double gatedEnergy = 0.0;
+	uint64_t gatedCount = 0;
+	for(int i = firstBin; i < histogramBins; i++){
+		gatedEnergy += histogramEnergy[i];
+		gatedCount += histogramCount[i];
+	}
+	if(gatedCount > 0){
+		integratedLufs.store(energyToLufs(gatedEnergy / gatedCount), std::memory_order_relaxed);
+	}
+}
+
+// Loudness range: short-term values more than 20 LU below their absolute-gated mean are discarded
+void LoudnessMeter::_updateRange(){
+	double totalEnergy = 0.0;
+	uint64_t totalCount = 0;
+	for(int i = 0; i < histogramBins; i++){
+		totalEnergy += rangeEnergy[i];
+		totalCount += rangeCount[i];
+	}
+	if(totalCount == 0){
+		return;
+	}
+
+	float relativeGate = energyToLufs(totalEnergy / totalCount) - 20.0f;
+	int firstBin = std::max(0, static_cast<int>((relativeGate - histogramMinLufs) / histogramStepLu));
+	uint64_t gatedCount = 0;
+	for(int i = firstBin; i < histogramBins; i++){
+		gatedCount += rangeCount[i];
+	}
+	if(gatedCount == 0){
+		return;
+	}
+
+	// Bin of the 10th and 95th percentile, read at the bin centers
+	auto percentileBin = [&](double fraction){
+		uint64_t target = static_cast<uint64_t>(std::ceil(fraction * gatedCount));
+		uint64_t seen = 0;
+		for(int i = firstBin; i < histogramBins; i++){
+			seen += rangeCount[i];
+			if(seen >= std::max<uint64_t>(target, 1)){
+				return i;
+			}
+		}
+		return histogramBins - 1;
+	};
+	loudnessRange.store((percentileBin(0.95) - percentileBin(0.10)) * histogramStepLu, std::memory_order_relaxed);
+}
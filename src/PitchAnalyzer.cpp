@@ -0,0 +1,265 @@
+#include "PitchAnalyzer.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define PITCH_ANALYZER_SSE2 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define PITCH_ANALYZER_NEON 1
+#endif
+
+namespace {
+	constexpr double pi = 3.14159265358979323846;
+	constexpr float chromaLowFreq = 50.0f;		// Peaks below only add rumble to the chroma
+	constexpr float chromaHighFreq = 5000.0f;	// Above this the bins are mostly upper harmonics
+	constexpr float silenceFloor = 1.0e-8f;		// Mean square below which a window is unvoiced (-80 dBFS)
+
+	// Pitch class (C = 0) of the nearest equal tempered note
+	int pitchClassOf(float hz){
+		int midi = static_cast<int>(std::lround(12.0 * std::log2(hz / 440.0) + 69.0));
+		return ((midi % 12) + 12) % 12;
+	}
+
+	// Replaces every complex bin by its power (real part, imaginary 0), the input of the autocorrelation's inverse FFT
+	void powerSpectrum(fftwf_complex* bins, int count){
+		float* data = &bins[0][0];
+		int i = 0;
+#if defined(PITCH_ANALYZER_SSE2)
+		const __m128 zero = _mm_setzero_ps();
+		for(; i + 4 <= count; i += 4){
+			__m128 low = _mm_loadu_ps(data + 2 * i);		// re0 im0 re1 im1
+			__m128 high = _mm_loadu_ps(data + 2 * i + 4);	// re2 im2 re3 im3
+			low = _mm_mul_ps(low, low);
+			high = _mm_mul_ps(high, high);
+			__m128 power = _mm_add_ps(_mm_shuffle_ps(low, high, _MM_SHUFFLE(2, 0, 2, 0)),
+				_mm_shuffle_ps(low, high, _MM_SHUFFLE(3, 1, 3, 1)));
+			_mm_storeu_ps(data + 2 * i, _mm_unpacklo_ps(power, zero));
+			_mm_storeu_ps(data + 2 * i + 4, _mm_unpackhi_ps(power, zero));
+		}
+#elif defined(PITCH_ANALYZER_NEON)
+		const float32x4_t zero = vdupq_n_f32(0.0f);
+		for(; i + 4 <= count; i += 4){
+			float32x4x2_t bin = vld2q_f32(data + 2 * i);
+			float32x4x2_t power;
+			power.val[0] = vmlaq_f32(vmulq_f32(bin.val[0], bin.val[0]), bin.val[1], bin.val[1]);
+			power.val[1] = zero;
+			vst2q_f32(data + 2 * i, power);
+		}
+#endif
+		for(; i < count; i++){
+			bins[i][0] = bins[i][0] * bins[i][0] + bins[i][1] * bins[i][1];
+			bins[i][1] = 0.0f;
+		}
+	}
+}
+
+// Constructor
+PitchAnalyzer::PitchAnalyzer(int sampleRate, int channels, float minFreq, float maxFreq, float threshold, float chromaSeconds)
+	: sampleRate(sampleRate), channels(std::min(std::max(channels, 1), maxChannels)), threshold(threshold), chromaSeconds(chromaSeconds),
+	framesWritten(0), carryCount(0), framesAnalyzed(0), fftInput(nullptr), fftOutput(nullptr), forwardPlan(nullptr), inversePlan(nullptr),
+	frequency(0.0f), confidence(0.0f), pitchClass(-1){
+	// Two periods of the lowest note fit in the window, lags beyond half the window are too noisy after the taper
+	windowSize = 256;
+	while(windowSize < 2.0f * sampleRate / minFreq){
+		windowSize *= 2;
+	}
+	fftSize = 2 * windowSize;
+	maxLag = std::min(static_cast<int>(std::ceil(sampleRate / minFreq)), windowSize / 2);
+	minLag = std::min(std::max(2, static_cast<int>(std::floor(sampleRate / maxFreq))), maxLag - 1);
+	history.assign(4 * windowSize, 0.0f);
+
+	windowFunction.resize(windowSize);
+	for(int i = 0; i < windowSize; i++){
+		windowFunction[i] = static_cast<float>(0.5 - 0.5 * std::cos(2.0 * pi * i / (windowSize - 1)));
+	}
+	windowCorrelation.resize(maxLag + 2);
+	for(int lag = 0; lag < maxLag + 2; lag++){
+		double sum = 0.0;
+		for(int i = 0; i + lag < windowSize; i++){
+			sum += static_cast<double>(windowFunction[i]) * windowFunction[i + lag];
+		}
+		windowCorrelation[lag] = static_cast<float>(sum);
+	}
+	difference.resize(maxLag + 2);
+
+	const float binWidth = static_cast<float>(sampleRate) / fftSize;
+	chromaHighBin = std::min(static_cast<int>(chromaHighFreq / binWidth), fftSize / 2 - 1);
+	chroma.assign(pitchClasses, 0.0f);
+	frameChroma.assign(pitchClasses, 0.0f);
+	for(int c = 0; c < maxChannels; c++){
+		carry[c] = 0.0f;
+	}
+}
+
+// Destructor
+PitchAnalyzer::~PitchAnalyzer(){
+	if(forwardPlan){
+		fftwf_destroy_plan(forwardPlan);
+	}
+	if(inversePlan){
+		fftwf_destroy_plan(inversePlan);
+	}
+	if(fftInput){
+		fftwf_free(fftInput);
+	}
+	if(fftOutput){
+		fftwf_free(fftOutput);
+	}
+}
+
+bool PitchAnalyzer::initialize(){
+	if(forwardPlan){
+		return true;
+	}
+	fftInput = fftwf_alloc_real(fftSize);
+	fftOutput = fftwf_alloc_complex(fftSize / 2 + 1);
+	if(!fftInput || !fftOutput){
+		return false;
+	}
+	forwardPlan = fftwf_plan_dft_r2c_1d(fftSize, fftInput, fftOutput, FFTW_MEASURE);
+	inversePlan = fftwf_plan_dft_c2r_1d(fftSize, fftOutput, fftInput, FFTW_MEASURE);
+	return forwardPlan && inversePlan;
+}
+
+void PitchAnalyzer::processSamples(const float* samples, int sampleCount){
+	const uint64_t mask = history.size() - 1;
+	uint64_t written = framesWritten.load(std::memory_order_relaxed);
+	const float scale = 1.0f / channels;
+	for(int i = 0; i < sampleCount; i++){
+		carry[carryCount++] = samples[i];
+		if(carryCount == channels){
+			float sum = 0.0f;
+			for(int c = 0; c < channels; c++){
+				sum += carry[c];
+			}
+			history[written & mask] = sum * scale;
+			written++;
+			carryCount = 0;
+		}
+	}
+	framesWritten.store(written, std::memory_order_release);
+}
+
+bool PitchAnalyzer::_readWindow(uint64_t& written){
+	const uint64_t mask = history.size() - 1;
+	// The writer never waits, a copy it lapped is taken again from the newer end
+	for(int attempt = 0; attempt < 4; attempt++){
+		written = framesWritten.load(std::memory_order_acquire);
+		if(written < static_cast<uint64_t>(windowSize)){
+			return false;
+		}
+		uint64_t start = written - windowSize;
+		for(int i = 0; i < windowSize; i++){
+			fftInput[i] = history[(start + i) & mask] * windowFunction[i];
+		}
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if(framesWritten.load(std::memory_order_relaxed) - start <= history.size()){
+			std::fill(fftInput + windowSize, fftInput + fftSize, 0.0f);
+			return true;
+		}
+	}
+	return false;
+}
+
+bool PitchAnalyzer::update(){
+	uint64_t written = 0;
+	if(!forwardPlan || framesWritten.load(std::memory_order_acquire) == framesAnalyzed || !_readWindow(written)){
+		return false;
+	}
+	double elapsedSeconds = static_cast<double>(written - framesAnalyzed) / sampleRate;
+	framesAnalyzed = written;
+
+	fftwf_execute(forwardPlan);
+	powerSpectrum(fftOutput, fftSize / 2 + 1);
+	_updateChroma(elapsedSeconds);
+	// The inverse of the power spectrum is the autocorrelation (times fftSize), the padding keeps it from wrapping
+	fftwf_execute(inversePlan);
+	_estimatePitch();
+	return true;
+}
+
+void PitchAnalyzer::_estimatePitch(){
+	frequency = 0.0f;
+	confidence = 0.0f;
+	pitchClass = -1;
+	const float meanSquare = fftInput[0] / (fftSize * windowCorrelation[0]);
+	if(meanSquare < silenceFloor){
+		return;
+	}
+
+	// Difference from the normalized autocorrelation, with the window's own taper divided out.
+	// Not clamped at 0: the corrected autocorrelation can overshoot 1 around the period, and the dip has to keep its shape.
+	const float norm = windowCorrelation[0] / fftInput[0];
+	difference[0] = 1.0f;
+	float runningSum = 0.0f;
+	for(int lag = 1; lag < maxLag + 2; lag++){
+		float d = 1.0f - fftInput[lag] / windowCorrelation[lag] * norm;
+		runningSum += d;
+		difference[lag] = runningSum > 0.0f ? d * lag / runningSum : 1.0f;
+	}
+
+	// First dip below the threshold, followed down to its minimum, else the deepest dip
+	int best = -1;
+	for(int lag = minLag; lag <= maxLag; lag++){
+		if(difference[lag] < threshold){
+			while(lag + 1 <= maxLag && difference[lag + 1] < difference[lag]){
+				lag++;
+			}
+			best = lag;
+			break;
+		}
+	}
+	if(best < 0){
+		best = static_cast<int>(std::min_element(difference.begin() + minLag, difference.begin() + maxLag + 1) - difference.begin());
+	}
+	confidence = std::min(std::max(1.0f - difference[best], 0.0f), 1.0f);
+	if(difference[best] >= threshold){
+		return;
+	}
+
+	// Parabolic interpolation between the neighbouring lags
+	float left = difference[best - 1];
+	float center = difference[best];
+	float right = difference[best + 1];
+	float curvature = left - 2.0f * center + right;
+	float offset = curvature > 0.0f ? 0.5f * (left - right) / curvature : 0.0f;
+	frequency = sampleRate / (best + std::min(std::max(offset, -0.5f), 0.5f));
+	pitchClass = pitchClassOf(frequency);
+}
+
+void PitchAnalyzer::_updateChroma(double elapsedSeconds){
+	// Only spectral peaks count, at their interpolated frequency: low notes are closer together than the
+	// window's main lobe, so mapping every bin would smear them into their neighbours
+	std::fill(frameChroma.begin(), frameChroma.end(), 0.0f);
+	const float binWidth = static_cast<float>(sampleRate) / fftSize;
+	for(int k = 2; k <= chromaHighBin; k++){
+		float power = fftOutput[k][0];
+		if(power <= fftOutput[k - 1][0] || power < fftOutput[k + 1][0]){
+			continue;
+		}
+		// Parabola through the log powers, close to exact for the Hann window's main lobe
+		float left = std::log(fftOutput[k - 1][0] + 1.0e-20f);
+		float center = std::log(power + 1.0e-20f);
+		float right = std::log(fftOutput[k + 1][0] + 1.0e-20f);
+		float curvature = left - 2.0f * center + right;
+		float offset = curvature < 0.0f ? 0.5f * (left - right) / curvature : 0.0f;
+		float hz = (k + offset) * binWidth;
+		if(hz >= chromaLowFreq){
+			frameChroma[pitchClassOf(hz)] += std::sqrt(power);
+		}
+	}
+	float strongest = *std::max_element(frameChroma.begin(), frameChroma.end());
+	float scale = strongest > 1.0e-6f ? 1.0f / strongest : 0.0f;
+
+	float alpha = 1.0f - static_cast<float>(std::exp(-elapsedSeconds / std::max(chromaSeconds, 1.0e-4f)));
+	for(int c = 0; c < pitchClasses; c++){
+		chroma[c] += (frameChroma[c] * scale - chroma[c]) * alpha;
+	}
+}
+
+int PitchAnalyzer::getDominantChroma() const{
+	auto strongest = std::max_element(chroma.begin(), chroma.end());
+	return *strongest > 1.0e-3f ? static_cast<int>(strongest - chroma.begin()) : -1;
+}
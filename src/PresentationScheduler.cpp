@@ -0,0 +1,90 @@
+#include "PresentationScheduler.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+	constexpr double maxStepSeconds = 0.1;		// Longest smoothing step, a stalled window does not jump bars
+}
+
+// Constructor
+PresentationScheduler::PresentationScheduler(float attackSeconds, float releaseSeconds, float peakHoldSeconds, float peakFallRate)
+	: attackSeconds(attackSeconds), releaseSeconds(releaseSeconds), peakHoldSeconds(peakHoldSeconds), peakFallRate(peakFallRate),
+	frames(historyFrames), frameTimes(historyFrames, 0.0), newest(0), count(0), lastDisplayTime(-1.0){
+}
+
+void PresentationScheduler::reset(){
+	count = 0;
+	newest = 0;
+	lastDisplayTime = -1.0;
+	_resize(target.size());
+}
+
+void PresentationScheduler::_resize(size_t bars){
+	target.assign(bars, 0.0f);
+	heights.assign(bars, 0.0f);
+	peaks.assign(bars, 0.0f);
+	peakAges.assign(bars, 0.0f);
+}
+
+void PresentationScheduler::pushFrame(const std::vector<float>& buckets, double audioTime){
+	if(buckets.size() != target.size()){
+		count = 0;
+		_resize(buckets.size());
+	}
+	else if(count && audioTime <= frameTimes[newest]){
+		count = 0;
+	}
+
+	newest = (newest + 1) % historyFrames;
+	frames[newest] = buckets;
+	frameTimes[newest] = audioTime;
+	count = std::min(count + 1, historyFrames);
+}
+
+bool PresentationScheduler::present(double audioTime, double displayTime){
+	if(!count){
+		return false;
+	}
+
+	// Find the two frames around audioTime, walking back from the newest
+	int after = newest;
+	int before = newest;
+	for(int age = 1; age < count && frameTimes[before] > audioTime; age++){
+		after = before;
+		before = (newest - age + historyFrames) % historyFrames;
+	}
+
+	const std::vector<float>& a = frames[before];
+	const std::vector<float>& b = frames[after];
+	double span = frameTimes[after] - frameTimes[before];
+	float t = (span > 0.0) ? static_cast<float>(std::min(std::max((audioTime - frameTimes[before]) / span, 0.0), 1.0)) : 0.0f;
+	// Before the oldest frame there is nothing to interpolate from, hold it
+	if(frameTimes[before] > audioTime){
+		t = 0.0f;
+	}
+	for(size_t i = 0; i < target.size(); i++){
+		target[i] = a[i] + (b[i] - a[i]) * t;
+	}
+
+	// Exponential approach with the time constant of the direction the bar is moving in
+	float dt = (lastDisplayTime < 0.0) ? 0.0f : static_cast<float>(std::min(std::max(displayTime - lastDisplayTime, 0.0), maxStepSeconds));
+	lastDisplayTime = displayTime;
+	float attack = 1.0f - std::exp(-dt / std::max(attackSeconds, 1.0e-4f));
+	float release = 1.0f - std::exp(-dt / std::max(releaseSeconds, 1.0e-4f));
+	for(size_t i = 0; i < target.size(); i++){
+		float alpha = (target[i] > heights[i]) ? attack : release;
+		heights[i] += (target[i] - heights[i]) * alpha;
+
+		if(heights[i] >= peaks[i]){
+			peaks[i] = heights[i];
+			peakAges[i] = 0.0f;
+		}
+		else{
+			peakAges[i] += dt;
+			if(peakAges[i] > peakHoldSeconds){
+				peaks[i] = std::max(heights[i], peaks[i] - peakFallRate * dt);
+			}
+		}
+	}
+	return true;
+}
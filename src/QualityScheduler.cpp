@@ -0,0 +1,83 @@
+#include "QualityScheduler.h"
+#include <iostream>
+#include <algorithm>
+
+namespace {
+	constexpr int missWindowFrames = 30;		// Frames the deadline miss ratio is taken over
+	constexpr int missesToDegrade = 3;			// Misses in the window that force a step down
+	constexpr double cooldownSeconds = 1.0;		// Minimum time between level changes
+	constexpr double headroomSeconds = 3.0;		// Sustained headroom needed before stepping up
+	constexpr double headroomRatio = 0.4;		// Cost below this share of the budget counts as headroom
+	constexpr double costSmoothing = 0.1;		// EMA factor of the cost estimate
+}
+
+// Constructor
+QualityScheduler::QualityScheduler(double cpuBudget, int initialLevel)
+	: cpuBudget(cpuBudget), costEstimate(0.0), missIndex(0), missCount(0),
+	lastChangeTime(0.0), headroomSince(-1.0), framesTotal(0), framesMissed(0){
+	// fftSize, bars, analysis interval, frame interval
+	levels = {
+		{2048, 64, 1.0 / 60.0, 1.0 / 60.0},
+		{1024, 32, 1.0 / 60.0, 1.0 / 60.0},
+		{1024, 32, 1.0 / 30.0, 1.0 / 30.0},
+		{512, 16, 1.0 / 30.0, 1.0 / 30.0},
+		{512, 16, 1.0 / 20.0, 1.0 / 15.0},
+	};
+	currentLevel = std::min(std::max(initialLevel, 0), static_cast<int>(levels.size()) - 1);
+	missWindow.assign(missWindowFrames, false);
+}
+
+bool QualityScheduler::recordFrame(double workSeconds, double lateSeconds, double now){
+	framesTotal++;
+	costEstimate = (framesTotal == 1) ? workSeconds : costEstimate + costSmoothing * (workSeconds - costEstimate);
+
+	bool missed = lateSeconds > 0.0;
+	if(missed){
+		framesMissed++;
+	}
+	missCount += static_cast<int>(missed) - static_cast<int>(missWindow[missIndex]);
+	missWindow[missIndex] = missed;
+	missIndex = (missIndex + 1) % missWindowFrames;
+
+	if(now - lastChangeTime < cooldownSeconds){
+		return false;
+	}
+
+	const double budget = cpuBudget * levels[currentLevel].frameInterval;
+
+	// Over budget or missing deadlines: step down
+	if((costEstimate > budget || missCount >= missesToDegrade) && currentLevel + 1 < static_cast<int>(levels.size())){
+		_changeLevel(currentLevel + 1, now, missCount >= missesToDegrade ? "missed deadlines" : "over CPU budget");
+		return true;
+	}
+
+	// Sustained headroom: step up
+	if(costEstimate < headroomRatio * budget && missCount == 0){
+		if(headroomSince < 0.0){
+			headroomSince = now;
+		}
+		else if(now - headroomSince >= headroomSeconds && currentLevel > 0){
+			_changeLevel(currentLevel - 1, now, "headroom");
+			return true;
+		}
+	}
+	else{
+		headroomSince = -1.0;
+	}
+	return false;
+}
+
+void QualityScheduler::_changeLevel(int level, double now, const char* reason){
+	const QualityLevel& next = levels[level];
+	std::cout << "Quality " << (level > currentLevel ? "down" : "up") << " to level " << level
+			  << " (FFT " << next.fftSize << ", " << next.numBars << " bars, analysis "
+			  << 1.0 / next.analysisInterval << " Hz, render " << 1.0 / next.frameInterval << " Hz): "
+			  << reason << ", frame cost " << costEstimate * 1000.0 << " ms, "
+			  << missCount << "/" << missWindowFrames << " recent misses\n";
+
+	currentLevel = level;
+	lastChangeTime = now;
+	headroomSince = -1.0;
+	missCount = 0;
+	std::fill(missWindow.begin(), missWindow.end(), false);
+}
@@ -0,0 +1,468 @@
+#include "SampleStore.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <climits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SAMPLE_STORE_SSE2 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define SAMPLE_STORE_NEON 1
+#endif
+
+namespace {
+	constexpr float int16Scale = 1.0f / 32768.0f;
+	constexpr float int24Scale = 1.0f / 8388608.0f;
+
+	// Samples converted per step when a float source is compared against integer storage
+	constexpr size_t compareChunk = 1024;
+
+	// Rice codes with a quotient this large are escaped and written as raw bits
+	constexpr uint32_t riceEscape = 16;
+	constexpr int rawResidualBits = 20;
+
+	// Channel coding modes inside a compressed block
+	constexpr uint8_t modeVerbatim = 0;
+	constexpr uint8_t modeRice = 1;
+
+	void int16ToFloat(const int16_t* source, float* destination, size_t count){
+		size_t i = 0;
+#if defined(SAMPLE_STORE_SSE2)
+		const __m128 scale = _mm_set1_ps(int16Scale);
+		for(; i + 8 <= count; i += 8){
+			__m128i packed = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+			// Interleave with itself and shift back down to sign extend 16 to 32 bits
+			__m128i low = _mm_srai_epi32(_mm_unpacklo_epi16(packed, packed), 16);
+			__m128i high = _mm_srai_epi32(_mm_unpackhi_epi16(packed, packed), 16);
+			_mm_storeu_ps(destination + i, _mm_mul_ps(_mm_cvtepi32_ps(low), scale));
+			_mm_storeu_ps(destination + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(high), scale));
+		}
+#elif defined(SAMPLE_STORE_NEON)
+		for(; i + 8 <= count; i += 8){
+			int16x8_t packed = vld1q_s16(source + i);
+			vst1q_f32(destination + i, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(packed))), int16Scale));
+			vst1q_f32(destination + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(packed))), int16Scale));
+		}
+#endif
+		for(; i < count; i++){
+			destination[i] = source[i] * int16Scale;
+		}
+	}
+
+	// Round to nearest and saturate, exact for samples that came from 16 bit PCM
+	void floatToInt16(const float* source, int16_t* destination, size_t count){
+		size_t i = 0;
+#if defined(SAMPLE_STORE_SSE2)
+		const __m128 scale = _mm_set1_ps(32768.0f);
+		for(; i + 8 <= count; i += 8){
+			__m128i low = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(source + i), scale));
+			__m128i high = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(source + i + 4), scale));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i), _mm_packs_epi32(low, high));
+		}
+#elif defined(SAMPLE_STORE_NEON) && defined(__aarch64__)
+		for(; i + 8 <= count; i += 8){
+			int32x4_t low = vcvtnq_s32_f32(vmulq_n_f32(vld1q_f32(source + i), 32768.0f));
+			int32x4_t high = vcvtnq_s32_f32(vmulq_n_f32(vld1q_f32(source + i + 4), 32768.0f));
+			vst1q_s16(destination + i, vcombine_s16(vqmovn_s32(low), vqmovn_s32(high)));
+		}
+#endif
+		for(; i < count; i++){
+			float scaled = std::min(std::max(source[i] * 32768.0f, -32768.0f), 32767.0f);
+			destination[i] = static_cast<int16_t>(std::lrint(scaled));
+		}
+	}
+
+	int32_t floatToInt24(float sample){
+		float scaled = std::min(std::max(sample * 8388608.0f, -8388608.0f), 8388607.0f);
+		return static_cast<int32_t>(std::lrint(scaled));
+	}
+
+	int32_t unpackInt24(const uint8_t* bytes){
+		return static_cast<int32_t>(bytes[0] | (bytes[1] << 8) | (static_cast<uint32_t>(static_cast<int8_t>(bytes[2])) << 16));
+	}
+
+	class BitWriter{
+		private:
+			std::vector<uint8_t>& output;
+			uint64_t accumulator = 0;
+			int bits = 0;
+
+		public:
+			explicit BitWriter(std::vector<uint8_t>& output) : output(output) {}
+
+			void write(uint32_t value, int count){
+				accumulator = (accumulator << count) | (value & ((1ull << count) - 1));
+				bits += count;
+				while(bits >= 8){
+					bits -= 8;
+					output.push_back(static_cast<uint8_t>(accumulator >> bits));
+				}
+			}
+
+			// Pads to a byte boundary so the next channel starts on a fresh byte
+			void flush(){
+				if(bits > 0){
+					write(0, 8 - bits);
+				}
+			}
+	};
+
+	class BitReader{
+		private:
+			const uint8_t* data;
+			size_t size;
+			size_t position = 0;
+			uint64_t accumulator = 0;
+			int bits = 0;
+
+			void _refill(){
+				while(bits <= 56){
+					uint8_t next = position < size ? data[position] : 0;
+					position++;
+					accumulator |= static_cast<uint64_t>(next) << (56 - bits);
+					bits += 8;
+				}
+			}
+
+		public:
+			BitReader(const uint8_t* data, size_t size) : data(data), size(size) {}
+
+			uint32_t read(int count){
+				if(count == 0){
+					return 0;
+				}
+				if(bits < count){
+					_refill();
+				}
+				uint32_t value = static_cast<uint32_t>(accumulator >> (64 - count));
+				accumulator <<= count;
+				bits -= count;
+				return value;
+			}
+
+			// Counts leading one bits and consumes them plus the terminating zero, at most limit ones (no zero then)
+			uint32_t readUnary(uint32_t limit){
+				if(bits < static_cast<int>(limit) + 1){
+					_refill();
+				}
+				uint64_t inverted = ~accumulator;
+#if defined(__GNUC__)
+				uint32_t ones = inverted ? static_cast<uint32_t>(__builtin_clzll(inverted)) : 64;
+#else
+				uint32_t ones = 0;
+				while(ones < 64 && !(inverted & (1ull << (63 - ones)))){
+					ones++;
+				}
+#endif
+				if(ones >= limit){
+					read(static_cast<int>(limit));
+					return limit;
+				}
+				read(static_cast<int>(ones) + 1);
+				return ones;
+			}
+
+			// Skips the padding written by BitWriter::flush, returns the byte offset of the next channel
+			size_t alignedPosition() const{
+				return position - bits / 8;
+			}
+	};
+}
+
+std::unique_ptr<SampleStore> SampleStore::create(SampleFormat format, int channels){
+	switch(format){
+		case SampleFormat::Int16: return std::make_unique<Int16SampleStore>();
+		case SampleFormat::Int24: return std::make_unique<Int24SampleStore>();
+		case SampleFormat::Compressed: return std::make_unique<CompressedSampleStore>(channels);
+		default: return std::make_unique<FloatSampleStore>();
+	}
+}
+
+// Float
+
+void FloatSampleStore::resize(size_t sampleCount){
+	samples.assign(sampleCount, 0.0f);
+}
+
+void FloatSampleStore::write(size_t offset, const float* source, size_t count){
+	std::memcpy(samples.data() + offset, source, count * sizeof(float));
+}
+
+void FloatSampleStore::read(size_t offset, float* destination, size_t count) const{
+	std::memcpy(destination, samples.data() + offset, count * sizeof(float));
+}
+
+bool FloatSampleStore::matches(size_t offset, const float* source, size_t count) const{
+	return std::memcmp(samples.data() + offset, source, count * sizeof(float)) == 0;
+}
+
+// Int16
+
+void Int16SampleStore::resize(size_t sampleCount){
+	samples.assign(sampleCount, 0);
+}
+
+void Int16SampleStore::write(size_t offset, const float* source, size_t count){
+	floatToInt16(source, samples.data() + offset, count);
+}
+
+void Int16SampleStore::read(size_t offset, float* destination, size_t count) const{
+	int16ToFloat(samples.data() + offset, destination, count);
+}
+
+bool Int16SampleStore::matches(size_t offset, const float* source, size_t count) const{
+	int16_t converted[compareChunk];
+	for(size_t done = 0; done < count; done += compareChunk){
+		size_t chunk = std::min(compareChunk, count - done);
+		floatToInt16(source + done, converted, chunk);
+		if(std::memcmp(converted, samples.data() + offset + done, chunk * sizeof(int16_t)) != 0){
+			return false;
+		}
+	}
+	return true;
+}
+
+// Int24
+
+void Int24SampleStore::resize(size_t sampleCount){
+	bytes.assign(sampleCount * 3, 0);
+}
+
+void Int24SampleStore::write(size_t offset, const float* source, size_t count){
+	uint8_t* destination = bytes.data() + offset * 3;
+	for(size_t i = 0; i < count; i++){
+		int32_t value = floatToInt24(source[i]);
+		destination[3 * i] = static_cast<uint8_t>(value);
+		destination[3 * i + 1] = static_cast<uint8_t>(value >> 8);
+		destination[3 * i + 2] = static_cast<uint8_t>(value >> 16);
+	}
+}
+
+void Int24SampleStore::read(size_t offset, float* destination, size_t count) const{
+	const uint8_t* source = bytes.data() + offset * 3;
+	for(size_t i = 0; i < count; i++){
+		destination[i] = static_cast<float>(unpackInt24(source + 3 * i)) * int24Scale;
+	}
+}
+
+bool Int24SampleStore::matches(size_t offset, const float* source, size_t count) const{
+	const uint8_t* stored = bytes.data() + offset * 3;
+	for(size_t i = 0; i < count; i++){
+		if(unpackInt24(stored + 3 * i) != floatToInt24(source[i])){
+			return false;
+		}
+	}
+	return true;
+}
+
+// Compressed
+
+CompressedSampleStore::CompressedSampleStore(int channels)
+	: channels(std::max(channels, 1)), sampleCount(0), cachedBlock(SIZE_MAX){
+}
+
+void CompressedSampleStore::resize(size_t sampleCount){
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	this->sampleCount = sampleCount;
+	size_t blockSamples = blockFrames * channels;
+	blocks.assign((sampleCount + blockSamples - 1) / blockSamples, std::vector<uint8_t>());
+	cache.assign(blockSamples, 0);
+	cachedBlock = SIZE_MAX;
+}
+
+size_t CompressedSampleStore::_blockSamples(size_t block) const{
+	size_t blockSamples = blockFrames * channels;
+	return std::min(blockSamples, sampleCount - block * blockSamples);
+}
+
+size_t CompressedSampleStore::getMemoryBytes() const{
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	size_t total = 0;
+	for(const std::vector<uint8_t>& block : blocks){
+		total += block.capacity();
+	}
+	return total + cache.capacity() * sizeof(int16_t);
+}
+
+// Per channel: a mode byte, then either raw samples or a Rice parameter byte and the order 2 residuals
+void CompressedSampleStore::_encodeBlock(size_t block, const int16_t* samples, size_t count){
+	size_t frames = count / channels;
+	std::vector<uint8_t> encoded;
+	std::vector<uint32_t> residuals(frames);
+
+	for(int channel = 0; channel < channels; channel++){
+		// Zigzag coded residuals of the fixed predictor 2x[n-1] - x[n-2], lower orders for the first samples
+		uint64_t sum = 0;
+		for(size_t n = 0; n < frames; n++){
+			int32_t x = samples[n * channels + channel];
+			int32_t prediction = 0;
+			if(n >= 2){
+				prediction = 2 * samples[(n - 1) * channels + channel] - samples[(n - 2) * channels + channel];
+			}
+			else if(n == 1){
+				prediction = samples[channel];
+			}
+			int32_t residual = x - prediction;
+			residuals[n] = (static_cast<uint32_t>(residual) << 1) ^ static_cast<uint32_t>(residual >> 31);
+			sum += residuals[n];
+		}
+
+		// Rice parameter near log2 of the mean residual
+		int parameter = 0;
+		uint64_t mean = frames ? sum / frames : 0;
+		while(parameter < 18 && (1ull << (parameter + 1)) <= mean){
+			parameter++;
+		}
+
+		size_t channelStart = encoded.size();
+		encoded.push_back(modeRice);
+		encoded.push_back(static_cast<uint8_t>(parameter));
+		BitWriter writer(encoded);
+		for(size_t n = 0; n < frames; n++){
+			uint32_t quotient = residuals[n] >> parameter;
+			if(quotient < riceEscape){
+				writer.write((1u << quotient) - 1, static_cast<int>(quotient));
+				writer.write(0, 1);
+				writer.write(residuals[n], parameter);
+			}
+			else{
+				writer.write((1u << riceEscape) - 1, riceEscape);
+				writer.write(residuals[n], rawResidualBits);
+			}
+		}
+		writer.flush();
+
+		// Noise does not compress, store it as is
+		if(encoded.size() - channelStart > 1 + frames * sizeof(int16_t)){
+			encoded.resize(channelStart);
+			encoded.push_back(modeVerbatim);
+			for(size_t n = 0; n < frames; n++){
+				uint16_t value = static_cast<uint16_t>(samples[n * channels + channel]);
+				encoded.push_back(static_cast<uint8_t>(value));
+				encoded.push_back(static_cast<uint8_t>(value >> 8));
+			}
+		}
+	}
+	encoded.shrink_to_fit();
+
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	blocks[block].swap(encoded);
+	if(cachedBlock == block){
+		cachedBlock = SIZE_MAX;
+	}
+}
+
+void CompressedSampleStore::_decodeBlock(size_t block, int16_t* samples) const{
+	size_t count = _blockSamples(block);
+	const std::vector<uint8_t>& encoded = blocks[block];
+	if(encoded.empty()){
+		std::fill(samples, samples + count, 0);
+		return;
+	}
+
+	size_t frames = count / channels;
+	size_t position = 0;
+	for(int channel = 0; channel < channels; channel++){
+		uint8_t mode = encoded[position++];
+		if(mode == modeVerbatim){
+			for(size_t n = 0; n < frames; n++){
+				samples[n * channels + channel] = static_cast<int16_t>(encoded[position] | (encoded[position + 1] << 8));
+				position += 2;
+			}
+			continue;
+		}
+
+		int parameter = encoded[position++];
+		BitReader reader(encoded.data() + position, encoded.size() - position);
+		int32_t previous = 0;
+		int32_t beforePrevious = 0;
+		for(size_t n = 0; n < frames; n++){
+			uint32_t quotient = reader.readUnary(riceEscape);
+			uint32_t value = (quotient < riceEscape)
+				? (quotient << parameter) | reader.read(parameter)
+				: reader.read(rawResidualBits);
+			int32_t residual = static_cast<int32_t>(value >> 1) ^ -static_cast<int32_t>(value & 1);
+
+			int32_t prediction = (n >= 2) ? 2 * previous - beforePrevious : (n == 1 ? previous : 0);
+			int32_t x = prediction + residual;
+			samples[n * channels + channel] = static_cast<int16_t>(x);
+			beforePrevious = previous;
+			previous = x;
+		}
+		position += reader.alignedPosition();
+	}
+}
+
+void CompressedSampleStore::_loadBlock(size_t block) const{
+	if(cachedBlock != block){
+		_decodeBlock(block, cache.data());
+		cachedBlock = block;
+	}
+}
+
+void CompressedSampleStore::write(size_t offset, const float* source, size_t count){
+	size_t blockSamples = blockFrames * channels;
+	std::vector<int16_t> samples(blockSamples);
+
+	while(count > 0){
+		size_t block = offset / blockSamples;
+		size_t start = offset - block * blockSamples;
+		size_t length = _blockSamples(block);
+		size_t chunk = std::min(count, length - start);
+
+		// A write that does not cover the whole block keeps the rest of it
+		if(start > 0 || chunk < length){
+			std::lock_guard<std::mutex> lock(cacheMutex);
+			_decodeBlock(block, samples.data());
+		}
+		floatToInt16(source, samples.data() + start, chunk);
+		_encodeBlock(block, samples.data(), length);
+
+		offset += chunk;
+		source += chunk;
+		count -= chunk;
+	}
+}
+
+void CompressedSampleStore::read(size_t offset, float* destination, size_t count) const{
+	size_t blockSamples = blockFrames * channels;
+	std::lock_guard<std::mutex> lock(cacheMutex);
+
+	while(count > 0){
+		size_t block = offset / blockSamples;
+		size_t start = offset - block * blockSamples;
+		size_t chunk = std::min(count, _blockSamples(block) - start);
+
+		_loadBlock(block);
+		int16ToFloat(cache.data() + start, destination, chunk);
+
+		offset += chunk;
+		destination += chunk;
+		count -= chunk;
+	}
+}
+
+bool CompressedSampleStore::matches(size_t offset, const float* source, size_t count) const{
+	size_t blockSamples = blockFrames * channels;
+	int16_t converted[compareChunk];
+	std::lock_guard<std::mutex> lock(cacheMutex);
+
+	while(count > 0){
+		size_t block = offset / blockSamples;
+		size_t start = offset - block * blockSamples;
+		size_t chunk = std::min({count, _blockSamples(block) - start, compareChunk});
+
+		_loadBlock(block);
+		floatToInt16(source, converted, chunk);
+		if(std::memcmp(converted, cache.data() + start, chunk * sizeof(int16_t)) != 0){
+			return false;
+		}
+
+		offset += chunk;
+		source += chunk;
+		count -= chunk;
+	}
+	return true;
+}
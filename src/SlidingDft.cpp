@@ -0,0 +1,165 @@
+#include "SlidingDft.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SLIDING_DFT_SSE2 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define SLIDING_DFT_NEON 1
+#endif
+
+namespace {
+	constexpr double pi = 3.14159265358979323846;
+}
+
+// Constructor
+SlidingDft::SlidingDft()
+	: size(0), firstBin(0), lastBin(0), stateFirst(0), stateCount(0), damping(1.0f), dampingN(1.0f), gain(1.0f){
+}
+
+void SlidingDft::configure(int windowSize, int first, int last){
+	size = windowSize;
+	lastBin = std::min(std::max(last, 0), size / 2);
+	firstBin = std::min(std::max(first, 0), lastBin);
+	// The window needs each output bin's neighbours, bins beyond 0 and N / 2 mirror tracked ones
+	stateFirst = std::max(firstBin - 1, 0);
+	const int stateLast = std::min(lastBin + 1, size / 2);
+	stateCount = (stateLast - stateFirst + 1 + 3) & ~3;
+
+	const double r = std::pow(static_cast<double>(dampingPerWindow), 1.0 / size);
+	damping = static_cast<float>(r);
+	dampingN = dampingPerWindow;
+	stateReal.assign(stateCount, 0.0f);
+	stateImag.assign(stateCount, 0.0f);
+	twiddleReal.assign(stateCount, 0.0f);
+	twiddleImag.assign(stateCount, 0.0f);
+	for(int i = 0; i <= stateLast - stateFirst; i++){
+		double angle = 2.0 * pi * (stateFirst + i) / size;
+		twiddleReal[i] = static_cast<float>(std::cos(angle));
+		twiddleImag[i] = static_cast<float>(std::sin(angle));
+	}
+
+	// Coherent gain of the Hann window with and without the taper
+	ramp.resize(size);
+	double plain = 0.0, tapered = 0.0;
+	for(int m = 0; m < size; m++){
+		ramp[m] = static_cast<float>(std::pow(r, size - 1 - m));
+		double hann = 0.5 - 0.5 * std::cos(2.0 * pi * m / size);
+		plain += hann;
+		tapered += hann * ramp[m];
+	}
+	gain = static_cast<float>(plain / tapered);
+}
+
+void SlidingDft::weightBlock(float* block) const{
+	for(int m = 0; m < size; m++){
+		block[m] *= ramp[m];
+	}
+}
+
+void SlidingDft::reset(const fftwf_complex* spectrum){
+	const int tracked = std::min(lastBin + 1, size / 2) - stateFirst + 1;
+	for(int i = 0; i < tracked; i++){
+		stateReal[i] = spectrum[stateFirst + i][0];
+		stateImag[i] = spectrum[stateFirst + i][1];
+	}
+}
+
+void SlidingDft::slide(const float* leaving, const float* entering, int count){
+	float* re = stateReal.data();
+	float* im = stateImag.data();
+	const float* wr = twiddleReal.data();
+	const float* wi = twiddleImag.data();
+	int n = 0;
+#if defined(SLIDING_DFT_SSE2) || defined(SLIDING_DFT_NEON)
+	// Four samples per pass over the bins, the state stays in registers between them
+	for(; n + 4 <= count; n += 4){
+		float delta[4];
+		for(int j = 0; j < 4; j++){
+			delta[j] = entering[n + j] - dampingN * leaving[n + j];
+		}
+#if defined(SLIDING_DFT_SSE2)
+		const __m128 r = _mm_set1_ps(damping);
+		for(int k = 0; k < stateCount; k += 4){
+			__m128 x = _mm_loadu_ps(re + k);
+			__m128 y = _mm_loadu_ps(im + k);
+			const __m128 c = _mm_loadu_ps(wr + k);
+			const __m128 s = _mm_loadu_ps(wi + k);
+			for(int j = 0; j < 4; j++){
+				__m128 a = _mm_add_ps(_mm_mul_ps(r, x), _mm_set1_ps(delta[j]));
+				__m128 b = _mm_mul_ps(r, y);
+				x = _mm_sub_ps(_mm_mul_ps(a, c), _mm_mul_ps(b, s));
+				y = _mm_add_ps(_mm_mul_ps(a, s), _mm_mul_ps(b, c));
+			}
+			_mm_storeu_ps(re + k, x);
+			_mm_storeu_ps(im + k, y);
+		}
+#else
+		for(int k = 0; k < stateCount; k += 4){
+			float32x4_t x = vld1q_f32(re + k);
+			float32x4_t y = vld1q_f32(im + k);
+			const float32x4_t c = vld1q_f32(wr + k);
+			const float32x4_t s = vld1q_f32(wi + k);
+			for(int j = 0; j < 4; j++){
+				float32x4_t a = vmlaq_n_f32(vdupq_n_f32(delta[j]), x, damping);
+				float32x4_t b = vmulq_n_f32(y, damping);
+				x = vmlsq_f32(vmulq_f32(a, c), b, s);
+				y = vmlaq_f32(vmulq_f32(a, s), b, c);
+			}
+			vst1q_f32(re + k, x);
+			vst1q_f32(im + k, y);
+		}
+#endif
+	}
+#endif
+	for(; n < count; n++){
+		const float delta = entering[n] - dampingN * leaving[n];
+		for(int k = 0; k < stateCount; k++){
+			float a = damping * re[k] + delta;
+			float b = damping * im[k];
+			re[k] = a * wr[k] - b * wi[k];
+			im[k] = a * wi[k] + b * wr[k];
+		}
+	}
+}
+
+void SlidingDft::_bin(int k, float& real, float& imag) const{
+	// A real block's spectrum is conjugate symmetric
+	if(k < 0 || k > size / 2){
+		int mirror = k < 0 ? -k : size - k;
+		real = stateReal[mirror - stateFirst];
+		imag = -stateImag[mirror - stateFirst];
+		return;
+	}
+	real = stateReal[k - stateFirst];
+	imag = stateImag[k - stateFirst];
+}
+
+void SlidingDft::windowedMagnitudes(float* magnitudes, float scale) const{
+	// Hann (periodic) as a three tap convolution: 0.5 X[k] - 0.25 (X[k-1] + X[k+1])
+	scale *= gain;
+	auto store = [&](int k, float lowReal, float lowImag, float real, float imag, float highReal, float highImag){
+		float windowedReal = 0.5f * real - 0.25f * (lowReal + highReal);
+		float windowedImag = 0.5f * imag - 0.25f * (lowImag + highImag);
+		magnitudes[k] = std::sqrt(windowedReal * windowedReal + windowedImag * windowedImag) * scale;
+	};
+	// Interior bins read their neighbours directly, the ones at 0 and N / 2 through the mirror
+	const int interiorFirst = std::max(firstBin, 1);
+	const int interiorLast = std::min(lastBin, size / 2 - 1);
+	const float* re = stateReal.data() - stateFirst;
+	const float* im = stateImag.data() - stateFirst;
+	for(int k = interiorFirst; k <= interiorLast; k++){
+		store(k, re[k - 1], im[k - 1], re[k], im[k], re[k + 1], im[k + 1]);
+	}
+	for(int k : {firstBin, lastBin}){
+		if(k < interiorFirst || k > interiorLast){
+			float lowReal, lowImag, real, imag, highReal, highImag;
+			_bin(k - 1, lowReal, lowImag);
+			_bin(k, real, imag);
+			_bin(k + 1, highReal, highImag);
+			store(k, lowReal, lowImag, real, imag, highReal, highImag);
+		}
+	}
+}
@@ -0,0 +1,191 @@
+#include "StereoAnalyzer.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define STEREO_ANALYZER_SSE2 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define STEREO_ANALYZER_NEON 1
+#endif
+
+namespace {
+	constexpr float pointSeconds = 0.05f;		// Time span of one set of goniometer points
+	constexpr float invSqrt2 = 0.70710678f;		// Scales L/R to mid/side without changing the level
+	constexpr double silenceFloor = 1.0e-10;	// Mean square per frame below which correlation and balance read 0
+}
+
+// Constructor
+StereoAnalyzer::StereoAnalyzer(int sampleRate, int channels, float integrationSeconds)
+	: sampleRate(sampleRate), channels(channels), carryCount(0), blockFill(0), blockLeft(0.0), blockRight(0.0), blockCross(0.0),
+	sumLeft(0.0), sumRight(0.0), sumCross(0.0), decimationPhase(0), pointsWritten(0), pointsCopied(0), correlation(0.0f), balance(0.0f){
+	if(channels < 2 || channels > maxChannels){
+		std::cerr << "StereoAnalyzer supports 2 to " << maxChannels << " channels, got " << channels << "\n";
+		this->channels = std::min(std::max(channels, 1), maxChannels);
+	}
+	decimation = std::max(1, static_cast<int>(std::lround(sampleRate * pointSeconds / pointCount)));
+	blockFrames = std::max(1, sampleRate / 100);
+	blockDecay = static_cast<float>(std::exp(-static_cast<double>(blockFrames) / (sampleRate * std::max(integrationSeconds, 0.01f))));
+
+	ring.assign(2 * ringPoints, 0.0f);
+	points.assign(2 * pointCount, 0.0f);
+	for(int c = 0; c < maxChannels; c++){
+		carry[c] = 0.0f;
+	}
+}
+
+void StereoAnalyzer::processSamples(const float* samples, int sampleCount){
+	uint64_t written = pointsWritten.load(std::memory_order_relaxed);
+
+	// Whole frames in pieces that end at block boundaries
+	auto run = [&](const float* frames, int frameCount){
+		while(frameCount > 0){
+			int take = std::min(frameCount, blockFrames - blockFill);
+			_accumulate(frames, take);
+			_storePoints(frames, take, written);
+			blockFill += take;
+			frames += take * channels;
+			frameCount -= take;
+			if(blockFill == blockFrames){
+				_finishBlock();
+			}
+		}
+	};
+
+	int i = 0;
+	// Complete a frame the previous call ended in
+	while(carryCount > 0 && i < sampleCount){
+		carry[carryCount++] = samples[i++];
+		if(carryCount == channels){
+			carryCount = 0;
+			run(carry, 1);
+		}
+	}
+	int frameCount = (sampleCount - i) / channels;
+	run(samples + i, frameCount);
+	for(i += frameCount * channels; i < sampleCount; i++){
+		carry[carryCount++] = samples[i];
+	}
+
+	pointsWritten.store(written, std::memory_order_release);
+}
+
+void StereoAnalyzer::_accumulate(const float* frames, int frameCount){
+	const int right = channels > 1 ? 1 : 0;
+	float left2 = 0.0f, right2 = 0.0f, cross = 0.0f;
+	int f = 0;
+#if defined(STEREO_ANALYZER_SSE2)
+	if(channels == 2){
+		__m128 squares = _mm_setzero_ps();
+		__m128 products = _mm_setzero_ps();
+		for(; f + 2 <= frameCount; f += 2){
+			__m128 v = _mm_loadu_ps(frames + 2 * f);	// L0 R0 L1 R1
+			squares = _mm_add_ps(squares, _mm_mul_ps(v, v));
+			products = _mm_add_ps(products, _mm_mul_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1))));
+		}
+		float lanes[4];
+		_mm_storeu_ps(lanes, squares);
+		left2 = lanes[0] + lanes[2];
+		right2 = lanes[1] + lanes[3];
+		_mm_storeu_ps(lanes, products);
+		cross = lanes[0] + lanes[2];
+	}
+#elif defined(STEREO_ANALYZER_NEON)
+	if(channels == 2){
+		float32x4_t squaresLeft = vdupq_n_f32(0.0f);
+		float32x4_t squaresRight = vdupq_n_f32(0.0f);
+		float32x4_t products = vdupq_n_f32(0.0f);
+		for(; f + 4 <= frameCount; f += 4){
+			float32x4x2_t v = vld2q_f32(frames + 2 * f);	// L0..L3, R0..R3
+			squaresLeft = vmlaq_f32(squaresLeft, v.val[0], v.val[0]);
+			squaresRight = vmlaq_f32(squaresRight, v.val[1], v.val[1]);
+			products = vmlaq_f32(products, v.val[0], v.val[1]);
+		}
+		float lanes[4];
+		vst1q_f32(lanes, squaresLeft);
+		left2 = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+		vst1q_f32(lanes, squaresRight);
+		right2 = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+		vst1q_f32(lanes, products);
+		cross = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+	}
+#endif
+	for(; f < frameCount; f++){
+		float l = frames[f * channels];
+		float r = frames[f * channels + right];
+		left2 += l * l;
+		right2 += r * r;
+		cross += l * r;
+	}
+	blockLeft += left2;
+	blockRight += right2;
+	blockCross += cross;
+}
+
+void StereoAnalyzer::_storePoints(const float* frames, int frameCount, uint64_t& written){
+	const int right = channels > 1 ? 1 : 0;
+	int f = decimationPhase;
+	for(; f < frameCount; f += decimation){
+		float l = frames[f * channels];
+		float r = frames[f * channels + right];
+		size_t slot = static_cast<size_t>(written & (ringPoints - 1)) * 2;
+		// Side on x (left leaning signals point left), mid on y
+		ring[slot] = (r - l) * invSqrt2;
+		ring[slot + 1] = (l + r) * invSqrt2;
+		written++;
+	}
+	decimationPhase = f - frameCount;
+}
+
+void StereoAnalyzer::_finishBlock(){
+	sumLeft = sumLeft * blockDecay + blockLeft;
+	sumRight = sumRight * blockDecay + blockRight;
+	sumCross = sumCross * blockDecay + blockCross;
+	blockLeft = 0.0;
+	blockRight = 0.0;
+	blockCross = 0.0;
+	blockFill = 0;
+
+	// Frames the decaying sums are worth, to compare against a per frame floor
+	const double frames = blockFrames / (1.0 - blockDecay);
+	const double energy = sumLeft + sumRight;
+	if(energy < silenceFloor * frames){
+		correlation.store(0.0f, std::memory_order_relaxed);
+		balance.store(0.0f, std::memory_order_relaxed);
+		return;
+	}
+	double product = std::sqrt(sumLeft * sumRight);
+	float coefficient = product > 0.0 ? static_cast<float>(sumCross / product) : 0.0f;
+	correlation.store(std::min(std::max(coefficient, -1.0f), 1.0f), std::memory_order_relaxed);
+	balance.store(static_cast<float>((sumRight - sumLeft) / energy), std::memory_order_relaxed);
+}
+
+bool StereoAnalyzer::update(){
+	if(pointsWritten.load(std::memory_order_acquire) == pointsCopied){
+		return false;
+	}
+	// The writer never waits, a copy it lapped is taken again from the newer end
+	for(int attempt = 0; attempt < 4; attempt++){
+		const int64_t written = static_cast<int64_t>(pointsWritten.load(std::memory_order_acquire));
+		const int64_t start = written - pointCount;
+		for(int i = 0; i < pointCount; i++){
+			int64_t point = start + i;
+			if(point < 0){
+				points[2 * i] = 0.0f;
+				points[2 * i + 1] = 0.0f;
+				continue;
+			}
+			size_t slot = static_cast<size_t>(point & (ringPoints - 1)) * 2;
+			points[2 * i] = ring[slot];
+			points[2 * i + 1] = ring[slot + 1];
+		}
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if(static_cast<int64_t>(pointsWritten.load(std::memory_order_relaxed)) - std::max<int64_t>(start, 0) <= ringPoints){
+			pointsCopied = static_cast<uint64_t>(written);
+			return true;
+		}
+	}
+	return false;
+}
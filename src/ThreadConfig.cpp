@@ -0,0 +1,211 @@
+#include "ThreadConfig.h"
+#include <iostream>
+#include <thread>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+namespace {
+	const char* policyName(SchedulingPolicy policy){
+		switch(policy){
+			case SchedulingPolicy::Fifo: return "SCHED_FIFO";
+			case SchedulingPolicy::RoundRobin: return "SCHED_RR";
+			default: return "normal";
+		}
+	}
+
+	const char* label(const ThreadConfig& config){
+		return config.name ? config.name : "thread";
+	}
+
+#ifndef _WIN32
+	// Real-time class, first at the requested priority, then clamped to what RLIMIT_RTPRIO allows
+	bool applyRealtime(pthread_t thread, const ThreadConfig& config){
+		int policy = (config.policy == SchedulingPolicy::Fifo) ? SCHED_FIFO : SCHED_RR;
+		int priority = std::min(std::max(config.priority, sched_get_priority_min(policy)), sched_get_priority_max(policy));
+
+		sched_param param;
+		param.sched_priority = priority;
+		int err = pthread_setschedparam(thread, policy, &param);
+		if(err == 0){
+			std::cout << label(config) << ": " << policyName(config.policy) << " priority " << priority << "\n";
+			return true;
+		}
+
+#ifdef RLIMIT_RTPRIO
+		rlimit limit;
+		if(err == EPERM && getrlimit(RLIMIT_RTPRIO, &limit) == 0 && limit.rlim_cur > 0){
+			param.sched_priority = std::min(priority, static_cast<int>(limit.rlim_cur));
+			if(pthread_setschedparam(thread, policy, &param) == 0){
+				std::cout << label(config) << ": " << policyName(config.policy) << " priority " << param.sched_priority
+						  << " (clamped by RLIMIT_RTPRIO)\n";
+				return false;
+			}
+		}
+#endif
+
+		std::cout << label(config) << ": " << policyName(config.policy) << " not permitted (" << strerror(err)
+				  << "), falling back to nice\n";
+		return false;
+	}
+
+	// Fallback for unprivileged runs: raise the thread's nice value as far as RLIMIT_NICE allows
+	void applyNiceFallback(pid_t systemId, const ThreadConfig& config){
+#ifdef __linux__
+		// On Linux setpriority with a thread id only affects that thread
+		for(int nice = -10; systemId != 0 && nice < 0; nice += 5){
+			if(setpriority(PRIO_PROCESS, static_cast<id_t>(systemId), nice) == 0){
+				std::cout << label(config) << ": nice " << nice << "\n";
+				return;
+			}
+		}
+#else
+		(void)systemId;
+#endif
+		std::cout << label(config) << ": running at default priority\n";
+	}
+#endif
+}
+
+namespace ThreadTuning{
+
+int coreCount(){
+	return std::max(1u, std::thread::hardware_concurrency());
+}
+
+double processCpuSeconds(){
+#ifdef _WIN32
+	FILETIME created, exited, kernel, user;
+	if(!GetProcessTimes(GetCurrentProcess(), &created, &exited, &kernel, &user)){
+		return 0.0;
+	}
+	// 100 ns ticks
+	auto ticks = [](const FILETIME& time){
+		return (static_cast<unsigned long long>(time.dwHighDateTime) << 32) | time.dwLowDateTime;
+	};
+	return (ticks(kernel) + ticks(user)) * 1.0e-7;
+#else
+	rusage usage;
+	if(getrusage(RUSAGE_SELF, &usage) != 0){
+		return 0.0;
+	}
+	return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1.0e-6;
+#endif
+}
+
+ThreadHandle currentThread(){
+	ThreadHandle handle;
+#ifdef _WIN32
+	handle.id = GetCurrentThreadId();
+#else
+	handle.thread = pthread_self();
+#ifdef __linux__
+	handle.systemId = static_cast<pid_t>(gettid());
+#endif
+#endif
+	return handle;
+}
+
+bool applyToCurrentThread(const ThreadConfig& config){
+	return applyToThread(currentThread(), config);
+}
+
+bool applyToThread(const ThreadHandle& thread, const ThreadConfig& config){
+	bool applied = true;
+
+#ifdef _WIN32
+	HANDLE handle = OpenThread(THREAD_SET_INFORMATION | THREAD_QUERY_INFORMATION, FALSE, thread.id);
+	if(!handle){
+		std::cout << label(config) << ": could not open the thread\n";
+		return false;
+	}
+	if(config.policy != SchedulingPolicy::Normal){
+		if(!SetThreadPriority(handle, THREAD_PRIORITY_TIME_CRITICAL)){
+			std::cout << label(config) << ": could not raise thread priority\n";
+			applied = false;
+		}
+	}
+	if(config.cpuCore >= 0 && config.cpuCore < 64){
+		if(!SetThreadAffinityMask(handle, DWORD_PTR(1) << config.cpuCore)){
+			std::cout << label(config) << ": could not pin to core " << config.cpuCore << "\n";
+			applied = false;
+		}
+	}
+	CloseHandle(handle);
+#else
+#ifdef __linux__
+	if(config.name){
+		// Linux limits thread names to 15 characters
+		char name[16];
+		std::strncpy(name, config.name, sizeof(name) - 1);
+		name[sizeof(name) - 1] = '\0';
+		pthread_setname_np(thread.thread, name);
+	}
+#endif
+
+	if(config.policy != SchedulingPolicy::Normal && !applyRealtime(thread.thread, config)){
+		applyNiceFallback(thread.systemId, config);
+		applied = false;
+	}
+
+	if(config.cpuCore >= 0){
+#ifdef __linux__
+		if(config.cpuCore >= coreCount()){
+			std::cout << label(config) << ": core " << config.cpuCore << " does not exist, not pinned\n";
+			applied = false;
+		}
+		else{
+			cpu_set_t cpus;
+			CPU_ZERO(&cpus);
+			CPU_SET(config.cpuCore, &cpus);
+			int err = pthread_setaffinity_np(thread.thread, sizeof(cpus), &cpus);
+			if(err != 0){
+				std::cout << label(config) << ": could not pin to core " << config.cpuCore << " (" << strerror(err) << ")\n";
+				applied = false;
+			}
+			else{
+				std::cout << label(config) << ": pinned to core " << config.cpuCore << "\n";
+			}
+		}
+#else
+		std::cout << label(config) << ": CPU pinning is not supported on this platform\n";
+		applied = false;
+#endif
+	}
+#endif
+
+	return applied;
+}
+
+bool lockProcessMemory(){
+#ifdef _WIN32
+	std::cout << "Memory locking is not supported on Windows\n";
+	return false;
+#else
+	// With a finite RLIMIT_MEMLOCK, MCL_FUTURE would make allocations fail once the limit is reached,
+	// so unprivileged runs only lock what is mapped now (call this after startup allocated everything)
+	int flags = MCL_CURRENT;
+	rlimit limit;
+	if(geteuid() == 0 || (getrlimit(RLIMIT_MEMLOCK, &limit) == 0 && limit.rlim_cur == RLIM_INFINITY)){
+		flags |= MCL_FUTURE;
+	}
+	if(mlockall(flags) != 0){
+		std::cout << "mlockall failed (" << strerror(errno) << "), memory stays pageable\n";
+		return false;
+	}
+	std::cout << "Process memory locked" << ((flags & MCL_FUTURE) ? "" : " (current pages only)") << "\n";
+	return true;
+#endif
+}
+
+}
@@ -0,0 +1,76 @@
+#include "VirtualInputDevice.h"
+#include <algorithm>
+#include <chrono>
+
+// Constructor
+VirtualInputDevice::VirtualInputDevice(AudioBuffer* buffer, const AudioLoader& loader, int framesPerBuffer)
+	: audioBuffer(buffer), loader(loader), framesPerBuffer(framesPerBuffer),
+	running(false), stopRequested(false), newestSampleTime(-1.0), droppedSamples(0){
+}
+
+VirtualInputDevice::~VirtualInputDevice(){
+	stop();
+}
+
+double VirtualInputDevice::_now(){
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool VirtualInputDevice::start(){
+	if(pacingThread.joinable()){
+		return false;
+	}
+	stopRequested.store(false);
+	running.store(true, std::memory_order_release);
+	pacingThread = std::thread(&VirtualInputDevice::_run, this);
+	return true;
+}
+
+bool VirtualInputDevice::stop(){
+	if(!pacingThread.joinable()){
+		return false;
+	}
+	stopRequested.store(true);
+	pacingThread.join();
+	running.store(false, std::memory_order_release);
+	return true;
+}
+
+// Delivers one period per period duration on an absolute schedule, so pacing errors do not accumulate
+void VirtualInputDevice::_run(){
+	const SampleStore& samples = loader.getAudioData();
+	const int channels = loader.getChannels();
+	const int periodSamples = framesPerBuffer * channels;
+	std::vector<float> block(periodSamples);
+	const auto period = std::chrono::duration<double>(static_cast<double>(framesPerBuffer) / loader.getSampleRate());
+
+	size_t position = 0;
+	auto nextDelivery = std::chrono::steady_clock::now() + period;
+
+	while(!stopRequested.load(std::memory_order_relaxed) && position < samples.size()){
+		// A real device hands over a block once all of its frames were captured
+		std::this_thread::sleep_until(nextDelivery);
+		nextDelivery += std::chrono::duration_cast<std::chrono::steady_clock::duration>(period);
+
+		int count = static_cast<int>(std::min<size_t>(periodSamples, samples.size() - position));
+		int space = audioBuffer->getAvailableWriteSamples();
+		int toWrite = std::min(count, space - space % channels);
+		samples.read(position, block.data(), toWrite);
+		int written = audioBuffer->writeBuffer(block.data(), toWrite);
+		if(written < count){
+			droppedSamples.fetch_add(count - written, std::memory_order_relaxed);
+		}
+		position += count;
+		newestSampleTime.store(_now(), std::memory_order_release);
+	}
+
+	running.store(false, std::memory_order_release);
+}
+
+double VirtualInputDevice::getCaptureLatency() const{
+	double newest = newestSampleTime.load(std::memory_order_acquire);
+	if(newest < 0.0){
+		return -1.0;
+	}
+	return _now() - newest;
+}
@@ -1,11 +1,23 @@
 #include "Visualizer.h"
+#include "AnalysisLog.h"
+#include <algorithm>
+#include <cmath>
+
+// replay rejects recorded frames with more buckets than the log allows
+static_assert(Visualizer::maxBars <= static_cast<int>(AnalysisLogs::maxBuckets), "analysis logs must hold every bar");
+
 // Vertex shader source - renders bars as instanced quads
 const char* vertexShaderSource = R"(
 #version 330 core
 layout (location = 0) in vec2 aPos;
-// IMPORTANT: change barheights if i make it variable
-uniform float barHeights[32];
+// sized for Visualizer::maxBars, only the first barCount entries are used
+uniform float barHeights[128];
+uniform float barPeaks[128];
 uniform int barCount;
+// 1 draws the thin peak caps on top of barPeaks instead of the bars
+uniform int drawCaps;
+
+const float capThickness = 0.015;
 
 void main() {
     int barIndex = gl_InstanceID;
@@ -18,11 +30,16 @@ void main() {
     
     // Scale height (clamp to prevent overflow)
     float height = min(barHeights[barIndex] * 10.0, 2.0);
+    float base = -1.0;
+    if (drawCaps == 1) {
+        base = min(barPeaks[barIndex] * 10.0, 2.0) - 1.0;
+        height = capThickness;
+    }
     
     // Position vertex
     vec2 pos = aPos;
     pos.x = pos.x * actualWidth + xOffset + actualWidth * 0.5;
-    pos.y = pos.y * height - 1.0; //+ height if we want it to float
+    pos.y = pos.y * height + base; //+ height if we want it to float
     
     gl_Position = vec4(pos, 0.0, 1.0);
 }
@@ -40,13 +57,83 @@ void main() {
 }
 )";
 
+// Goniometer vertex shader - the bar quad shrunk to a dot at each instance's side / mid point
+const char* goniometerVertexShaderSource = R"(
+#version 330 core
+layout (location = 0) in vec2 aPos;
+layout (location = 1) in vec2 point;
+// center x, center y, half width, half height of the view in clip space
+uniform vec4 area;
+
+const float dotSize = 0.006;
+
+void main() {
+    // full scale mid or side (sqrt 2) reaches the edge
+    vec2 center = area.xy + point * area.zw * 0.7071;
+    gl_Position = vec4(center + (aPos - 0.5) * dotSize * vec2(area.z / area.w, 1.0), 0.0, 1.0);
+}
+)";
+
+// Waterfall vertex shader - the bar quad scaled to cover the window
+const char* waterfallVertexShaderSource = R"(
+#version 330 core
+layout (location = 0) in vec2 aPos;
+out vec2 uv;
+
+void main() {
+    uv = aPos;
+    gl_Position = vec4(aPos * 2.0 - 1.0, 0.0, 1.0);
+}
+)";
+
+// Waterfall fragment shader - oldest frame on the left, newest on the right, log frequency upwards
+const char* waterfallFragmentShaderSource = R"(
+#version 330 core
+in vec2 uv;
+out vec4 FragColor;
+
+uniform sampler2D spectrogram;  // x: frame, y: FFT bin
+uniform float columnOffset;     // column holding the oldest frame
+uniform float historySize;
+uniform float binCount;
+uniform float nyquist;
+uniform float maxFreq;
+
+const float minFreq = 20.0;
+const float floorDb = -100.0;
+const float rangeDb = 90.0;
+
+void main() {
+    // scroll by offsetting into the ring (GL_REPEAT wraps), texel centers so frames never blend
+    float s = (floor(uv.x * historySize) + columnOffset + 0.5) / historySize;
+
+    // log frequency axis, remapped to the linear bins
+    float freq = minFreq * pow(maxFreq / minFreq, uv.y);
+    float t = (freq / nyquist * (binCount - 1.0) + 0.5) / binCount;
+
+    float magnitude = texture(spectrogram, vec2(s, t)).r;
+    float level = clamp((20.0 * log(max(magnitude, 1e-7)) / log(10.0) - floorDb) / rangeDb, 0.0, 1.0);
+
+    // dark blue to the bar color to white
+    vec3 color = level < 0.6
+        ? mix(vec3(0.1, 0.1, 0.15), vec3(0.2, 0.8, 0.9), level / 0.6)
+        : mix(vec3(0.2, 0.8, 0.9), vec3(1.0), (level - 0.6) / 0.4);
+    FragColor = vec4(color, 1.0);
+}
+)";
+
 Visualizer::Visualizer(int width, int height, int numBars)
 	: window(nullptr), windowWidth(width), windowHeight(height),
     shaderProgram(0), VAO(0), VBO(0),
-    numBars(numBars), smoothingFactor(0.5f) {
+    numBars(std::min(std::max(numBars, 1), maxBars)), smoothingFactor(0.5f), showPeaks(false), beatPulse(0.0f), noteColor{0.2f, 0.8f, 0.9f}, noteTint(0.0f), noteTintTarget(0.0f), showNotes(true), lastSwapWait(0.0),
+    waterfallProgram(0), waterfallTexture(0), waterfallBins(0), waterfallColumn(0),
+    spectrumNyquist(22050.0f), waterfallMode(false),
+    goniometerProgram(0), goniometerVAO(0), goniometerVBO(0), goniometerPoints(0), goniometerCorrelation(0.0f), showGoniometer(false),
+    redrawPending(true), redrawThreshold(0.5f), waterfallActiveColumns(0), goniometerActive(false) {
     
-	barHeights.resize(numBars, 0.0f);
-    smoothedHeights.resize(numBars, 0.0f);
+	barHeights.resize(this->numBars, 0.0f);
+    barPeaks.resize(this->numBars, 0.0f);
+    smoothedHeights.resize(this->numBars, 0.0f);
 }
 
 Visualizer::~Visualizer(){
@@ -54,6 +141,11 @@ Visualizer::~Visualizer(){
     if (VAO) glDeleteVertexArrays(1, &VAO);
     if (VBO) glDeleteBuffers(1, &VBO);
     if (shaderProgram) glDeleteProgram(shaderProgram);
+    if (waterfallProgram) glDeleteProgram(waterfallProgram);
+    if (waterfallTexture) glDeleteTextures(1, &waterfallTexture);
+    if (goniometerVAO) glDeleteVertexArrays(1, &goniometerVAO);
+    if (goniometerVBO) glDeleteBuffers(1, &goniometerVBO);
+    if (goniometerProgram) glDeleteProgram(goniometerProgram);
 	// terminate glfw
     if (window) {
         glfwDestroyWindow(window);
@@ -88,6 +180,8 @@ bool Visualizer::setupWindow(){
 	// set resize callback (needed because of c style function)
     glfwSetWindowUserPointer(window, this);
     glfwSetFramebufferSizeCallback(window, framebufferSizeCallback);
+    glfwSetKeyCallback(window, keyCallback);
+    glfwSetWindowRefreshCallback(window, windowRefreshCallback);
 
 	// initialize GLAD
     if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
@@ -157,6 +251,8 @@ bool Visualizer::setupShaders(){
     uniformBarHeights = glGetUniformLocation(shaderProgram, "barHeights");
     uniformBarCount = glGetUniformLocation(shaderProgram, "barCount");
     uniformBarColor = glGetUniformLocation(shaderProgram, "barColor");
+    uniformBarPeaks = glGetUniformLocation(shaderProgram, "barPeaks");
+    uniformDrawCaps = glGetUniformLocation(shaderProgram, "drawCaps");
     
     return true;
 }
@@ -188,6 +284,76 @@ void Visualizer::setupGeometry(){
     glBindVertexArray(0);
 }
 
+bool Visualizer::setupWaterfall(){
+    GLuint vertexShader = _compileShader(waterfallVertexShaderSource, GL_VERTEX_SHADER);
+    GLuint fragmentShader = _compileShader(waterfallFragmentShaderSource, GL_FRAGMENT_SHADER);
+
+    if (!vertexShader || !fragmentShader) {
+        return false;
+    }
+
+    waterfallProgram = _createShaderProgram(vertexShader, fragmentShader);
+    glDeleteShader(vertexShader);
+    glDeleteShader(fragmentShader);
+
+    if (!waterfallProgram) {
+        return false;
+    }
+    uniformColumnOffset = glGetUniformLocation(waterfallProgram, "columnOffset");
+    uniformHistorySize = glGetUniformLocation(waterfallProgram, "historySize");
+    uniformBinCount = glGetUniformLocation(waterfallProgram, "binCount");
+    uniformNyquist = glGetUniformLocation(waterfallProgram, "nyquist");
+    uniformMaxFreq = glGetUniformLocation(waterfallProgram, "maxFreq");
+
+    // storage is allocated by the first pushSpectrum, once the bin count is known
+    glGenTextures(1, &waterfallTexture);
+    glBindTexture(GL_TEXTURE_2D, waterfallTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    return true;
+}
+
+bool Visualizer::setupGoniometer(){
+    GLuint vertexShader = _compileShader(goniometerVertexShaderSource, GL_VERTEX_SHADER);
+    GLuint fragmentShader = _compileShader(fragmentShaderSource, GL_FRAGMENT_SHADER);
+
+    if (!vertexShader || !fragmentShader) {
+        return false;
+    }
+
+    goniometerProgram = _createShaderProgram(vertexShader, fragmentShader);
+    glDeleteShader(vertexShader);
+    glDeleteShader(fragmentShader);
+
+    if (!goniometerProgram) {
+        return false;
+    }
+    uniformGoniometerArea = glGetUniformLocation(goniometerProgram, "area");
+    uniformGoniometerColor = glGetUniformLocation(goniometerProgram, "barColor");
+
+    // fixed size instance buffer, later uploads only overwrite it
+    glGenVertexArrays(1, &goniometerVAO);
+    glGenBuffers(1, &goniometerVBO);
+    glBindVertexArray(goniometerVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, goniometerVBO);
+    std::vector<float> silence(maxGoniometerPoints * 2, 0.0f);
+    glBufferData(GL_ARRAY_BUFFER, silence.size() * sizeof(float), silence.data(), GL_DYNAMIC_DRAW);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribDivisor(1, 1);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    return true;
+}
+
 void Visualizer::framebufferSizeCallback(GLFWwindow* window, int width, int height){
 	glViewport(0, 0, width, height);
 	//update stored dimensions(using static cast because this func cannot access our members)
@@ -195,6 +361,14 @@ void Visualizer::framebufferSizeCallback(GLFWwindow* window, int width, int heig
     if (vis) {
         vis->windowWidth = width;
         vis->windowHeight = height;
+        vis->redrawPending = true;
+    }
+}
+
+void Visualizer::windowRefreshCallback(GLFWwindow* window){
+    Visualizer* vis = static_cast<Visualizer*>(glfwGetWindowUserPointer(window));
+    if (vis) {
+        vis->redrawPending = true;
     }
 }
 
@@ -205,7 +379,14 @@ bool Visualizer::initialize(){
     if(!setupShaders()){
         return false;
     }
+    if(!setupWaterfall()){
+        return false;
+    }
     setupGeometry();
+    // after the geometry, its VAO shares the quad buffer
+    if(!setupGoniometer()){
+        return false;
+    }
 
     return true;
 }
@@ -222,23 +403,68 @@ void Visualizer::updateData(const std::vector<float>& buckets){
     }
 }
 
+void Visualizer::setBarHeights(const std::vector<float>& heights, const std::vector<float>& peaks){
+    if (heights.size() != barHeights.size()) {
+        std::cerr << "Warning: Bucket count mismatch\n";
+        return;
+    }
+    // already smoothed by the caller, kept in smoothedHeights so updateData continues from here
+    barHeights = heights;
+    smoothedHeights = heights;
+    showPeaks = peaks.size() == barPeaks.size();
+    if (showPeaks) {
+        barPeaks = peaks;
+    }
+}
+
 void Visualizer::render(){
+    // everything needsRedraw() compares against
+    redrawPending = false;
+    drawnHeights = barHeights;
+    drawnPeaks = barPeaks;
+
     // Clear screen
     glClearColor(0.1f, 0.1f, 0.15f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT);
 
     
+    if (waterfallMode) {
+        renderWaterfall();
+        renderGoniometer();
+        beatPulse *= 0.85f;
+        _swapBuffers();
+        return;
+    }
+
     glUseProgram(shaderProgram);
     // set uniforms
     glUniform1fv(uniformBarHeights, numBars, barHeights.data());
     glUniform1i(uniformBarCount, numBars);
-    glUniform3f(uniformBarColor, 0.2f, 0.8f, 0.9f);
+    // ease the base color toward the note's hue, then blend it toward white on beats
+    noteTint += ((showNotes ? noteTintTarget : 0.0f) - noteTint) * 0.1f;
+    const float baseColor[3] = {0.2f, 0.8f, 0.9f};
+    float color[3];
+    for (int c = 0; c < 3; c++) {
+        color[c] = baseColor[c] + (noteColor[c] - baseColor[c]) * noteTint;
+        color[c] += (1.0f - color[c]) * beatPulse;
+    }
+    glUniform3f(uniformBarColor, color[0], color[1], color[2]);
+    beatPulse *= 0.85f;
     // Draw instanced bars
+    glUniform1i(uniformDrawCaps, 0);
     glBindVertexArray(VAO);
     glDrawArraysInstanced(GL_TRIANGLES, 0, 6, numBars);
+    // peak caps, same quad and instancing in a second pass
+    if (showPeaks) {
+        glUniform1fv(uniformBarPeaks, numBars, barPeaks.data());
+        glUniform1i(uniformDrawCaps, 1);
+        glUniform3f(uniformBarColor, 0.9f, 0.95f, 1.0f);
+        glDrawArraysInstanced(GL_TRIANGLES, 0, 6, numBars);
+    }
     glBindVertexArray(0);
+    renderGoniometer();
 
-    glfwSwapBuffers(window);
+    _swapBuffers();
 }
 
 bool Visualizer::shouldClose() const{
@@ -255,6 +481,214 @@ void Visualizer::pollEvents(){
     glfwPollEvents();
 }
 
+void Visualizer::waitEvents(double timeout){
+    if (timeout > 0.0) {
+        glfwWaitEventsTimeout(timeout);
+    }
+    else {
+        glfwPollEvents();
+    }
+}
+
+void Visualizer::wakeUp(){
+    glfwPostEmptyEvent();
+}
+
+bool Visualizer::isMinimized() const{
+    return window && glfwGetWindowAttrib(window, GLFW_ICONIFIED);
+}
+
+bool Visualizer::needsRedraw() const{
+    if (redrawPending || (showGoniometer && goniometerActive) || drawnHeights.size() != barHeights.size() || drawnPeaks.size() != barPeaks.size()) {
+        return true;
+    }
+    if (waterfallMode) {
+        return waterfallActiveColumns > 0;
+    }
+    // fading flash and tint change the color every frame until they settle
+    if (beatPulse > 0.01f || std::fabs((showNotes ? noteTintTarget : 0.0f) - noteTint) > 0.005f) {
+        return true;
+    }
+    // heights are scaled by 10 into a clip space 2 units tall, so one pixel is 1 / (5 * height)
+    const float threshold = redrawThreshold / (5.0f * std::max(windowHeight, 1));
+    for (size_t i = 0; i < barHeights.size(); i++) {
+        if (std::fabs(barHeights[i] - drawnHeights[i]) > threshold) {
+            return true;
+        }
+    }
+    if (showPeaks) {
+        for (size_t i = 0; i < barPeaks.size(); i++) {
+            if (std::fabs(barPeaks[i] - drawnPeaks[i]) > threshold) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
 void Visualizer::setSmoothingFactor(float factor){
     smoothingFactor = factor;
-}
\ No newline at end of file
+}
+
+void Visualizer::triggerBeat(float strength){
+    beatPulse = std::max(beatPulse, std::min(std::max(strength, 0.0f), 1.0f));
+}
+
+void Visualizer::setNoteColor(int pitchClass, float strength){
+    if (pitchClass < 0) {
+        noteTintTarget = 0.0f;
+        return;
+    }
+    // pitch classes go once around the color wheel (HSV with saturation 0.7, value 0.95)
+    float hue = pitchClass / 12.0f * 6.0f;
+    const float offsets[3] = {5.0f, 3.0f, 1.0f};
+    for (int c = 0; c < 3; c++) {
+        float k = std::fmod(offsets[c] + hue, 6.0f);
+        noteColor[c] = 0.95f * (1.0f - 0.7f * std::max(0.0f, std::min(std::min(k, 4.0f - k), 1.0f)));
+    }
+    noteTintTarget = 0.8f * std::min(std::max(strength, 0.0f), 1.0f);
+}
+
+void Visualizer::setBarCount(int count){
+    numBars = std::min(std::max(count, 1), maxBars);
+    // heights restart from zero, the smoothing ramps the new layout in
+    barHeights.assign(numBars, 0.0f);
+    barPeaks.assign(numBars, 0.0f);
+    smoothedHeights.assign(numBars, 0.0f);
+    redrawPending = true;
+}
+
+void Visualizer::keyCallback(GLFWwindow* window, int key, int /*scancode*/, int action, int /*mods*/){
+    Visualizer* vis = static_cast<Visualizer*>(glfwGetWindowUserPointer(window));
+    if (vis && key == GLFW_KEY_W && action == GLFW_PRESS) {
+        vis->setWaterfallMode(!vis->waterfallMode);
+    }
+    if (vis && key == GLFW_KEY_N && action == GLFW_PRESS) {
+        vis->showNotes = !vis->showNotes;
+    }
+    if (vis && key == GLFW_KEY_G && action == GLFW_PRESS) {
+        vis->setGoniometerVisible(!vis->showGoniometer);
+    }
+}
+
+void Visualizer::_swapBuffers(){
+    double swapStart = glfwGetTime();
+    glfwSwapBuffers(window);
+    lastSwapWait = glfwGetTime() - swapStart;
+}
+
+void Visualizer::setVsync(bool enabled){
+    glfwSwapInterval(enabled ? 1 : 0);
+}
+
+double Visualizer::getRefreshRate() const{
+    GLFWmonitor* monitor = glfwGetPrimaryMonitor();
+    const GLFWvidmode* mode = monitor ? glfwGetVideoMode(monitor) : nullptr;
+    return (mode && mode->refreshRate > 0) ? mode->refreshRate : 60.0;
+}
+
+void Visualizer::setWaterfallMode(bool enabled){
+    waterfallMode = enabled;
+    redrawPending = true;
+}
+
+void Visualizer::setSpectrumSampleRate(float sampleRate){
+    spectrumNyquist = sampleRate * 0.5f;
+}
+
+void Visualizer::pushSpectrum(const std::vector<float>& spectrum){
+    if (!waterfallTexture || spectrum.empty()) {
+        return;
+    }
+    int binCount = static_cast<int>(spectrum.size());
+
+    glBindTexture(GL_TEXTURE_2D, waterfallTexture);
+    // a new FFT size restarts the history, the only time the whole texture is written
+    if (binCount != waterfallBins) {
+        std::vector<float> silence(static_cast<size_t>(waterfallHistory) * binCount, 0.0f);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, waterfallHistory, binCount, 0, GL_RED, GL_FLOAT, silence.data());
+        waterfallBins = binCount;
+        waterfallColumn = 0;
+        redrawPending = true;
+    }
+
+    // a column with signal keeps the waterfall scrolling until it left the screen
+    if (*std::max_element(spectrum.begin(), spectrum.end()) > 1.0e-5f) {
+        waterfallActiveColumns = waterfallHistory;
+    }
+    else if (waterfallActiveColumns > 0) {
+        waterfallActiveColumns--;
+    }
+
+    // one column per frame, the shader scrolls by offsetting into the ring
+    glTexSubImage2D(GL_TEXTURE_2D, 0, waterfallColumn, 0, 1, binCount, GL_RED, GL_FLOAT, spectrum.data());
+    glBindTexture(GL_TEXTURE_2D, 0);
+    waterfallColumn = (waterfallColumn + 1) % waterfallHistory;
+}
+
+void Visualizer::renderWaterfall(){
+    if (!waterfallBins) {
+        return;
+    }
+
+    glUseProgram(waterfallProgram);
+    glUniform1f(uniformColumnOffset, static_cast<float>(waterfallColumn));
+    glUniform1f(uniformHistorySize, static_cast<float>(waterfallHistory));
+    glUniform1f(uniformBinCount, static_cast<float>(waterfallBins));
+    glUniform1f(uniformNyquist, spectrumNyquist);
+    glUniform1f(uniformMaxFreq, std::min(20000.0f, spectrumNyquist));
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, waterfallTexture);
+    glBindVertexArray(VAO);
+    glDrawArrays(GL_TRIANGLES, 0, 6);
+    glBindVertexArray(0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void Visualizer::setGoniometerPoints(const std::vector<float>& points, float correlation){
+    goniometerCorrelation = correlation;
+    // the count only covers uploaded points, so showing the overlay draws nothing until the next upload
+    if (!showGoniometer) {
+        goniometerPoints = 0;
+        return;
+    }
+    goniometerPoints = std::min(static_cast<int>(points.size() / 2), maxGoniometerPoints);
+    if (!goniometerPoints) {
+        return;
+    }
+    // points at the center (silence) stop demand rendering once they were drawn
+    bool active = false;
+    for (int i = 0; i < 2 * goniometerPoints && !active; i++) {
+        active = std::fabs(points[i]) > 1.0e-4f;
+    }
+    redrawPending = redrawPending || goniometerActive != active;
+    goniometerActive = active;
+    glBindBuffer(GL_ARRAY_BUFFER, goniometerVBO);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, goniometerPoints * 2 * sizeof(float), points.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void Visualizer::setGoniometerVisible(bool visible){
+    showGoniometer = visible;
+    redrawPending = true;
+}
+
+void Visualizer::renderGoniometer(){
+    if (!showGoniometer || !goniometerPoints) {
+        return;
+    }
+
+    // square in the top right corner, half the window height
+    float halfHeight = 0.25f;
+    float halfWidth = halfHeight * windowHeight / std::max(windowWidth, 1);
+    glUseProgram(goniometerProgram);
+    glUniform4f(uniformGoniometerArea, 0.95f - halfWidth, 0.95f - halfHeight, halfWidth, halfHeight);
+    // red when out of phase, yellow when unrelated, green when mono compatible
+    float c = std::min(std::max(goniometerCorrelation, -1.0f), 1.0f);
+    glUniform3f(uniformGoniometerColor, c < 0.0f ? 0.95f : 0.95f - 0.65f * c, c < 0.0f ? 0.9f + 0.6f * c : 0.9f, 0.3f);
+
+    glBindVertexArray(goniometerVAO);
+    glDrawArraysInstanced(GL_TRIANGLES, 0, 6, goniometerPoints);
+    glBindVertexArray(0);
+}
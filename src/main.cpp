@@ -8,15 +8,75 @@
 #include "AudioBuffer.h"
 #include "AudioOutput.h"
 #include "AudioAnalyzer.h"
+#include "AnalyzerT.h"
 #include "Visualizer.h"
+#include "LoudnessMeter.h"
+#include "BeatDetector.h"
+#include "FramePublisher.h"
+#include "FrameReader.h"
+#include "AudioInput.h"
+#include "VirtualInputDevice.h"
+#include "QualityScheduler.h"
+#include "ThreadConfig.h"
+#include "FeatureExtractor.h"
+#include "FeatureWriter.h"
+#include "PresentationScheduler.h"
+#include "AnalysisLog.h"
+#include "AnalysisReplay.h"
+#include "PitchAnalyzer.h"
+#include "StereoAnalyzer.h"
 #include <cmath>
 #include <thread>
 #include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <memory>
+#include <algorithm>
+#include <future>
+#include <atomic>
+#include <mutex>
+#include <string>
 #include <tinyfiledialogs.h>
 
 #include <fftw3.h>
 
-int main() {
+// Command line options
+struct Options {
+    const char* publishName = nullptr;
+    bool forcePublish = false;
+    const char* readFramesName = nullptr;
+    bool captureInput = false;
+    const char* virtualInputFile = nullptr;
+    bool serialStartup = false;
+    bool adaptiveQuality = false;
+    double syntheticLoadMs = 0.0;
+    bool rtThreads = false;
+    bool pinCores = false;
+    int cpuHogThreads = 0;
+    bool waterfall = false;
+    bool goniometer = false;
+    const char* decodeBenchmarkFile = nullptr;
+    const char* storageBenchmarkFile = nullptr;
+    const char* slidingBenchmarkFile = nullptr;
+    bool analyzerBenchmark = false;
+    SampleFormat sampleFormat = SampleFormat::Auto;
+    const char* featuresOutFile = nullptr;
+    const char* extractFeaturesFile = nullptr;
+    const char* extractFeaturesOut = nullptr;
+    bool vsync = false;
+    double renderRate = 0.0;
+    bool demandRendering = false;
+    float redrawThreshold = 0.5f;
+    const char* recordFile = nullptr;
+    const char* replaySource = nullptr;
+    const char* goldenFile = nullptr;
+    float replayTolerance = 1.0e-4f;
+};
+
+// File playback or live input with the visualizer, everything main() does when no mode option is given
+static int runVisualizer(const Options& options);
+
+int main(int argc, char* argv[]) {
 /*commented out for now, testing main with visuals
         // 1. Load audio file
     AudioLoader loader;
@@ -107,98 +167,847 @@ int main() {
     }
     return 0;
 */
-// 0. File dialog popup to select file
-    const char* filterPatterns[] = { "*.mp3", "*.wav", "*.flac"};
-    char const * selection = tinyfd_openFileDialog(
-        "Select Audio File", // title
-        "", // optional initial directory
-        2, // number of filter patterns
-        filterPatterns, // char const * lFilterPatterns[2] = { "*.txt", "*.jpg" };
-        "Audio Files (*.mp3, *.wav, *.flac)", // optional filter description
-        0 // forbids multiple selections
-        ); 
-
-    if (!selection) {
-        std::cerr << "No file selected\n";
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--publish") == 0) {
+            // Optional ring name, otherwise the default one readers look for
+            options.publishName = (i + 1 < argc && argv[i + 1][0] == '/') ? argv[++i] : SharedFrames::defaultName;
+        }
+        else if (std::strcmp(argv[i], "--read-frames") == 0) {
+            options.readFramesName = (i + 1 < argc && argv[i + 1][0] == '/') ? argv[++i] : SharedFrames::defaultName;
+        }
+        else if (std::strcmp(argv[i], "--force") == 0) {
+            // Take over a ring of the same name, e.g. one a crashed run left behind
+            options.forcePublish = true;
+        }
+        else if (std::strcmp(argv[i], "--capture") == 0) {
+            options.captureInput = true;
+        }
+        else if (std::strcmp(argv[i], "--virtual-input") == 0 && i + 1 < argc) {
+            options.virtualInputFile = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--serial-startup") == 0) {
+            options.serialStartup = true;
+        }
+        else if (std::strcmp(argv[i], "--adaptive-quality") == 0) {
+            options.adaptiveQuality = true;
+        }
+        else if (std::strcmp(argv[i], "--synthetic-load") == 0 && i + 1 < argc) {
+            // Busy work added to every rendered frame, to check the scheduler holds its deadlines
+            options.syntheticLoadMs = std::atof(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--decode-benchmark") == 0 && i + 1 < argc) {
+            options.decodeBenchmarkFile = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--storage-benchmark") == 0 && i + 1 < argc) {
+            options.storageBenchmarkFile = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--analyzer-benchmark") == 0) {
+            options.analyzerBenchmark = true;
+        }
+        else if (std::strcmp(argv[i], "--sliding-benchmark") == 0 && i + 1 < argc) {
+            options.slidingBenchmarkFile = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--sample-storage") == 0 && i + 1 < argc) {
+            const char* name = argv[++i];
+            if (std::strcmp(name, "auto") == 0) options.sampleFormat = SampleFormat::Auto;
+            else if (std::strcmp(name, "float32") == 0) options.sampleFormat = SampleFormat::Float32;
+            else if (std::strcmp(name, "int16") == 0) options.sampleFormat = SampleFormat::Int16;
+            else if (std::strcmp(name, "int24") == 0) options.sampleFormat = SampleFormat::Int24;
+            else if (std::strcmp(name, "compressed") == 0) options.sampleFormat = SampleFormat::Compressed;
+            else {
+                std::cerr << "Unknown sample storage: " << name << " (auto, float32, int16, int24, compressed)\n";
+                return 1;
+            }
+        }
+        else if (std::strcmp(argv[i], "--features-out") == 0 && i + 1 < argc) {
+            options.featuresOutFile = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--extract-features") == 0 && i + 2 < argc) {
+            options.extractFeaturesFile = argv[++i];
+            options.extractFeaturesOut = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--vsync") == 0) {
+            options.vsync = true;
+        }
+        else if (std::strcmp(argv[i], "--render-rate") == 0 && i + 1 < argc) {
+            // Fixed render rate in Hz, e.g. 120 or 144, analysis keeps its own rate
+            options.renderRate = std::max(0.0, std::atof(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--render-mode") == 0 && i + 1 < argc) {
+            const char* name = argv[++i];
+            if (std::strcmp(name, "continuous") == 0) options.demandRendering = false;
+            else if (std::strcmp(name, "demand") == 0) options.demandRendering = true;
+            else {
+                std::cerr << "Unknown render mode: " << name << " (continuous, demand)\n";
+                return 1;
+            }
+        }
+        else if (std::strcmp(argv[i], "--redraw-threshold") == 0 && i + 1 < argc) {
+            // Pixels a bar has to move before demand rendering draws a frame
+            options.redrawThreshold = static_cast<float>(std::max(0.0, std::atof(argv[++i])));
+        }
+        else if (std::strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            options.recordFile = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            options.replaySource = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--golden") == 0 && i + 1 < argc) {
+            options.goldenFile = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc) {
+            // Relative tolerance of the replay comparison
+            options.replayTolerance = static_cast<float>(std::max(0.0, std::atof(argv[++i])));
+        }
+        else if (std::strcmp(argv[i], "--waterfall") == 0) {
+            options.waterfall = true;
+        }
+        else if (std::strcmp(argv[i], "--goniometer") == 0) {
+            options.goniometer = true;
+        }
+        else if (std::strcmp(argv[i], "--rt-threads") == 0) {
+            options.rtThreads = true;
+        }
+        else if (std::strcmp(argv[i], "--pin-cores") == 0) {
+            options.pinCores = true;
+        }
+        else if (std::strcmp(argv[i], "--cpu-hog") == 0 && i + 1 < argc) {
+            // Competing busy threads, to measure underruns and callback jitter under load
+            options.cpuHogThreads = std::max(0, std::atoi(argv[++i]));
+        }
+        else {
+            std::cerr << "Unknown option: " << argv[i] << "\n";
+            std::cerr << "Usage: AudioVisualizer [--publish [/shm-name] [--force]] [--read-frames [/shm-name]] [--capture | --virtual-input <file>] [--serial-startup] [--adaptive-quality] [--synthetic-load <ms>] [--rt-threads] [--pin-cores] [--cpu-hog <threads>] [--waterfall] [--goniometer] [--decode-benchmark <file>] [--storage-benchmark <file>] [--sliding-benchmark <file>] [--analyzer-benchmark] [--sample-storage <layout>] [--features-out <file>] [--extract-features <file> <out>] [--vsync] [--render-rate <hz>] [--render-mode <continuous|demand>] [--redraw-threshold <px>] [--record <log>] [--replay <log|file> [--golden <log>] [--tolerance <rel>]]\n";
+            return 1;
+        }
+    }
+    // A feature file has one FFT size in its header, adaptive quality changes the size while running
+    if (options.featuresOutFile && options.adaptiveQuality) {
+        std::cerr << "Error: --features-out cannot be combined with --adaptive-quality, the feature file holds one FFT size\n";
         return 1;
     }
-// 1. Load audio file
+
+    // Reader side of --publish, in another process
+    if (options.readFramesName) {
+        return FrameReader::monitorLatency(options.readFramesName) ? 0 : 1;
+    }
+
+    // Compile time specialized analyzers against AudioAnalyzer with the same FFT size, bucket count and sample rate
+    if (options.analyzerBenchmark) {
+        benchmarkAnalyzerT();
+        return 0;
+    }
+
+    // Decode throughput against thread count
+    if (options.decodeBenchmarkFile) {
+        return AudioLoader::benchmarkDecode(options.decodeBenchmarkFile) ? 0 : 1;
+    }
+
+    // Memory and fill throughput of every sample storage layout, against the float layout
+    if (options.storageBenchmarkFile) {
+        return AudioLoader::benchmarkStorage(options.storageBenchmarkFile) ? 0 : 1;
+    }
+
+    // Cost and accuracy of the sliding DFT against a full FFT of every block, across hop sizes
+    if (options.slidingBenchmarkFile) {
+        return AudioAnalyzer::benchmarkSlidingDft(options.slidingBenchmarkFile, options.sampleFormat) ? 0 : 1;
+    }
+
+    // Offline feature extraction, the same analysis and features as the live path over every hop of the file
+    if (options.extractFeaturesFile) {
+        return FeatureExtractor::extractFile(options.extractFeaturesFile, options.extractFeaturesOut, options.sampleFormat) ? 0 : 1;
+    }
+
+    // Deterministic replay of a log (or every hop of an audio file), compared against --golden (or the log itself)
+    if (options.replaySource) {
+        return AnalysisReplay::replayFile(options.replaySource, options.goldenFile, options.recordFile, options.replayTolerance, options.sampleFormat) ? 0 : 1;
+    }
+
+    return runVisualizer(options);
+}
+
+static int runVisualizer(const Options& options) {
+    // Live sources push into the buffer themselves and are analyzed without playback
+    const bool liveInput = options.captureInput || options.virtualInputFile;
+    // Feeding and analysis move to dedicated threads when either real-time option is given
+    const bool dedicatedThreads = options.rtThreads || options.pinCores;
+
+    // Thread settings of the audio path: callback above feeder above analysis, rendering stays normal.
+    // Cores 1-3 when pinning, core 0 is left to the OS and the render thread.
+    const SchedulingPolicy realtimePolicy = options.rtThreads ? SchedulingPolicy::Fifo : SchedulingPolicy::Normal;
+    const bool enoughCores = ThreadTuning::coreCount() >= 4;
+    if (options.pinCores && !enoughCores) {
+        std::cout << "Fewer than 4 cores, threads are not pinned\n";
+    }
+    const ThreadConfig callbackThreadConfig = {realtimePolicy, 80, (options.pinCores && enoughCores) ? 1 : -1, "audio callback"};
+    const ThreadConfig feederThreadConfig = {realtimePolicy, 70, (options.pinCores && enoughCores) ? 2 : -1, "feeder"};
+    const ThreadConfig analysisThreadConfig = {realtimePolicy, 50, (options.pinCores && enoughCores) ? 3 : -1, "analysis"};
+
+    using Clock = std::chrono::steady_clock;
+
     AudioLoader loader;
-    if (!loader.loadAudioFile(selection)) {
-        std::cerr << "Error: Could not load audio file\n";
-        return 1;
+    loader.setSampleFormat(options.sampleFormat);
+    const char* selection = options.virtualInputFile;
+    if (!options.captureInput && !selection) {
+// 0. File dialog popup to select file (the virtual input device replays the file given on the command line)
+        const char* filterPatterns[] = { "*.mp3", "*.wav", "*.flac"};
+        selection = tinyfd_openFileDialog(
+            "Select Audio File", // title
+            "", // optional initial directory
+            2, // number of filter patterns
+            filterPatterns, // char const * lFilterPatterns[2] = { "*.txt", "*.jpg" };
+            "Audio Files (*.mp3, *.wav, *.flac)", // optional filter description
+            0 // forbids multiple selections
+            ); 
+
+        if (!selection) {
+            std::cerr << "No file selected\n";
+            return 1;
+        }
     }
 
-    std::cout << "Loaded file: "
-              << loader.getSampleRate() << " Hz, "
-              << loader.getChannels() << " channels, "
-              << loader.getDuration() << " seconds\n";
+    // Startup is timed from the moment the file is known
+    const Clock::time_point startupBegin = Clock::now();
 
-    // 2. Create buffer
+// 1. Open audio file, only the header is read here so sample rate and channels are known immediately
+    if (selection) {
+        if (!loader.openAudioFile(selection)) {
+            std::cerr << "Error: Could not load audio file\n";
+            return 1;
+        }
+
+        std::cout << "Loaded file: "
+                  << loader.getSampleRate() << " Hz, "
+                  << loader.getChannels() << " channels, "
+                  << loader.getDuration() << " seconds\n";
+    }
+
+    // 2. Create buffer, live sources write into it instead of pulling from the loader
     const int bufferSize = 8192;
-    AudioBuffer buffer(bufferSize, loader);
+    const int fftSize = 1024;
+    std::unique_ptr<AudioBuffer> bufferStorage = liveInput
+        ? std::make_unique<AudioBuffer>(bufferSize)
+        : std::make_unique<AudioBuffer>(bufferSize, loader);
+    AudioBuffer& buffer = *bufferStorage;
 
-    // 3. Pre-fill buffer
-    while (buffer.fillBuffer(bufferSize / 2)) {
-        if (buffer.getAvailableReadSamples() >= bufferSize / 2) break;
+    std::unique_ptr<InputSource> input;
+    if (options.captureInput) {
+        input = std::make_unique<AudioInput>(&buffer);
     }
+    else if (options.virtualInputFile) {
+        // The virtual device replays the fully decoded file
+        if (!loader.decodeAudioFile()) {
+            std::cerr << "Error: Could not decode audio file\n";
+            return 1;
+        }
+        input = std::make_unique<VirtualInputDevice>(&buffer, loader);
+    }
+    const int sampleRate = input ? input->getSampleRate() : loader.getSampleRate();
+    const int channels = input ? input->getChannels() : loader.getChannels();
 
-    // 4. Create audio output and analyzer
-    AudioOutput output(&buffer, loader.getSampleRate(), loader.getChannels());
-    AudioAnalyzer analyzer(&buffer, 1024, loader.getSampleRate());
+    // Loudness meter sees every sample once as it is written into the buffer
+    LoudnessMeter loudnessMeter(sampleRate, channels);
+    buffer.addTap(&loudnessMeter);
+    // Pitch and chroma keep their own mono history of every sample, analyzed once per analysis frame
+    PitchAnalyzer pitchAnalyzer(sampleRate, channels);
+    buffer.addTap(&pitchAnalyzer);
+    // Correlation, balance and goniometer points of the first two channels, only for stereo streams
+    std::unique_ptr<StereoAnalyzer> stereoAnalyzer;
+    if (channels >= 2) {
+        stereoAnalyzer = std::make_unique<StereoAnalyzer>(sampleRate, channels);
+        buffer.addTap(stereoAnalyzer.get());
+    }
+
+    // 3-4. Startup graph: decode, PortAudio init + pre-fill, and FFTW planning run concurrently while
+    // this thread creates the GL context (GLFW requires the main thread). --serial-startup runs the same
+    // steps one after another for comparison.
+    const std::launch startupPolicy = options.serialStartup ? std::launch::deferred : std::launch::async;
+    Clock::time_point firstSoundTime;
+
+    std::future<bool> decodeTask;
+    std::future<std::unique_ptr<AudioOutput>> playbackTask;
+    if (!liveInput) {
+        decodeTask = std::async(startupPolicy, [&loader]() {
+            return loader.decodeAudioFile();
+        });
+
+        playbackTask = std::async(startupPolicy, [&]() -> std::unique_ptr<AudioOutput> {
+            auto audioOutput = std::make_unique<AudioOutput>(&buffer, sampleRate, channels);
+            if (dedicatedThreads) {
+                audioOutput->setCallbackThreadConfig(callbackThreadConfig);
+            }
+
+            // 3. Pre-fill buffer as soon as the decoder got far enough
+            while (!loader.isFullyDecoded() && loader.getDecodedSamples() < static_cast<size_t>(bufferSize / 2)) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            while (buffer.fillBuffer(bufferSize / 2)) {
+                if (buffer.getAvailableReadSamples() >= bufferSize / 2) break;
+            }
+
+            // 6. Start playback
+            if (!audioOutput->start()) {
+                return nullptr;
+            }
+            firstSoundTime = Clock::now();
+            return audioOutput;
+        });
+    }
+
+    std::future<std::unique_ptr<AudioAnalyzer>> analyzerTask = std::async(startupPolicy, [&]() {
+        // One task plans every FFT, FFTW's planner is not thread safe
+        if (!pitchAnalyzer.initialize()) {
+            std::cout << "Could not plan the pitch analysis FFT, pitch is disabled\n";
+        }
+        return std::make_unique<AudioAnalyzer>(&buffer, fftSize, sampleRate);
+    });
+
+    std::unique_ptr<AudioOutput> output;
+    std::unique_ptr<AudioAnalyzer> analyzer;
+    if (options.serialStartup) {
+        // Same order as the old single threaded startup
+        if (!liveInput) {
+            decodeTask.get();
+            output = playbackTask.get();
+            // The loop below only joins a task that is still pending, get() already consumed this one
+            if (!output) {
+                std::cerr << "Error: Could not start audio output\n";
+                return 1;
+            }
+        }
+        analyzer = analyzerTask.get();
+    }
+    BeatDetector beatDetector(fftSize / 2 + 1);
+
+    // Optional shared memory ring for external consumers (LED walls, lighting controllers)
+    FramePublisher publisher;
+    if (options.publishName && publisher.open(options.publishName, 64, sampleRate, options.forcePublish)) {
+        std::cout << "Publishing analysis frames to shared memory " << options.publishName << "\n";
+    }
+
+    // Optional feature rows of every analysis frame (--features-out), from the analyzer's spectrum
+    const float spectrumRate = static_cast<float>(sampleRate * channels);
+    FeatureExtractor featureExtractor(fftSize / 2 + 1, spectrumRate, 40, 13, 2, 20.0f, sampleRate / 2.0f);
+    FeatureWriter featureWriter;
+    if (options.featuresOutFile && featureWriter.open(options.featuresOutFile, FeatureWriter::layoutOf(featureExtractor, spectrumRate, fftSize, 0))) {
+        std::cout << "Writing features of every analysis frame to " << options.featuresOutFile << "\n";
+    }
+
+    // Optional log of every analysis frame for --replay (--record). File playback is logged by path and sample
+    // position, live input cannot be read again so its blocks go into the log.
+    AnalysisLogWriter analysisLog;
+    AnalysisLogFrame recordFrame;
+    PresentationScheduler recordPresentation(0.015f, 0.12f, 0.4f, 0.15f);
+    float analysisRate = 60.0f;
+    bool analysisReset = true;
+    if (options.recordFile && analysisLog.open(options.recordFile, sampleRate, channels, liveInput ? std::string() : std::string(selection), liveInput)) {
+        std::cout << "Recording analysis frames to " << options.recordFile << "\n";
+    }
     
     // 5. Create visualizer
     Visualizer visualizer(800, 600, 32);
     if (!visualizer.initialize()) {
         std::cerr << "Error: Could not initialize visualizer\n";
+        loader.cancelDecode();
         return 1;
     }
     
-    // optional: Adjust smoothing (0.0 = no smoothing, 0.9 = very smooth)
-    visualizer.setSmoothingFactor(0.6f);
+    // Bars are interpolated to the audio being heard and smoothed with attack / release time constants,
+    // so their motion does not depend on the analysis or render rate
+    PresentationScheduler presentation(0.015f, 0.12f, 0.4f, 0.15f);
+    visualizer.setVsync(options.vsync);
+    // The analyzer transforms the interleaved stream, so its bins are spaced for the interleaved sample rate
+    visualizer.setSpectrumSampleRate(spectrumRate);
+    visualizer.setWaterfallMode(options.waterfall);
+    visualizer.setGoniometerVisible(options.goniometer && stereoAnalyzer);
    
 
-    // 6. Start playback
-    if (!output.start()) {
-        std::cerr << "Error: Could not start audio output\n";
-        return 1;
+    // 6. Start capture (file playback is started by the startup graph)
+    if (liveInput) {
+        if (!input->start()) {
+            std::cerr << "Error: Could not start audio input\n";
+            return 1;
+        }
+        std::cout << "Visualizing live input...\n";
     }
 
-    std::cout << "Playing audio with visualization...\n";
-
     // 7. Main loop
-    bool fileEnded = false;
+    std::atomic<bool> fileEnded(false);
+    bool firstFrameShown = false;
+    // Live input latency: age of the newest analyzed sample when its frame is ready
+    double latencyMin = 1.0e9, latencyMax = 0.0, latencySum = 0.0;
+    long long latencyFrames = 0;
+
+    auto isReady = [](const auto& task) {
+        return task.valid() && task.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    };
+    auto toDuration = [](double seconds) {
+        return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+    };
+    auto secondsBetween = [](Clock::time_point from, Clock::time_point to) {
+        return std::chrono::duration<double>(to - from).count();
+    };
+
+    // Analysis and rendering run on their own deadlines from the quality scheduler, feeding runs every pass.
+    // Without --adaptive-quality the level stays at the fixed 1024 FFT / 32 bars / 60 Hz setup.
+    QualityScheduler scheduler;
+    bool qualityApplied = false;
+    auto applyAnalysisLevel = [&](const QualityLevel& level) {
+        analyzer->setFftSize(level.fftSize);
+        analyzer->setNumBuckets(level.numBars);
+        beatDetector = BeatDetector(level.fftSize / 2 + 1, static_cast<float>(1.0 / level.analysisInterval));
+        featureExtractor.setSpectrumSize(level.fftSize / 2 + 1);
+        analysisRate = static_cast<float>(1.0 / level.analysisInterval);
+        analysisReset = true;
+    };
+    // Render interval: --render-rate, else the display's refresh with --vsync, else the quality level's
+    const double refreshInterval = 1.0 / visualizer.getRefreshRate();
+    auto renderInterval = [&]() {
+        return options.renderRate > 0.0 ? 1.0 / options.renderRate : (options.vsync ? refreshInterval : scheduler.getLevel().frameInterval);
+    };
+    const Clock::duration feedInterval = std::chrono::milliseconds(10);
+    Clock::time_point nextAnalysis = Clock::now();
+    Clock::time_point nextFrame = Clock::now();
+    double analysisWork = 0.0;
+    long long analysisFrames = 0;
+    long long renderedFrames = 0;
+    long long skippedFrames = 0;
+    long long wakeups = 0;
+    const double renderBegin = glfwGetTime();
+    const double cpuBegin = ThreadTuning::processCpuSeconds();
+    // Demand rendering (--render-mode demand): frames are drawn only when needsRedraw(), once nothing animates the
+    // main loop blocks in waitEvents() instead of sleeping to the next frame
+    visualizer.setRedrawThreshold(options.redrawThreshold);
+    const double idleTimeout = 0.25;
+    bool idle = false;
+    // Set while the main loop waits idle with a visible window, the analysis thread then wakes it for new frames
+    std::atomic<bool> wakeOnFrame(false);
+    // Audio time of the last analyzed block, set by analyze()
+    double analyzedAudioTime = 0.0;
+
+    // Feeds one pass: live streams drop everything older than one analysis window (nothing else consumes them),
+    // files top up the buffer. Returns the capture age of the newest live sample.
+    auto feed = [&]() {
+        double captureAge = 0.0;
+        if (liveInput) {
+            int window = analyzer ? analyzer->getFftSize() : fftSize;
+            captureAge = input->getCaptureLatency();
+            buffer.skipToLatest(window - window % channels);
+        }
+        else if (!fileEnded && !buffer.fillBuffer(bufferSize / 2)) {
+            std::cout << "End of file reached, waiting for buffer to drain...\n";
+            output->setSourceFinished();
+            fileEnded = true;
+        }
+        return captureAge;
+    };
+
+    // Analyzes one block and publishes it, the caller hands the buckets to the visualizer
+    auto analyze = [&](double captureAge, Clock::time_point feedTime) {
+        if (!analyzer->analyzeNextBlock()) {
+            return false;
+        }
+        // The block is stamped with the center of its window, from the stream position it was peeked at.
+        // Live input has no playback clock, its frames are stamped with the wall clock.
+        const double audioTime = output
+            ? (analyzer->getBlockPosition() + 0.5 * analyzer->getFftSize()) / channels / sampleRate
+            : glfwGetTime();
+        analyzedAudioTime = audioTime;
+        analysisFrames++;
+        publisher.publish(analyzer->getBuckets(), analyzer->getRmsVal(), analyzer->getPeakAmplitude());
+
+        // Onsets from the same spectrum, no second FFT
+        const double frameTime = glfwGetTime();
+        beatDetector.process(analyzer->getSpectrum(), frameTime);
+        // Newest pitch window, fixed cost however many samples arrived
+        pitchAnalyzer.update();
+        // Newest goniometer points, a fixed count however high the sample rate
+        if (stereoAnalyzer) {
+            stereoAnalyzer->update();
+        }
+
+        // Everything --replay needs to run this frame again, and what every stage made of it
+        if (analysisLog.isOpen()) {
+            const std::vector<float>& block = analyzer->getInput();
+            recordFrame.info.samplePosition = analyzer->getBlockPosition();
+            recordFrame.info.frameTime = frameTime;
+            recordFrame.info.audioTime = audioTime;
+            recordFrame.info.analysisRate = analysisRate;
+            recordFrame.info.flags = analysisReset ? AnalysisLogs::frameReset : 0;
+            recordFrame.info.inputChecksum = AnalysisLogs::checksum(block.data(), block.size());
+            recordFrame.input = block;
+            AnalysisReplay::capture(*analyzer, beatDetector, recordPresentation, recordFrame);
+            analysisLog.write(recordFrame);
+            analysisReset = false;
+        }
+
+        // Feature rows from the same spectrum, they complete deltaWidth frames later
+        if (featureWriter.isOpen() && featureExtractor.process(analyzer->getSpectrum().data())) {
+            featureWriter.writeRow(featureExtractor.getRow());
+        }
+
+        if (liveInput && captureAge >= 0.0) {
+            double latency = captureAge + secondsBetween(feedTime, Clock::now());
+            latencyMin = std::min(latencyMin, latency);
+            latencyMax = std::max(latencyMax, latency);
+            latencySum += latency;
+            latencyFrames++;
+        }
+
+        if (!firstFrameShown) {
+            firstFrameShown = true;
+            std::cout << "Startup (" << (options.serialStartup ? "serial" : "parallel") << "): ";
+            if (!liveInput) {
+                std::cout << "first sound after " << 1000.0 * secondsBetween(startupBegin, firstSoundTime) << " ms, ";
+            }
+            std::cout << "first frame after " << 1000.0 * secondsBetween(startupBegin, Clock::now()) << " ms\n";
+        }
+        return true;
+    };
+
+    // Dedicated threads (--rt-threads, --pin-cores): feeding and analysis leave the render thread.
+    // Analysis hands each frame over in this snapshot, render hands quality changes back the same way.
+    struct {
+        std::mutex mutex;
+        std::vector<float> buckets;
+        std::vector<float> spectrum;
+        double audioTime = 0.0;
+        float beatStrength = 0.0f;
+        bool beat = false;
+        int pitchClass = -1;
+        float pitchConfidence = 0.0f;
+        std::vector<float> goniometer;
+        float correlation = 0.0f;
+        bool fresh = false;
+        QualityLevel level = {};
+        bool levelChanged = false;
+    } handoff;
+    std::atomic<bool> workersRunning(false);
+    std::thread feederThread;
+    std::thread analysisThread;
+
+    auto startWorkers = [&]() {
+        workersRunning = true;
+        if (!liveInput) {
+            feederThread = std::thread([&]() {
+                ThreadTuning::applyToCurrentThread(feederThreadConfig);
+                while (workersRunning && !fileEnded) {
+                    feed();
+                    std::this_thread::sleep_for(feedInterval);
+                }
+            });
+        }
+        analysisThread = std::thread([&, level = scheduler.getLevel()]() mutable {
+            ThreadTuning::applyToCurrentThread(analysisThreadConfig);
+            Clock::time_point next = Clock::now();
+            while (workersRunning) {
+                {
+                    std::lock_guard<std::mutex> lock(handoff.mutex);
+                    if (handoff.levelChanged) {
+                        level = handoff.level;
+                        handoff.levelChanged = false;
+                        applyAnalysisLevel(level);
+                    }
+                }
+
+                Clock::time_point feedTime = Clock::now();
+                double captureAge = liveInput ? feed() : 0.0;
+                if (analyze(captureAge, feedTime)) {
+                    std::lock_guard<std::mutex> lock(handoff.mutex);
+                    handoff.buckets = analyzer->getBuckets();
+                    handoff.spectrum = analyzer->getSpectrum();
+                    handoff.audioTime = analyzedAudioTime;
+                    if (beatDetector.isBeat()) {
+                        handoff.beat = true;
+                        handoff.beatStrength = std::max(handoff.beatStrength, beatDetector.getBeatStrength());
+                    }
+                    handoff.pitchClass = pitchAnalyzer.getPitchClass();
+                    handoff.pitchConfidence = pitchAnalyzer.getConfidence();
+                    if (stereoAnalyzer) {
+                        handoff.goniometer = stereoAnalyzer->getPoints();
+                        handoff.correlation = stereoAnalyzer->getCorrelation();
+                    }
+                    handoff.fresh = true;
+                    // Silent frames leave an idle loop asleep, the bars they would show are already drawn
+                    if (wakeOnFrame && !handoff.buckets.empty()
+                        && *std::max_element(handoff.buckets.begin(), handoff.buckets.end()) > 1.0e-4f) {
+                        wakeOnFrame = false;
+                        Visualizer::wakeUp();
+                    }
+                }
+
+                next += toDuration(level.analysisInterval);
+                Clock::time_point now = Clock::now();
+                if (next < now) {
+                    next = now + toDuration(level.analysisInterval);
+                }
+                std::this_thread::sleep_until(next);
+            }
+        });
+        if (options.rtThreads) {
+            // Everything the audio path touches is allocated by now
+            ThreadTuning::lockProcessMemory();
+        }
+    };
+    auto stopWorkers = [&]() {
+        workersRunning = false;
+        if (feederThread.joinable()) {
+            feederThread.join();
+        }
+        if (analysisThread.joinable()) {
+            analysisThread.join();
+        }
+    };
+
+    // Competing load for measuring the audio path (--cpu-hog)
+    std::atomic<bool> hogsRunning(true);
+    std::vector<std::thread> hogs;
+    for (int i = 0; i < options.cpuHogThreads; i++) {
+        hogs.emplace_back([&hogsRunning]() {
+            volatile unsigned long long spin = 0;
+            while (hogsRunning.load(std::memory_order_relaxed)) {
+                spin = spin + 1;
+            }
+        });
+    }
+    if (options.cpuHogThreads > 0) {
+        std::cout << "Running " << options.cpuHogThreads << " CPU hog threads\n";
+    }
     
-    while (!visualizer.shouldClose() && output.isActive()) {
-        // Fill buffer if needed
-        if (!fileEnded) {
-            if (!buffer.fillBuffer(bufferSize / 2)) {
-                std::cout << "End of file reached, waiting for buffer to drain...\n";
-                fileEnded = true;
+    while (!visualizer.shouldClose()) {
+        // Join startup steps as they finish
+        if (!liveInput && !output && isReady(playbackTask)) {
+            output = playbackTask.get();
+            if (!output) {
+                std::cerr << "Error: Could not start audio output\n";
+                loader.cancelDecode();
+                hogsRunning = false;
+                for (std::thread& hog : hogs) {
+                    hog.join();
+                }
+                return 1;
             }
         }
-        
-        // Analyze audio and update visualizer
-        if (analyzer.analyzeNextBlock()) {
-            visualizer.updateData(analyzer.getBuckets());
+        if (!analyzer && isReady(analyzerTask)) {
+            analyzer = analyzerTask.get();
+        }
+        if (analyzer && !qualityApplied) {
+            analyzer->setKeepInput(analysisLog.isOpen());
+            applyAnalysisLevel(scheduler.getLevel());
+            visualizer.setBarCount(scheduler.getLevel().numBars);
+            qualityApplied = true;
+        }
+        if (dedicatedThreads && !workersRunning && analyzer && (liveInput || output)) {
+            startWorkers();
+        }
+        if (liveInput ? !input->isActive() : (output && !output->isActive())) {
+            break;
+        }
+
+        const QualityLevel& level = scheduler.getLevel();
+
+        if (!dedicatedThreads) {
+            // Audio feeding always comes first (only once the startup graph handed the buffer over)
+            Clock::time_point feedTime = Clock::now();
+            double captureAge = (liveInput || output) ? feed() : 0.0;
+
+            // Analyze audio and update visualizer
+            Clock::time_point now = Clock::now();
+            if (now >= nextAnalysis) {
+                nextAnalysis += toDuration(level.analysisInterval);
+                if (nextAnalysis < now) {
+                    nextAnalysis = now + toDuration(level.analysisInterval);
+                }
+
+                if (analyzer && (liveInput || output) && analyze(captureAge, feedTime)) {
+                    presentation.pushFrame(analyzer->getBuckets(), analyzedAudioTime);
+                    visualizer.pushSpectrum(analyzer->getSpectrum());
+                    if (beatDetector.isBeat()) {
+                        visualizer.triggerBeat(beatDetector.getBeatStrength());
+                    }
+                    visualizer.setNoteColor(pitchAnalyzer.getPitchClass(), pitchAnalyzer.getConfidence());
+                    if (stereoAnalyzer) {
+                        visualizer.setGoniometerPoints(stereoAnalyzer->getPoints(), stereoAnalyzer->getCorrelation());
+                    }
+                }
+                analysisWork += secondsBetween(now, Clock::now());
+            }
+        }
+        else {
+            // Take the newest frame from the analysis thread
+            std::lock_guard<std::mutex> lock(handoff.mutex);
+            if (handoff.fresh) {
+                if (static_cast<int>(handoff.buckets.size()) != visualizer.getBarCount()) {
+                    visualizer.setBarCount(static_cast<int>(handoff.buckets.size()));
+                }
+                presentation.pushFrame(handoff.buckets, handoff.audioTime);
+                visualizer.pushSpectrum(handoff.spectrum);
+                if (handoff.beat) {
+                    visualizer.triggerBeat(handoff.beatStrength);
+                }
+                visualizer.setNoteColor(handoff.pitchClass, handoff.pitchConfidence);
+                if (!handoff.goniometer.empty()) {
+                    visualizer.setGoniometerPoints(handoff.goniometer, handoff.correlation);
+                }
+                handoff.fresh = false;
+                handoff.beat = false;
+                handoff.beatStrength = 0.0f;
+            }
         }
         
         // Render visualization
-        visualizer.render();
-        visualizer.pollEvents();
-        
-        // Small delay to prevent maxing out CPU
-        std::this_thread::sleep_for(std::chrono::milliseconds(16)); // ~60 FPS (5 is smoother)
+        Clock::time_point now = Clock::now();
+        if (now >= nextFrame) {
+            Clock::time_point deadline = nextFrame + toDuration(renderInterval());
+            Clock::time_point renderStart = Clock::now();
+
+            // Bars for the audio being heard right now. Live input is shown one analysis interval behind,
+            // so there are always two frames to interpolate between.
+            double displayTime = glfwGetTime();
+            double audioTime = output ? output->getPlaybackTime() : displayTime - level.analysisInterval;
+            if (presentation.present(audioTime, displayTime)
+                && static_cast<int>(presentation.getHeights().size()) == visualizer.getBarCount()) {
+                visualizer.setBarHeights(presentation.getHeights(), presentation.getPeaks());
+            }
+
+            // Demand rendering skips frames that would look the same, and everything while minimized
+            bool draw = !options.demandRendering || (!visualizer.isMinimized() && visualizer.needsRedraw());
+            if (draw) {
+                visualizer.render();
+                renderedFrames++;
+            }
+            else {
+                skippedFrames++;
+            }
+            idle = !draw;
+            visualizer.pollEvents();
+            if (draw && options.syntheticLoadMs > 0.0) {
+                Clock::time_point busyUntil = Clock::now() + toDuration(options.syntheticLoadMs / 1000.0);
+                while (Clock::now() < busyUntil) {}
+            }
+
+            Clock::time_point frameDone = Clock::now();
+            // Waiting for vertical blank is idle time, not work
+            double work = analysisWork + secondsBetween(renderStart, frameDone) - (options.vsync ? visualizer.getLastSwapWait() : 0.0);
+            analysisWork = 0.0;
+            if (draw && options.adaptiveQuality && analyzer
+                && scheduler.recordFrame(work, secondsBetween(deadline, frameDone), glfwGetTime())) {
+                if (dedicatedThreads) {
+                    // The analysis thread applies it, the bar count follows its next frame
+                    std::lock_guard<std::mutex> lock(handoff.mutex);
+                    handoff.level = scheduler.getLevel();
+                    handoff.levelChanged = true;
+                }
+                else {
+                    applyAnalysisLevel(scheduler.getLevel());
+                    visualizer.setBarCount(scheduler.getLevel().numBars);
+                }
+            }
+
+            // A late frame does not try to catch up, the schedule restarts from now.
+            // With --vsync the swap already waited for the display, the next frame only waits half an interval
+            // so an ignored swap interval cannot spin the loop. A skipped frame did not swap, so it waits a whole one.
+            if (draw && options.vsync && options.renderRate <= 0.0) {
+                nextFrame = frameDone + toDuration(0.5 * renderInterval());
+            }
+            else {
+                nextFrame = (draw && deadline > frameDone) ? deadline : frameDone + toDuration(renderInterval());
+            }
+        }
         
         // Stop if buffer drained
         if (fileEnded && buffer.getAvailableReadSamples() == 0) {
             std::cout << "Playback finished.\n";
-            output.stop();
+            output->stop();
             break;
         }
+
+        // Sleep until the next analysis, frame or feed, whichever comes first
+        Clock::time_point wake = std::min(nextFrame, Clock::now() + feedInterval);
+        wakeups++;
+        if (!idle) {
+            std::this_thread::sleep_until(dedicatedThreads ? wake : std::min(nextAnalysis, wake));
+            continue;
+        }
+        // Idle: window events wake the loop at once. Feeding and analysis keep their cadence on this thread,
+        // the worker threads run on their own and wake it for a frame with sound.
+        if (dedicatedThreads && workersRunning) {
+            wake = Clock::now() + toDuration(idleTimeout);
+            wakeOnFrame = !visualizer.isMinimized();
+        }
+        else if (!dedicatedThreads) {
+            wake = std::min(nextAnalysis, Clock::now() + feedInterval);
+        }
+        visualizer.waitEvents(secondsBetween(Clock::now(), wake));
+        wakeOnFrame = false;
+        if (dedicatedThreads || visualizer.needsRedraw()) {
+            nextFrame = std::min(nextFrame, Clock::now());
+        }
     }
 
-    output.stop();
+    stopWorkers();
+    hogsRunning = false;
+    for (std::thread& hog : hogs) {
+        hog.join();
+    }
+
+    double renderSeconds = glfwGetTime() - renderBegin;
+    std::cout << "Rendered " << renderedFrames << " frames (" << renderedFrames / std::max(renderSeconds, 1.0e-9)
+              << " fps) from " << analysisFrames << " analysis frames\n";
+    double cpuSeconds = ThreadTuning::processCpuSeconds() - cpuBegin;
+    std::cout << "Main loop: " << wakeups / std::max(renderSeconds, 1.0e-9) << " wakeups/s, " << skippedFrames
+              << " frames skipped, CPU " << cpuSeconds << " s (" << 100.0 * cpuSeconds / std::max(renderSeconds, 1.0e-9)
+              << "% of one core)\n";
+
+    if (analysisLog.isOpen()) {
+        std::cout << "Recorded " << analysisLog.getFrameCount() << " analysis frames to " << options.recordFile << "\n";
+        analysisLog.close();
+    }
+
+    if (featureWriter.isOpen()) {
+        // The last deltaWidth frames complete with the final frame repeated
+        while (featureExtractor.flush()) {
+            featureWriter.writeRow(featureExtractor.getRow());
+        }
+        std::cout << "Wrote " << featureWriter.getRowCount() << " feature rows to " << options.featuresOutFile << "\n";
+        featureWriter.close();
+    }
+
+    if (options.adaptiveQuality) {
+        std::cout << "Frames: " << scheduler.getFramesTotal() << " rendered, " << scheduler.getFramesMissed()
+                  << " missed their deadline, final quality level " << scheduler.getLevelIndex() << "\n";
+    }
+
+    // Stop a decode still running if the window was closed early
+    loader.cancelDecode();
+
+    if (liveInput) {
+        input->stop();
+        if (latencyFrames > 0) {
+            std::cout << "Capture to analysis latency: min " << latencyMin * 1000.0
+                      << " ms, mean " << latencySum / latencyFrames * 1000.0
+                      << " ms, max " << latencyMax * 1000.0 << " ms over " << latencyFrames << " frames"
+                      << " (plus " << 1000.0 * scheduler.getLevel().fftSize / channels / sampleRate << " ms analysis window)\n";
+        }
+        std::cout << "Dropped input samples: " << input->getDroppedSamples() << "\n";
+    }
+    else if (output) {
+        output->stop();
+        std::cout << "Audio callbacks: " << output->getCallbackCount() << ", underruns: " << output->getUnderrunCount()
+                  << ", callback jitter: rms " << output->getCallbackJitter() * 1000.0
+                  << " ms, max " << output->getMaxCallbackJitter() * 1000.0 << " ms"
+                  << (dedicatedThreads ? " (dedicated threads" : " (main thread feeding")
+                  << (options.cpuHogThreads > 0 ? ", " + std::to_string(options.cpuHogThreads) + " CPU hogs)\n" : ")\n");
+    }
+    std::cout << "Integrated loudness: " << loudnessMeter.getIntegratedLoudness() << " LUFS, "
+              << "loudness range: " << loudnessMeter.getLoudnessRange() << " LU, "
+              << "true peak: " << loudnessMeter.getTruePeak() << " dBTP\n";
+    if (stereoAnalyzer) {
+        std::cout << "Stereo correlation: " << stereoAnalyzer->getCorrelation()
+                  << ", balance: " << stereoAnalyzer->getBalance() << "\n";
+    }
+    std::cout << "Estimated tempo: " << beatDetector.getTempo() << " BPM\n";
     std::cout << "Program finished.\n";
     return 0;
 }
\ No newline at end of file